@@ -20,6 +20,7 @@
 #include "globaldefines.h"
 
 #define GG_PING_TIMEOUT 60
+#define GG_WATCH_EVENTS_MAX 64
 
 struct GetAvatarUsrData
 {
@@ -59,8 +60,6 @@ struct GGP_ParsePubDirInfo {ULONG MethodID; struct GGEventPubDirInfo *ipdi;};
 
 extern struct Library *SysBase, *DOSBase, *IntuitionBase, *UtilityBase, *EzxmlBase, *LocaleBase;
 
-BOOL GGWriteData(struct GGSession*); /* get rid of "implict declaration" warning */
-
 struct Library *OpenSSL3Base;
 
 ULONG strlen(STRPTR a) /* for MakeDirAll()... */
@@ -107,6 +106,7 @@ static IPTR mNew(Class *cl, Object *obj, struct opSet *msg)
 		NewList((struct List*)&d->EventsList);
 		NewList((struct List*)&d->PicturesQueue);
 		NewList((struct List*)&d->PubDirQueue);
+		InitPresenceQueue(&d->PresenceQueue, GG_PRESENCE_WINDOW_DEFAULT);
 
 		if((d->AppObj = (Object*)GetTagData(KWAA_AppObject, (IPTR)NULL, msg->ops_AttrList)))
 		{
@@ -184,7 +184,9 @@ static IPTR mDispose(Class *cl, Object *obj, Msg msg)
 		Close(fh);
 	}
 
+	FlushPresenceQueue(&d->PresenceQueue, &d->EventsList, &d->ContactIDs, TRUE);
 	DoMethod(obj, KWAM_FreeEvents, (IPTR)&d->EventsList);
+	FreeContactIDCache(&d->ContactIDs);
 
 	if(d->GGSession)
 		GGFreeSession(d->GGSession);
@@ -232,14 +234,15 @@ static IPTR mGet(Class *cl, Object *obj, struct opGet *msg)
 		return TRUE;
 
 		case KWAA_WantRead:
-			if(d->GGSession && GG_SESSION_CHECK_READ(d->GGSession))
+			if(d->GGSession && (GG_SESSION_CHECK_READ(d->GGSession) || GG_SESSION_CHECK_PENDING(d->GGSession)))
 				*msg->opg_Storage = (ULONG)TRUE;
 			else
 				*msg->opg_Storage = (ULONG)FALSE;
 		return TRUE;
 
 		case KWAA_WantWrite:
-			if(d->GGSession && GG_SESSION_CHECK_WRITE(d->GGSession))
+			/* data already buffered by OpenSSL won't wake WaitSelect() up, the socket is writable so it returns at once */
+			if(d->GGSession && (GG_SESSION_CHECK_WRITE(d->GGSession) || GG_SESSION_CHECK_PENDING(d->GGSession)))
 				*msg->opg_Storage = (ULONG)TRUE;
 			else
 				*msg->opg_Storage = (ULONG)FALSE;
@@ -263,6 +266,10 @@ static IPTR mConnect(Class *cl, Object *obj, struct KWAP_Connect *msg)
 	ULONG uin;
 	ENTER();
 
+	/* the coalescing window comes from prefs, pending changes of the old session go out first */
+	FlushPresenceQueue(&d->PresenceQueue, &d->EventsList, &d->ContactIDs, TRUE);
+	InitPresenceQueue(&d->PresenceQueue, xget(findobj(USD_PREFS_GG_OTHER_PRESENCE_WINDOW, d->PrefsPanel), MUIA_String_Integer));
+
 	if(StrToLong(uin_str, &uin) != -1)
 	{
 		if(!d->GGSession)
@@ -272,6 +279,8 @@ static IPTR mConnect(Class *cl, Object *obj, struct KWAP_Connect *msg)
 				GGA_CreateSession_Image_Size, 255,
 				GGA_CreateSession_Status, TranslateStatus(msg->Status),
 				GGA_CreateSession_Status_Desc, (ULONG)msg->Description,
+				GGA_CreateSession_ZeroCopy, TRUE,
+				GGA_CreateSession_Roster, TRUE,
 			TAG_END);
 		}
 
@@ -336,11 +345,13 @@ static IPTR mDisconnect(Class *cl, Object *obj, struct KWAP_Disconnect *msg)
 	struct ObjData *d = INST_DATA(cl, obj);
 	ENTER();
 
+	/* GGUncork() sends the status change at once, we may not get another chance */
+	GGCork(d->GGSession);
+
 	if(!GGChangeStatus(d->GGSession, GG_STATUS_NOT_AVAIL, msg->Description))
 		AddErrorEvent(&d->EventsList, ERRNO_OUT_OF_MEMORY, "GGChangeStatus()");
 
-	if(d->GGSession)
-		GGWriteData(d->GGSession);
+	GGUncork(d->GGSession);
 
 	LEAVE();
 	return (IPTR)TRUE;
@@ -349,110 +360,130 @@ static IPTR mDisconnect(Class *cl, Object *obj, struct KWAP_Disconnect *msg)
 static IPTR mWatchEvents(Class *cl, Object *obj, struct KWAP_WatchEvents *msg)
 {
 	struct ObjData *d = INST_DATA(cl, obj);
-	struct GGEvent *gg_event;
+	struct GGEvent *gg_events, *gg_event;
 
 	if(msg->CanRead || msg->CanWrite)
 	{
-		if((gg_event = GGWatchEvent(d->GGSession)))
+		/* packets sent while handling this batch (acks, image requests...) leave together */
+		GGCork(d->GGSession);
+
+		if((gg_events = GGWatchEvents(d->GGSession, GG_WATCH_EVENTS_MAX)))
 		{
-			switch(gg_event->gge_Type)
+			while((gg_event = gg_events))
 			{
-				case GGE_TYPE_LOGIN_FAIL:
-					AddErrorEvent(&d->EventsList, ERRNO_LOGIN_FAILED, GetString(MSG_MODULE_MSG_LOGIN_FAILED));
-				break;
-
-				case GGE_TYPE_DISCONNECT:
-					GGFreeSession(d->GGSession);
-					d->GGSession = NULL;
-					AddEvent(&d->EventsList, KE_TYPE_DISCONNECT);
-					AddErrorEvent(&d->EventsList, ERRNO_ONLY_MESSAGE, GetString(MSG_MODULE_MSG_DISCONNECTED));
-				break;
-
-				case GGE_TYPE_LOGIN_SUCCESS:
-					AddEvent(&d->EventsList, KE_TYPE_CONNECT);
-				break;
-
-				case GGE_TYPE_STATUS_CHANGE:
-				case GGE_TYPE_LIST_STATUS:
-					StatusEvent(&d->EventsList, gg_event, d->GGSession->ggs_Uin);
-				break;
-
-				case GGE_TYPE_TYPING_NOTIFY:
-					AddEventTypingNotify(&d->EventsList, gg_event->gge_Event.gge_TypingNotify.ggetn_Uin, gg_event->gge_Event.gge_TypingNotify.ggetn_Length);
-				break;
-
-				case GGE_TYPE_RECV_MSG:
-					DoMethod(obj, GGM_RecvMsg, (IPTR)&gg_event->gge_Event.gge_RecvMsg);
-				break;
-
-				case GGE_TYPE_ERROR:
-					switch(gg_event->gge_Event.gge_Error.ggee_Errno)
-					{
-						case GGS_ERRNO_MEM:
-							AddErrorEvent(&d->EventsList, ERRNO_OUT_OF_MEMORY, NULL);
-						break;
+				gg_events = gg_event->gge_Next;
 
-						case GGS_ERRNO_HUB_FAILED:
-						case GGS_ERRNO_INTERRUPT:
-						case GGS_ERRNO_SERVER_OFF:
-						case GGS_ERRNO_SOCKET_LIB:
-							AddErrorEvent(&d->EventsList, ERRNO_CONNECTION_FAILED, NULL);
-						break;
+				switch(gg_event->gge_Type)
+				{
+					case GGE_TYPE_LOGIN_FAIL:
+						AddErrorEvent(&d->EventsList, ERRNO_LOGIN_FAILED, GetString(MSG_MODULE_MSG_LOGIN_FAILED));
+					break;
 
-						case GGS_ERRNO_UNKNOWN_PACKET:
-							AddErrorEvent(&d->EventsList, ERRNO_ONLY_MESSAGE, GetString(MSG_MOUDLE_MSG_UNKNOWN_PACKET));
-						break;
-					}
-				break;
+					case GGE_TYPE_DISCONNECT:
+						GGFreeSession(d->GGSession);
+						d->GGSession = NULL;
+						FlushPresenceQueue(&d->PresenceQueue, &d->EventsList, &d->ContactIDs, TRUE);
+						AddEvent(&d->EventsList, KE_TYPE_DISCONNECT);
+						AddErrorEvent(&d->EventsList, ERRNO_ONLY_MESSAGE, GetString(MSG_MODULE_MSG_DISCONNECTED));
+					break;
 
+					case GGE_TYPE_LOGIN_SUCCESS:
+						AddEvent(&d->EventsList, KE_TYPE_CONNECT);
+					break;
 
-				case GGE_TYPE_USER_DATA:
-					DoMethod(obj, GGM_ParseUserData, (IPTR)&gg_event->gge_Event.gge_UsersData);
-				break;
+					case GGE_TYPE_STATUS_CHANGE:
+					case GGE_TYPE_LIST_STATUS:
+						StatusEvent(&d->EventsList, &d->PresenceQueue, &d->ContactIDs, gg_event, d->GGSession->ggs_Uin);
+					break;
 
-				case GGE_TYPE_LIST_IMPORT:
-					DoMethod(obj, GGM_ParseXMLList, (IPTR)&gg_event->gge_Event.gge_ListImport);
-				break;
+					case GGE_TYPE_TYPING_NOTIFY:
+						AddEventTypingNotify(&d->EventsList, &d->ContactIDs, gg_event->gge_Event.gge_TypingNotify.ggetn_Uin, gg_event->gge_Event.gge_TypingNotify.ggetn_Length);
+					break;
 
-				case GGE_TYPE_LIST_EXPORT:
-					AddListExportEvent(&d->EventsList, gg_event->gge_Event.gge_ListExport.ggele_Accept);
-					if(gg_event->gge_Event.gge_ListExport.ggele_Accept)
-					{
-						d->ListVersion = gg_event->gge_Event.gge_ListExport.ggele_Version;
-						AddErrorEvent(&d->EventsList, ERRNO_ONLY_MESSAGE, GetString(MSG_MODULE_MSG_LIST_EXPORT_OK));
-					}
-					else
-						AddErrorEvent(&d->EventsList, ERRNO_ONLY_MESSAGE, GetString(MSG_MODULE_MSG_LIST_EXPORT_FAIL));
-				break;
+					case GGE_TYPE_RECV_MSG:
+						DoMethod(obj, GGM_RecvMsg, (IPTR)&gg_event->gge_Event.gge_RecvMsg);
+					break;
+
+					case GGE_TYPE_ERROR:
+						switch(gg_event->gge_Event.gge_Error.ggee_Errno)
+						{
+							case GGS_ERRNO_MEM:
+								AddErrorEvent(&d->EventsList, ERRNO_OUT_OF_MEMORY, NULL);
+							break;
+
+							case GGS_ERRNO_HUB_FAILED:
+							case GGS_ERRNO_INTERRUPT:
+							case GGS_ERRNO_SERVER_OFF:
+							case GGS_ERRNO_SOCKET_LIB:
+								AddErrorEvent(&d->EventsList, ERRNO_CONNECTION_FAILED, NULL);
+							break;
+
+							case GGS_ERRNO_UNKNOWN_PACKET:
+								AddErrorEvent(&d->EventsList, ERRNO_ONLY_MESSAGE, GetString(MSG_MOUDLE_MSG_UNKNOWN_PACKET));
+							break;
+						}
+					break;
 
-				case GGE_TYPE_MULTILOGON_INFO:
-					DoMethod(findobj(USD_MULTILOGON_WINDOW_LIST, (Object*)d->GuiTagList[2].ti_Data), MLM_InsertData,
-					 gg_event->gge_Event.gge_MultilogonInfo.ggemi_No, (IPTR)gg_event->gge_Event.gge_MultilogonInfo.ggemi_Data);
-				break;
 
-				case GGE_TYPE_IMAGE_REQUEST:
-					DoMethod(obj, GGM_SendImageData, (IPTR)&gg_event->gge_Event.gge_ImageRequest);
-				break;
+					case GGE_TYPE_USER_DATA:
+						DoMethod(obj, GGM_ParseUserData, (IPTR)&gg_event->gge_Event.gge_UsersData);
+					break;
+
+					case GGE_TYPE_LIST_IMPORT:
+						DoMethod(obj, GGM_ParseXMLList, (IPTR)&gg_event->gge_Event.gge_ListImport);
+					break;
+
+					case GGE_TYPE_LIST_EXPORT:
+						AddListExportEvent(&d->EventsList, gg_event->gge_Event.gge_ListExport.ggele_Accept);
+						if(gg_event->gge_Event.gge_ListExport.ggele_Accept)
+						{
+							d->ListVersion = gg_event->gge_Event.gge_ListExport.ggele_Version;
+							AddErrorEvent(&d->EventsList, ERRNO_ONLY_MESSAGE, GetString(MSG_MODULE_MSG_LIST_EXPORT_OK));
+						}
+						else
+							AddErrorEvent(&d->EventsList, ERRNO_ONLY_MESSAGE, GetString(MSG_MODULE_MSG_LIST_EXPORT_FAIL));
+					break;
+
+					case GGE_TYPE_MULTILOGON_INFO:
+						DoMethod(findobj(USD_MULTILOGON_WINDOW_LIST, (Object*)d->GuiTagList[2].ti_Data), MLM_InsertData,
+						 gg_event->gge_Event.gge_MultilogonInfo.ggemi_No, (IPTR)gg_event->gge_Event.gge_MultilogonInfo.ggemi_Data);
+					break;
+
+					case GGE_TYPE_IMAGE_REQUEST:
+						DoMethod(obj, GGM_SendImageData, (IPTR)&gg_event->gge_Event.gge_ImageRequest);
+					break;
 
-				case GGE_TYPE_IMAGE_DATA:
-					DoMethod(obj, GGM_ReceiveImageData, (IPTR)&gg_event->gge_Event.gge_ImageData);
-				break;
+					case GGE_TYPE_IMAGE_DATA:
+						DoMethod(obj, GGM_ReceiveImageData, (IPTR)&gg_event->gge_Event.gge_ImageData);
+					break;
+
+					case GGE_TYPE_PUBDIR_INFO:
+						DoMethod(obj, GGM_ParsePubDirInfo, (IPTR)&gg_event->gge_Event.gge_PubDirInfo);
+					break;
 
-				case GGE_TYPE_PUBDIR_INFO:
-					DoMethod(obj, GGM_ParsePubDirInfo, (IPTR)&gg_event->gge_Event.gge_PubDirInfo);
-				break;
+					case GGE_TYPE_IMAGE_UPLOAD:
+						if(gg_event->gge_Event.gge_ImageUpload.ggeiu_State == GG_IMAGE_UPLOAD_FAILED)
+							tprintf("image upload to %lu failed after %lu of %lu bytes\n", gg_event->gge_Event.gge_ImageUpload.ggeiu_Uin,
+							 gg_event->gge_Event.gge_ImageUpload.ggeiu_Sent, gg_event->gge_Event.gge_ImageUpload.ggeiu_ImageSize);
+					break;
 
-				case GGE_TYPE_NOOP:
-				case GGE_TYPE_CONNECTED:
-				break;
+					case GGE_TYPE_NOOP:
+					case GGE_TYPE_CONNECTED:
+					break;
 
-				default:
-					tprintf("unknown event: %ld\n", gg_event->gge_Type);
+					default:
+						tprintf("unknown event: %ld\n", gg_event->gge_Type);
+				}
+				GGReleaseEvent(d->GGSession, gg_event);
 			}
-			GGFreeEvent(gg_event);
 		}
+
+		/* the session is gone after GGE_TYPE_DISCONNECT, GGUncork() ignores NULL */
+		GGUncork(d->GGSession);
 	}
 
+	FlushPresenceQueue(&d->PresenceQueue, &d->EventsList, &d->ContactIDs, FALSE);
+
 	return (IPTR)&d->EventsList;
 }
 
@@ -492,7 +523,7 @@ static IPTR mNotifyList(Class *cl, Object *obj, struct KWAP_NotifyList *msg)
 					}
 				}
 
-				if(!GGNotifyList(d->GGSession, uins, types, msg->EntriesNo))
+				if(!GGNotifyList(d->GGSession, uins, types, act))
 					AddErrorEvent(&d->EventsList, ERRNO_OUT_OF_MEMORY, "GGNotifyList()");
 
 				FreeMem(types, msg->EntriesNo * sizeof(BYTE));
@@ -523,21 +554,13 @@ static IPTR mFreeEvent(Class *cl, Object *obj, struct KWAP_FreeEvents *msg)
 					StrFree(event->ke_StatusChange.ke_Description);
 			break;
 
+			/* ContactIDs belong to the ContactIDCache, they are not freed here */
 			case KE_TYPE_LIST_CHANGE:
-				if(event->ke_ListChange.ke_ContactID)
-					FmtFree(event->ke_ListChange.ke_ContactID);
 				if(event->ke_ListChange.ke_Description)
 					StrFree(event->ke_ListChange.ke_Description);
 			break;
 
-			case KE_TYPE_TYPING_NOTIFY:
-				if(event->ke_TypingNotify.ke_ContactID)
-					FmtFree(event->ke_TypingNotify.ke_ContactID);
-			break;
-
 			case KE_TYPE_NEW_MESSAGE:
-				if(event->ke_NewMessage.ke_ContactID)
-					FmtFree(event->ke_NewMessage.ke_ContactID);
 				if(event->ke_NewMessage.ke_Txt)
 					StrFree(event->ke_NewMessage.ke_Txt);
 			break;
@@ -548,8 +571,6 @@ static IPTR mFreeEvent(Class *cl, Object *obj, struct KWAP_FreeEvents *msg)
 			break;
 
 			case KE_TYPE_NEW_AVATAR:
-				if(event->ke_NewAvatar.ke_ContactID)
-					StrFree(event->ke_NewAvatar.ke_ContactID);
 				if(event->ke_NewAvatar.ke_Picture)
 					FreePicture(event->ke_NewAvatar.ke_Picture);
 			break;
@@ -582,8 +603,6 @@ static IPTR mFreeEvent(Class *cl, Object *obj, struct KWAP_FreeEvents *msg)
 			break;
 
 			case KE_TYPE_NEW_PICTURE:
-				if(event->ke_NewPicture.ke_ContactID)
-					StrFree(event->ke_NewPicture.ke_ContactID);
 				if(event->ke_NewPicture.ke_Data)
 					FreeMem(event->ke_NewPicture.ke_Data, event->ke_NewPicture.ke_DataSize);
 			break;
@@ -686,6 +705,9 @@ static IPTR mPing(Class *cl, Object *obj)
 {
 	struct ObjData *d = INST_DATA(cl, obj);
 
+	/* deliver coalesced list changes even if nothing more comes from the server */
+	FlushPresenceQueue(&d->PresenceQueue, &d->EventsList, &d->ContactIDs, FALSE);
+
 	if(!--d->Timeout)
 	{
 		if(d->GGSession)
@@ -1067,7 +1089,7 @@ static IPTR mGetAvatar(Class *cl, Object *obj, struct GGP_GetAvatar *msg)
 	FmtNPut(buffer, CACHE_AVATARS_DIR"%ls", sizeof(buffer), msg->key);
 
 	if((pic = LoadPictureFile(buffer)))
-		AddNewAvatarEvent(&d->EventsList, msg->uin, pic);
+		AddNewAvatarEvent(&d->EventsList, &d->ContactIDs, msg->uin, pic);
 	else if((usr_data = AllocMem(sizeof(struct GetAvatarUsrData), MEMF_ANY)))
 	{
 		usr_data->uin = msg->uin;
@@ -1111,7 +1133,7 @@ static IPTR mNewAvatar(Class *cl, Object *obj, struct KWAP_HttpCallBack *msg)
 			}
 
 			if((pic = LoadPictureMemory(msg->Data, &length)))
-				AddNewAvatarEvent(&d->EventsList, usr_data->uin, pic);
+				AddNewAvatarEvent(&d->EventsList, &d->ContactIDs, usr_data->uin, pic);
 		}
 
 		if(usr_data->url)
@@ -1227,10 +1249,11 @@ static IPTR mSendImageData(Class *cl, Object *obj, struct GGP_SendImageData *msg
 
 	FmtNPut(buffer, CACHE_PICTURES_DIR"%08lx%08lx", sizeof(buffer), msg->ir->ggeir_Crc32, msg->ir->ggeir_ImageSize);
 
+	/* on success gglib owns the file and closes it when the upload is over */
 	if((fh = Open(buffer, MODE_OLDFILE)))
 	{
-		GGSendImageData(d->GGSession, msg->ir->ggeir_Uin, fh);
-		Close(fh);
+		if(!GGSendImageData(d->GGSession, msg->ir->ggeir_Uin, fh))
+			Close(fh);
 	}
 
 	return (IPTR)0;
@@ -1239,15 +1262,17 @@ static IPTR mSendImageData(Class *cl, Object *obj, struct GGP_SendImageData *msg
 static IPTR mRecvMsg(Class *cl, Object *obj, struct GGP_RecvMsg *msg)
 {
 	struct ObjData *d = INST_DATA(cl, obj);
+	STRPTR txt, images;
 
-	if(msg->rm->ggerm_Txt)
-		AddEventNewMessage(&d->EventsList, msg->rm->ggerm_Uin, msg->rm->ggerm_Txt, msg->rm->ggerm_Flags, msg->rm->ggerm_Time);
+	/* gglib converts the HTML only on request */
+	if((txt = GGGetMessageText(msg->rm)))
+		AddEventNewMessage(&d->EventsList, &d->ContactIDs, msg->rm->ggerm_Uin, txt, msg->rm->ggerm_Flags, msg->rm->ggerm_Time);
 
-	if(msg->rm->ggerm_ImagesIds)
+	if((images = GGGetMessageImages(msg->rm)))
 	{
 		UBYTE buffer[50];
 		ULONG imgs = 1, i;
-		STRPTR t = msg->rm->ggerm_ImagesIds, end;
+		STRPTR t = images, end;
 
 		end = StrCopy(CACHE_PICTURES_DIR, buffer);
 
@@ -1262,13 +1287,13 @@ static IPTR mRecvMsg(Class *cl, Object *obj, struct GGP_RecvMsg *msg)
 			APTR pic;
 			ULONG size;
 
-			StrNCopy(msg->rm->ggerm_ImagesIds + i * 16 + i, end, 16);
+			StrNCopy(images + i * 16 + i, end, 16);
 
 
 			if((pic = LoadFile(buffer, &size)))
 			{
 				/* we have image in cache, load and go with it */
-				AddEventNewPicture(&d->EventsList, msg->rm->ggerm_Uin, msg->rm->ggerm_Flags, msg->rm->ggerm_Time, pic, size);
+				AddEventNewPicture(&d->EventsList, &d->ContactIDs, msg->rm->ggerm_Uin, msg->rm->ggerm_Flags, msg->rm->ggerm_Time, pic, size);
 			}
 			else
 			{
@@ -1330,7 +1355,7 @@ static IPTR mReceiveImageData(Class *cl, Object *obj, struct GGP_ReceiveImageDat
 					Close(fh);
 				}
 
-				AddEventNewPicture(&d->EventsList, en->uin, en->flags, en->timestamp, en->data, en->size);
+				AddEventNewPicture(&d->EventsList, &d->ContactIDs, en->uin, en->flags, en->timestamp, en->data, en->size);
 
 				goto remove_picture_from_queue;
 			}
@@ -14,6 +14,7 @@
 #include <kwakwa_api/protocol.h>
 #include <gglib.h>
 #include "globaldefines.h"
+#include "events.h"
 
 #define GGM_HubDone                 MAKE_ID(0x00000001)
 #define GGM_ParseUserData           MAKE_ID(0x00000002)
@@ -32,6 +33,8 @@ struct ObjData
 	struct MinList     EventsList;
 	struct MinList     PicturesQueue;
 	struct MinList     PubDirQueue;
+	struct PresenceQueue PresenceQueue;
+	struct ContactIDCache ContactIDs;
 	UBYTE              ServerIP[16];
 	ULONG              Timeout;
 	ULONG              ListVersion;
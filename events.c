@@ -5,6 +5,7 @@
  */
 
 #include <proto/exec.h>
+#include <proto/dos.h>
 #include <kwakwa_api/protocol.h>
 #include <gglib.h>
 #include <libvstring.h>
@@ -12,7 +13,10 @@
 #include "globaldefines.h"
 #include "events.h"
 
-extern struct Library *SysBase, *LocaleBase;
+extern struct Library *SysBase, *DOSBase, *LocaleBase;
+
+#define PRESENCE_HASH(uin) ((uin) & (PRESENCE_HASH_SIZE - 1))
+#define CONTACT_ID_HASH(uin) ((uin) & (CONTACT_ID_HASH_SIZE - 1))
 
 static inline ULONG StatusTranslate(ULONG gg_status)
 {
@@ -44,6 +48,56 @@ static inline ULONG NewMsgFlagsTranslate(ULONG gg_flags)
 }
 
 
+STRPTR ContactID(struct ContactIDCache *cc, ULONG uin)
+{
+	struct ContactIDEntry *ce;
+	ULONG v;
+	LONG len = 0;
+
+	for(ce = cc->cc_Hash[CONTACT_ID_HASH(uin)]; ce; ce = ce->ce_Next)
+	{
+		if(ce->ce_Uin == uin)
+			return (STRPTR)ce->ce_ID;
+	}
+
+	if(!(ce = AllocMem(sizeof(struct ContactIDEntry), MEMF_ANY)))
+		return NULL;
+
+	v = uin;
+	do
+	{
+		len++;
+		v /= 10;
+	}
+	while(v);
+
+	ce->ce_ID[len] = 0x00;
+	for(v = uin; len--; v /= 10)
+		ce->ce_ID[len] = '0' + v % 10;
+
+	ce->ce_Uin = uin;
+	ce->ce_Next = cc->cc_Hash[CONTACT_ID_HASH(uin)];
+	cc->cc_Hash[CONTACT_ID_HASH(uin)] = ce;
+
+	return (STRPTR)ce->ce_ID;
+}
+
+VOID FreeContactIDCache(struct ContactIDCache *cc)
+{
+	LONG i;
+
+	for(i = 0; i < CONTACT_ID_HASH_SIZE; i++)
+	{
+		struct ContactIDEntry *ce;
+
+		while((ce = cc->cc_Hash[i]))
+		{
+			cc->cc_Hash[i] = ce->ce_Next;
+			FreeMem(ce, sizeof(struct ContactIDEntry));
+		}
+	}
+}
+
 struct KwaEvent *AddEvent(struct MinList *list, ULONG event_type)
 {
 	struct KwaEvent *event;
@@ -69,13 +123,13 @@ VOID AddListExportEvent(struct MinList *list, BOOL result)
 	}
 }
 
-VOID AddNewAvatarEvent(struct MinList *list, ULONG uin, struct Picture *pic)
+VOID AddNewAvatarEvent(struct MinList *list, struct ContactIDCache *cc, ULONG uin, struct Picture *pic)
 {
 	struct KwaEvent *event;
 
 	if((event = AddEvent(list, KE_TYPE_NEW_AVATAR)))
 	{
-		if((event->ke_NewAvatar.ke_ContactID = FmtNew("%lu", uin)))
+		if((event->ke_NewAvatar.ke_ContactID = ContactID(cc, uin)))
 		{
 			event->ke_NewAvatar.ke_Picture = pic;
 			return;
@@ -127,13 +181,13 @@ VOID AddEventStatusChange(struct MinList *list, ULONG status, STRPTR desc)
 	}
 }
 
-VOID AddEventListChange(struct MinList *list, ULONG uin, ULONG status, STRPTR desc)
+VOID AddEventListChange(struct MinList *list, struct ContactIDCache *cc, ULONG uin, ULONG status, STRPTR desc)
 {
 	struct KwaEvent *event;
 
 	if((event = AddEvent(list, KE_TYPE_LIST_CHANGE)))
 	{
-		if((event->ke_ListChange.ke_ContactID = FmtNew("%lu", uin)))
+		if((event->ke_ListChange.ke_ContactID = ContactID(cc, uin)))
 		{
 			event->ke_ListChange.ke_Description = StrNew(desc);
 			event->ke_ListChange.ke_NewStatus = StatusTranslate(status);
@@ -145,13 +199,13 @@ VOID AddEventListChange(struct MinList *list, ULONG uin, ULONG status, STRPTR de
 	}
 }
 
-VOID AddEventTypingNotify(struct MinList *list, ULONG uin, ULONG len)
+VOID AddEventTypingNotify(struct MinList *list, struct ContactIDCache *cc, ULONG uin, ULONG len)
 {
 	struct KwaEvent *event;
 
 	if((event = AddEvent(list, KE_TYPE_TYPING_NOTIFY)))
 	{
-		if((event->ke_ListChange.ke_ContactID = FmtNew("%lu", uin)))
+		if((event->ke_TypingNotify.ke_ContactID = ContactID(cc, uin)))
 		{
 			event->ke_TypingNotify.ke_TxtLen = len;
 			return;
@@ -162,13 +216,13 @@ VOID AddEventTypingNotify(struct MinList *list, ULONG uin, ULONG len)
 	}
 }
 
-VOID AddEventNewMessage(struct MinList *list, ULONG uin, STRPTR msg_txt, ULONG flags, ULONG nix_timestamp)
+VOID AddEventNewMessage(struct MinList *list, struct ContactIDCache *cc, ULONG uin, STRPTR msg_txt, ULONG flags, ULONG nix_timestamp)
 {
 	struct KwaEvent *event;
 
 	if((event = AddEvent(list, KE_TYPE_NEW_MESSAGE)))
 	{
-		if((event->ke_NewMessage.ke_ContactID = FmtNew("%lu", uin)))
+		if((event->ke_NewMessage.ke_ContactID = ContactID(cc, uin)))
 		{
 			if((event->ke_NewMessage.ke_Txt = StrNew(msg_txt)))
 			{
@@ -178,14 +232,100 @@ VOID AddEventNewMessage(struct MinList *list, ULONG uin, STRPTR msg_txt, ULONG f
 				event->ke_NewMessage.ke_TimeStamp = UnixToAmigaTimestamp(nix_timestamp);
 				return;
 			}
-			FmtFree(event->ke_NewMessage.ke_ContactID);
 		}
 		Remove((struct Node*)event);
 		FreeKwaEvent(event);
 	}
 }
 
-VOID StatusEvent(struct MinList *list, struct GGEvent *gge, ULONG myuin)
+VOID InitPresenceQueue(struct PresenceQueue *pq, ULONG window)
+{
+	LONG i;
+
+	for(i = 0; i < PRESENCE_HASH_SIZE; i++)
+		pq->pq_Hash[i] = NULL;
+
+	pq->pq_Head = NULL;
+	pq->pq_Tail = &pq->pq_Head;
+	pq->pq_Count = 0;
+	pq->pq_Start = 0;
+	pq->pq_Window = window;
+}
+
+static VOID QueuePresence(struct PresenceQueue *pq, struct MinList *list, struct ContactIDCache *cc, ULONG uin, ULONG status, STRPTR desc)
+{
+	struct PresenceUpdate *pu;
+
+	if(pq->pq_Window == 0)
+	{
+		AddEventListChange(list, cc, uin, status, desc);
+		return;
+	}
+
+	for(pu = pq->pq_Hash[PRESENCE_HASH(uin)]; pu; pu = pu->pu_HashNext)
+	{
+		if(pu->pu_Uin == uin)
+			break;
+	}
+
+	if(pu)
+	{
+		/* newer state of an already pending uin replaces the old one */
+		if(pu->pu_Description)
+			StrFree(pu->pu_Description);
+	}
+	else
+	{
+		if(!(pu = AllocMem(sizeof(struct PresenceUpdate), MEMF_ANY)))
+		{
+			AddEventListChange(list, cc, uin, status, desc);
+			return;
+		}
+
+		pu->pu_Uin = uin;
+		pu->pu_HashNext = pq->pq_Hash[PRESENCE_HASH(uin)];
+		pq->pq_Hash[PRESENCE_HASH(uin)] = pu;
+		pu->pu_Next = NULL;
+		*pq->pq_Tail = pu;
+		pq->pq_Tail = &pu->pu_Next;
+
+		if(pq->pq_Count++ == 0)
+			pq->pq_Start = GGClock();
+	}
+
+	pu->pu_Status = status;
+	pu->pu_Description = StrNew(desc);
+}
+
+VOID FlushPresenceQueue(struct PresenceQueue *pq, struct MinList *list, struct ContactIDCache *cc, BOOL force)
+{
+	struct PresenceUpdate *pu;
+
+	if(pq->pq_Count == 0)
+		return;
+
+	if(!force && (GGClock() - pq->pq_Start) * (1000UL / TICKS_PER_SECOND) < pq->pq_Window)
+		return;
+
+	/* events go out in order of the first update of each uin */
+	while((pu = pq->pq_Head))
+	{
+		pq->pq_Head = pu->pu_Next;
+		pq->pq_Hash[PRESENCE_HASH(pu->pu_Uin)] = NULL;
+
+		AddEventListChange(list, cc, pu->pu_Uin, pu->pu_Status, pu->pu_Description);
+
+		if(pu->pu_Description)
+			StrFree(pu->pu_Description);
+
+		FreeMem(pu, sizeof(struct PresenceUpdate));
+	}
+
+	pq->pq_Tail = &pq->pq_Head;
+	pq->pq_Count = 0;
+}
+
+VOID StatusEvent(struct MinList *list, struct PresenceQueue *pq, struct ContactIDCache *cc, struct GGEvent *gge, ULONG myuin)
 {
 	if(gge->gge_Type == GGE_TYPE_STATUS_CHANGE)
 	{
@@ -194,31 +334,33 @@ VOID StatusEvent(struct MinList *list, struct GGEvent *gge, ULONG myuin)
 		if(sc->ggesc_Uin == myuin)
 			AddEventStatusChange(list, sc->ggesc_Status, sc->ggesc_Description);
 
-		AddEventListChange(list, sc->ggesc_Uin, sc->ggesc_Status, sc->ggesc_Description);
+		QueuePresence(pq, list, cc, sc->ggesc_Uin, sc->ggesc_Status, sc->ggesc_Description);
 	}
 	else if(gge->gge_Type == GGE_TYPE_LIST_STATUS)
 	{
 		struct GGEventListStatus *ls = &gge->gge_Event.gge_ListStatus;
+		ULONG *uins = ls->ggels_Uins;
+		ULONG *statuses = ls->ggels_Statuses;
+		STRPTR *descs = ls->ggels_Descriptions;
 		LONG i;
 
 		for(i = 0; i < ls->ggels_ChangesNo; i++)
 		{
-			if(ls->ggels_StatusChanges[i].ggesc_Uin == myuin)
-				AddEventStatusChange(list, ls->ggels_StatusChanges[i].ggesc_Status, ls->ggels_StatusChanges[i].ggesc_Description);
+			if(uins[i] == myuin)
+				AddEventStatusChange(list, statuses[i], descs[i]);
 
-			AddEventListChange(list, ls->ggels_StatusChanges[i].ggesc_Uin, ls->ggels_StatusChanges[i].ggesc_Status,
-			 ls->ggels_StatusChanges[i].ggesc_Description);
+			QueuePresence(pq, list, cc, uins[i], statuses[i], descs[i]);
 		}
 	}
 }
 
-VOID AddEventNewPicture(struct MinList *list, ULONG uin, ULONG flags, ULONG nix_timestamp, APTR data, ULONG size)
+VOID AddEventNewPicture(struct MinList *list, struct ContactIDCache *cc, ULONG uin, ULONG flags, ULONG nix_timestamp, APTR data, ULONG size)
 {
 	struct KwaEvent *event;
 
 	if(data && (event = AddEvent(list, KE_TYPE_NEW_PICTURE)))
 	{
-		if((event->ke_NewPicture.ke_ContactID = FmtNew("%lu", uin)))
+		if((event->ke_NewPicture.ke_ContactID = ContactID(cc, uin)))
 		{
 			event->ke_NewPicture.ke_Flags = NewMsgFlagsTranslate(flags);
 			event->ke_NewPicture.ke_TimeStamp = UnixToAmigaTimestamp(nix_timestamp);
@@ -7,14 +7,55 @@
 #ifndef __EVENTS_H__
 #define __EVENTS_H__
 
+#define PRESENCE_HASH_SIZE 256
+#define CONTACT_ID_HASH_SIZE 1024
+
+struct ContactIDEntry
+{
+	struct ContactIDEntry *ce_Next;
+	ULONG ce_Uin;
+	UBYTE ce_ID[12];
+};
+
+/* decimal ContactID strings shared by all events of the object, they are freed only */
+/* by FreeContactIDCache(), so events must not free their ContactID                  */
+struct ContactIDCache
+{
+	struct ContactIDEntry *cc_Hash[CONTACT_ID_HASH_SIZE];
+};
+
+struct PresenceUpdate
+{
+	struct PresenceUpdate *pu_HashNext;
+	struct PresenceUpdate *pu_Next;
+	ULONG pu_Uin;
+	ULONG pu_Status;
+	STRPTR pu_Description;
+};
+
+/* list changes waiting for the coalescing window, only the last state of each uin is kept */
+struct PresenceQueue
+{
+	struct PresenceUpdate *pq_Hash[PRESENCE_HASH_SIZE];
+	struct PresenceUpdate *pq_Head;
+	struct PresenceUpdate **pq_Tail;
+	ULONG pq_Count;
+	ULONG pq_Start;     /* GGClock() of the oldest pending update, in ticks */
+	ULONG pq_Window;    /* in ms, 0 means no coalescing */
+};
+
 struct KwaEvent *AddEvent(struct MinList *list, ULONG event_type);
 VOID AddErrorEvent(struct MinList *list, ULONG errno, STRPTR txt);
-VOID AddEventTypingNotify(struct MinList *list, ULONG uin, ULONG len);
-VOID AddEventNewMessage(struct MinList *list, ULONG uin, STRPTR msg_txt, ULONG flags, ULONG nix_timestamp);
-VOID StatusEvent(struct MinList *list, struct GGEvent *gge, ULONG myuin);
+VOID AddEventTypingNotify(struct MinList *list, struct ContactIDCache *cc, ULONG uin, ULONG len);
+VOID AddEventNewMessage(struct MinList *list, struct ContactIDCache *cc, ULONG uin, STRPTR msg_txt, ULONG flags, ULONG nix_timestamp);
+VOID StatusEvent(struct MinList *list, struct PresenceQueue *pq, struct ContactIDCache *cc, struct GGEvent *gge, ULONG myuin);
+VOID InitPresenceQueue(struct PresenceQueue *pq, ULONG window);
+VOID FlushPresenceQueue(struct PresenceQueue *pq, struct MinList *list, struct ContactIDCache *cc, BOOL force);
+STRPTR ContactID(struct ContactIDCache *cc, ULONG uin);
+VOID FreeContactIDCache(struct ContactIDCache *cc);
 BOOL AddHttpGetEvent(struct MinList *list, STRPTR url, STRPTR usr_agent, ULONG methodid, APTR usr_data);
-VOID AddNewAvatarEvent(struct MinList *list, ULONG uin, struct Picture *pic);
+VOID AddNewAvatarEvent(struct MinList *list, struct ContactIDCache *cc, ULONG uin, struct Picture *pic);
 VOID AddListExportEvent(struct MinList *list, BOOL result);
-VOID AddEventNewPicture(struct MinList *list, ULONG uin, ULONG flags, ULONG nix_timestamp, APTR data, ULONG size);
+VOID AddEventNewPicture(struct MinList *list, struct ContactIDCache *cc, ULONG uin, ULONG flags, ULONG nix_timestamp, APTR data, ULONG size);
 
 #endif /* __EVENTS_H__ */
@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2013 - 2022 Filip "widelec" Maryjanski, BlaBla group.
+ * All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/****h* GGLib/htmlbench.c
+ *
+ *  NAME
+ *    htmlbench.c -- Pomiar szybkoci konwersji wiadomoci HTML na tekst.
+ *
+ *  DESCRIPTION
+ *    Program porwnuje GGMessageHTMLtoText() z poprzedni wersj konwertera (acuch
+ *    StrNCmp(), kopiowanie po bajcie) na wiadomociach w postaci wysyanej przez klientw GG,
+ *    a take samo wyszukiwanie '<' i '&': tablic GGHtmlStop (po bajcie) oraz po sowie
+ *    (SWAR). Budowany poleceniem "make bench" w katalogu gglib, uruchamiany rcznie:
+ *
+ *      bench/htmlbench [powtrzenia]
+ *
+ *    Wynik podawany jest w MB/s danych wejciowych.
+ *
+ ********/
+
+#include <proto/exec.h>
+#include <exec/types.h>
+#include <libvstring.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ggmessage.h"
+
+#define BENCH_DEFAULT_LOOPS   (20000)
+
+/* wiadomoci w postaci, w jakiej przychodz od GG 10/11, GG przez przegldark i innych klientw */
+static const char *BenchMessages[] =
+{
+	/* krtka linia z czatu */
+	"<span style=\"color:#000000; font-family:'MS Shell Dlg 2'; font-size:9pt; \">ok, zaraz bd</span>",
+
+	/* duszy akapit z polskimi znakami, encjami i przeamaniami wierszy */
+	"<span style=\"color:#000000; font-family:'MS Shell Dlg 2'; font-size:9pt; \">Cze! Przesyam "
+	"zmiany do konfiguracji, o ktre prosie. W pliku &quot;ustawienia.prefs&quot; trzeba zmieni "
+	"warto limitu z 10 na 20 &amp; zrestartowa program.<br>Jeli co nie zadziaa, daj zna - "
+	"bd przy komputerze do wieczora.<br><br>Pozdrawiam,<br>Za Gl Ja</span>",
+
+	/* tekst z emotikon i obrazkiem */
+	"<span style=\"color:#000000; font-family:'MS Shell Dlg 2'; font-size:9pt; \">zobacz to "
+	"<img name=\"9ae3e1c500001f3a\"> i to <img name=\"c2b7d0e100002b11\"></span>",
+
+	/* czat grupowy: wiele krtkich wierszy, odnoniki z &amp; */
+	"<span style=\"color:#000000; font-family:'MS Shell Dlg 2'; font-size:9pt; \">"
+	"<b>Ania:</b> kto idzie na obiad?<br><b>Marek:</b> ja<br><b>Ola:</b> za 10 minut<br>"
+	"<b>Ania:</b> http://example.com/menu?dzien=pt&amp;lokal=3<br><b>Marek:</b> &lt;3</span>",
+
+	/* GG przez przegldark: zwyky tekst bez formatowania */
+	"Spotkanie przeniesione na czwartek, godzina 14:00, sala 204. Prosz o potwierdzenie "
+	"obecnoci do jutra, ebym mg zarezerwowa odpowiednio du sal.",
+
+	NULL
+};
+
+/* poprzednia wersja GGMessageHTMLtoText(), z poprawionymi tylko jej dwoma bdami
+ * (bufor krtszy o bajt i porwnanie "<img name=\"" na czterech znakach) */
+static STRPTR BaselineHTMLtoText(STRPTR html, STRPTR *images)
+{
+	STRPTR result = NULL;
+	STRPTR html_act, result_act;
+
+	*images = NULL;
+
+	if(html && (result = AllocVec(StrLen(html) + 1, MEMF_ANY)))
+	{
+		html_act = html;
+		result_act = result;
+
+		while(*html_act != 0x00)
+		{
+			if(*html_act == '<')
+			{
+				if(!StrNCmp(html_act, "<b>", 3) || !StrNCmp(html_act, "<i>", 3) || !StrNCmp(html_act, "<u>", 3))
+					html_act += 3;
+				else if(!StrNCmp(html_act, "</b>", 4) || !StrNCmp(html_act, "</i>", 4) || !StrNCmp(html_act, "</u>", 4))
+					html_act += 4;
+				else if(!StrNCmp(html_act, "<span", 5))
+				{
+					while(*html_act != 0x00 && *html_act != '>')
+						html_act++;
+					html_act++;
+				}
+				else if(!StrNCmp(html_act, "</span>", 7))
+					html_act += 7;
+				else if(!StrNCmp(html_act, "<br>", 4))
+				{
+					html_act += 4;
+					*result_act++ = '\n';
+				}
+				else if(!StrNCmp(html_act, "<br/>", 5))
+				{
+					html_act += 5;
+					*result_act++ = '\n';
+				}
+				else if(!StrNCmp(html_act, "<img name=\"", 11))
+				{
+					STRPTR name_end = html_act + 11;
+
+					html_act += 11;
+
+					while(*name_end != 0x00 && *name_end != '"')
+						name_end++;
+
+					if(*name_end != 0x00)
+					{
+						*name_end = 0x00;
+
+						if(*images)
+						{
+							STRPTR old = *images;
+
+							*images = FmtNew("%ls|%ls", old, html_act);
+							StrFree(old);
+						}
+						else
+							*images = StrNewLen(html_act, name_end - html_act);
+
+						*name_end = '"';
+					}
+
+					while(*name_end != 0x00 && *name_end != '>')
+						name_end++;
+
+					html_act = name_end + 1;
+				}
+				else
+					*result_act++ = *html_act++;
+			}
+			else if(*html_act == '&')
+			{
+				if(!StrNCmp(html_act, "&lt;", 4))
+				{
+					html_act += 4;
+					*result_act++ = '<';
+				}
+				else if(!StrNCmp(html_act, "&gt;", 4))
+				{
+					html_act += 4;
+					*result_act++ = '>';
+				}
+				else if(!StrNCmp(html_act, "&quot;", 6))
+				{
+					html_act += 6;
+					*result_act++ = '"';
+				}
+				else if(!StrNCmp(html_act, "&apos;", 6))
+				{
+					html_act += 6;
+					*result_act++ = '\'';
+				}
+				else if(!StrNCmp(html_act, "&amp;", 5))
+				{
+					html_act += 5;
+					*result_act++ = '&';
+				}
+				else if(!StrNCmp(html_act, "&nbsp;", 6))
+				{
+					html_act += 6;
+					*result_act++ = ' ';
+				}
+				else
+					*result_act++ = *html_act++;
+			}
+			else
+				*result_act++ = *html_act++;
+		}
+		*result_act = 0x00;
+
+		if(*result == 0x00)
+		{
+			FreeVec(result);
+			result = NULL;
+		}
+	}
+
+	return result;
+}
+
+/* kopia tablicy GGHtmlStop z ggmessage.c */
+static const UBYTE BenchStop[256] = {[0x00] = 1, ['<'] = 1, ['&'] = 1};
+
+/* wyszukiwanie jak w GGMessageHTMLtoText(): jedno sprawdzenie tablicy na bajt */
+static ULONG ScanByte(const UBYTE *s)
+{
+	ULONG stops = 0;
+
+	for(;;)
+	{
+		while(!BenchStop[*s])
+			s++;
+
+		if(*s == 0x00)
+			return stops;
+
+		stops++;
+		s++;
+	}
+}
+
+#define SWAR_ONES   (0x01010101UL)
+#define SWAR_HIGHS  (0x80808080UL)
+#define SWAR_ZERO(x) (((x) - SWAR_ONES) & ~(x) & SWAR_HIGHS)
+
+/* wyszukiwanie po sowie: 0x00, '<' i '&' w czterech bajtach naraz */
+static ULONG ScanWord(const UBYTE *s)
+{
+	ULONG stops = 0;
+
+	for(;;)
+	{
+		/* do wyrwnania i po trafieniu w sowie dalej po bajcie */
+		while(((IPTR)s & 3) && !BenchStop[*s])
+			s++;
+
+		if(!((IPTR)s & 3))
+		{
+			for(;;)
+			{
+				ULONG w = *(const ULONG*)s;
+
+				if(SWAR_ZERO(w) | SWAR_ZERO(w ^ ('<' * SWAR_ONES)) | SWAR_ZERO(w ^ ('&' * SWAR_ONES)))
+					break;
+
+				s += 4;
+			}
+
+			while(!BenchStop[*s])
+				s++;
+		}
+
+		if(*s == 0x00)
+			return stops;
+
+		stops++;
+		s++;
+	}
+}
+
+static double BenchSeconds(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static VOID BenchReport(const char *name, ULONG bytes, double seconds)
+{
+	printf("%-28s %8.1f MB/s\n", name, seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+	ULONG loops = BENCH_DEFAULT_LOOPS;
+	ULONG bytes = 0, stops = 0, i, j;
+	UBYTE *work[sizeof(BenchMessages) / sizeof(BenchMessages[0])];
+	clock_t start;
+
+	if(argc > 1)
+		loops = strtoul(argv[1], NULL, 10);
+
+	/* wiadomoci kopiujemy do wyrwnanych buforw, konwertery mog je chwilowo modyfikowa */
+	for(j = 0; BenchMessages[j]; j++)
+	{
+		ULONG len = strlen(BenchMessages[j]);
+
+		if(!(work[j] = AllocVec(len + 8, MEMF_ANY | MEMF_CLEAR)))
+			return 20;
+
+		CopyMem((APTR)BenchMessages[j], work[j], len);
+		bytes += len;
+	}
+	work[j] = NULL;
+
+	printf("%lu messages, %lu bytes, %lu loops\n", j, bytes, loops);
+
+	start = clock();
+	for(i = 0; i < loops; i++)
+	{
+		for(j = 0; work[j]; j++)
+		{
+			STRPTR images, text = BaselineHTMLtoText((STRPTR)work[j], &images);
+
+			if(text)
+				FreeVec(text);
+			if(images)
+				StrFree(images);
+		}
+	}
+	BenchReport("baseline HTMLtoText", bytes * loops, BenchSeconds(start));
+
+	start = clock();
+	for(i = 0; i < loops; i++)
+	{
+		for(j = 0; work[j]; j++)
+		{
+			STRPTR images, text = GGMessageHTMLtoText((STRPTR)work[j], &images);
+
+			if(text)
+				FreeVec(text);
+			if(images)
+				FreeVec(images);
+		}
+	}
+	BenchReport("GGMessageHTMLtoText", bytes * loops, BenchSeconds(start));
+
+	start = clock();
+	for(i = 0; i < loops; i++)
+	{
+		for(j = 0; work[j]; j++)
+			stops += ScanByte(work[j]);
+	}
+	BenchReport("scan, table per byte", bytes * loops, BenchSeconds(start));
+
+	start = clock();
+	for(i = 0; i < loops; i++)
+	{
+		for(j = 0; work[j]; j++)
+			stops -= ScanWord(work[j]);
+	}
+	BenchReport("scan, word at a time", bytes * loops, BenchSeconds(start));
+
+	/* oba wyszukiwania musz znale te same miejsca */
+	if(stops != 0)
+		printf("scan mismatch!\n");
+
+	for(j = 0; work[j]; j++)
+		FreeVec(work[j]);
+
+	return 0;
+}
@@ -50,4 +50,10 @@
 #endif /* __LITTLE_ENDIAN__ */
 #endif /* __BIG_ENDIAN__ */
 
+/* odczyt wartoci Little Endian spod dowolnie wyrwnanego adresu, kompilator zamienia */
+/* __builtin_memcpy() na pojedynczy odczyt (lub odczyt z zamian bajtw, np. lwbrx)   */
+#define LoadLE64(p) ({UQUAD _v; __builtin_memcpy(&_v, (p), sizeof(_v)); (UQUAD)EndianFix64(_v);})
+#define LoadLE32(p) ({ULONG _v; __builtin_memcpy(&_v, (p), sizeof(_v)); (ULONG)EndianFix32(_v);})
+#define LoadLE16(p) ({USHORT _v; __builtin_memcpy(&_v, (p), sizeof(_v)); (USHORT)EndianFix16(_v);})
+
 #endif /* __ENDIANESS_H__ */
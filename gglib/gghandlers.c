@@ -120,7 +120,15 @@ LONG GGHandleConnected(struct GGSession *gg_sess, struct GGEvent *event)
 	struct GGPHeader *pac;
 	ENTER();
 
-	if(gg_sess->ggs_WriteBuffer != NULL) /* jeli mamy co do wysania to wysyamy */
+	/* potwierdzenia wiadomoci zebrane przez GGAcceptMessage() nie mog czeka duej ni GGS_ACK_DEADLINE */
+	if(gg_sess->ggs_AckCount > 0)
+		GGAckFlush(gg_sess, FALSE);
+
+	/* dopisujemy kolejne porcje wysyanych obrazkw, jeli kolejka wysyania si oprnia */
+	if(gg_sess->ggs_UploadHead != NULL)
+		GGImageUploadPump(gg_sess);
+
+	if(gg_sess->ggs_WriteLen > 0 && !GGWriteCorked(gg_sess)) /* jeli mamy co do wysania to wysyamy */
 	{
 		LONG res = GGWriteData(gg_sess);
 
@@ -132,19 +140,19 @@ LONG GGHandleConnected(struct GGSession *gg_sess, struct GGEvent *event)
 
 	if(gg_sess->ggs_SessionState != GGS_STATE_ERROR && (pac = GGReceivePacket(gg_sess)))
 	{
-		if(GGHandlePacket(gg_sess, event, pac))
-		{
-			/* tutaj nie ustawiamy nic w event, poniewa zdarzenie zostao
-			 * wypenione przez handler pakietu uruchomiony w GGHandlePacket() */
-			result = GGH_RETURN_WAIT;
-		}
-		else
-		{
-			event->gge_Type = GGE_TYPE_ERROR;
-			event->gge_Event.gge_Error.ggee_Errno = GGS_ERRNO_UNKNOWN_PACKET;
-			GG_SESSION_ERROR(gg_sess, GGS_ERRNO_UNKNOWN_PACKET);
-		}
-		FreeVec(pac);
+		/* tutaj nie ustawiamy nic w event, poniewa zdarzenie zostao wypenione
+		 * przez handler pakietu uruchomiony w GGHandlePacket(), a jeli pakiet zosta
+		 * porzucony (GGH_RETURN_NEXT), to od razu prbujemy odebra nastpny */
+		result = GGHandlePacket(gg_sess, event, pac);
+		/* pakiet ley w buforze odbiorczym sesji, nie zwalniamy go */
+	}
+	else if(gg_sess->ggs_SessionState == GGS_STATE_CONNECTED && GGImageUploadReport(gg_sess, event))
+	{
+		/* nic nie odebrano, zgaszamy postp lub zakoczenie wysyki obrazka */
+		if(gg_sess->ggs_Errno == GGS_ERRNO_TRYAGAIN)
+			gg_sess->ggs_Errno = GGS_ERRNO_OK;
+
+		result = GGH_RETURN_WAIT;
 	}
 	else if(gg_sess->ggs_SessionState == GGS_STATE_DISCONNECTING)
 	{
@@ -155,7 +163,7 @@ LONG GGHandleConnected(struct GGSession *gg_sess, struct GGEvent *event)
 	{
 		gg_sess->ggs_Errno = GGS_ERRNO_OK;
 		event->gge_Type = GGE_TYPE_NOOP;
-		result = GGH_RETURN_WAIT;
+		result = GGH_RETURN_BLOCK;
 	}
 	else if(gg_sess->ggs_SessionState == GGS_STATE_ERROR)
 	{
@@ -164,9 +172,17 @@ LONG GGHandleConnected(struct GGSession *gg_sess, struct GGEvent *event)
 
 	gg_sess->ggs_Check = GGS_CHECK_READ;
 
-	if(gg_sess->ggs_WriteBuffer != NULL)
+	/* wstrzymanych przez GGCork() danych nie zgaszamy, wyle je GGUncork(); przy czekajcych
+	 * obrazkach chcemy jednak wrci tu zawsze, gdy socket przyjmie kolejne dane, bo pusta
+	 * kolejka nie ma kto uzupeni */
+	if((gg_sess->ggs_WriteLen > 0 && !GGWriteCorked(gg_sess)) || gg_sess->ggs_UploadHead != NULL)
 		gg_sess->ggs_Check |= GGS_CHECK_WRITE;
 
+	/* socket nie zgosi ju gotowoci do odczytu danych, ktre OpenSSL ma u siebie,
+	 * ani zakoczonych wysyek obrazkw czekajcych na zgoszenie */
+	if(gg_sess->ggs_SessionState == GGS_STATE_CONNECTED && (GGPacketPending(gg_sess) || gg_sess->ggs_UploadDone != NULL))
+		gg_sess->ggs_Check |= GGS_CHECK_PENDING;
+
 	LEAVE();
 	return result;
 }
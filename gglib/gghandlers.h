@@ -32,7 +32,9 @@
  *    - GGH_RETURN_UNKNOWN -- nie zosta wywoany aden handler;
  *    - GGH_RETURN_NEXT -- poczenie potrzebuje ponownego wykonania GGWatchEvent;
  *    - GGH_RETURN_ERROR -- wystpi bd - stan poczenia zosta zmieniony oraz zosta ustawiony kod bdu;
- *    - GGH_RETURN_WAIT -- biblioteka potrzebuje czasu na dokoczenie dziaania, mona wrci do WaitSelect().
+ *    - GGH_RETURN_WAIT -- biblioteka potrzebuje czasu na dokoczenie dziaania, mona wrci do WaitSelect();
+ *    - GGH_RETURN_BLOCK -- brak kolejnych danych do przetworzenia, dalszy odczyt zablokowaby si,
+ *      naley wrci do WaitSelect().
  *
  *  SOURCE
  */
@@ -41,6 +43,7 @@
 #define GGH_RETURN_NEXT       (-2)
 #define GGH_RETURN_ERROR      (-1)
 #define GGH_RETURN_WAIT        (0)
+#define GGH_RETURN_BLOCK       (1)
 /*******GGH_RETURN_#?****/
 
 #include "gglib.h"
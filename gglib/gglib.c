@@ -63,7 +63,16 @@ __attribute__((section(".text.const"))) const UBYTE GGLibVTag[] = VERSTAG;
  *    - GGA_CreateSession_Status -- ULONG -- status do ustawienia po nawizaniu poczenia;
  *    - GGA_CreateSession_Status_Desc -- STRPTR -- opis statusu do ustawienia po nawizaniu poczenia,
  *       NULL oznacza brak opisu;
- *    - GGA_CreateSession_ImageSize -- UBYTE -- maksymalny rozmiar odbieranych obrazkw.
+ *    - GGA_CreateSession_ImageSize -- UBYTE -- maksymalny rozmiar odbieranych obrazkw;
+ *    - GGA_CreateSession_ZeroCopy -- BOOL -- opisy statusw w zdarzeniach GGE_TYPE_STATUS_CHANGE
+ *       i GGE_TYPE_LIST_STATUS pokazuj bezporednio na odebrany pakiet zamiast by kopiowane.
+ *       S wane do zwolnienia zdarzenia, jeli potrzebne s duej naley je skopiowa. Domylnie FALSE.
+ *    - GGA_CreateSession_EventMask -- ULONG -- maska zdarze (GGE_MASK()), ktre maj by generowane.
+ *       Pakiety pozostaych zdarze nie s dekodowane. Domylnie GGE_MASK_ALL.
+ *    - GGA_CreateSession_Roster -- BOOL -- sesja przechowuje ostatnio znane statusy kontaktw,
+ *       a zdarzenia GGE_TYPE_STATUS_CHANGE i GGE_TYPE_LIST_STATUS generowane s tylko dla
+ *       rzeczywistych zmian statusu, opisu lub rozmiaru obrazkw. Status kontaktu mona
+ *       sprawdzi funkcj GGGetPresence(). Domylnie FALSE.
  *
  *   RESULT
  *     Funkcja zwraca wskanik na struktur GGSession lub NULL w przypadku bdu.
@@ -82,7 +91,9 @@ struct GGSession *GGCreateSessionTagList(ULONG uin, STRPTR password, struct TagI
 		{
 			if((SocketBase = OpenLibrary("bsdsocket.library", 0)))
 			{
-				if((gg_sess->ggs_Pass = StrNew(password)))
+				if((gg_sess->ggs_Pass = StrNew(password)) && (gg_sess->ggs_Descriptions = InternPoolNew()) &&
+				 (!GetTagData(GGA_CreateSession_Roster, FALSE, taglist) ||
+				 (gg_sess->ggs_Roster = AllocVec(GGS_ROSTER_SIZE * sizeof(struct GGPresence*), MEMF_ANY | MEMF_CLEAR))))
 				{
 					STRPTR desc = (STRPTR)GetTagData(GGA_CreateSession_Status_Desc, (ULONG)NULL, taglist);
 					ULONG status = GetTagData(GGA_CreateSession_Status, GG_STATUS_AVAIL, taglist);
@@ -121,6 +132,10 @@ struct GGSession *GGCreateSessionTagList(ULONG uin, STRPTR password, struct TagI
 					gg_sess->ggs_Status = status;
 					gg_sess->ggs_StatusDescription = StrNew(desc);
 					gg_sess->ggs_ImageSize = GetTagData(GGA_CreateSession_Image_Size, 0, taglist);
+					gg_sess->ggs_ZeroCopy = GetTagData(GGA_CreateSession_ZeroCopy, FALSE, taglist);
+					gg_sess->ggs_EventMask = GetTagData(GGA_CreateSession_EventMask, GGE_MASK_ALL, taglist);
+					gg_sess->ggs_UploadTail = &gg_sess->ggs_UploadHead;
+					gg_sess->ggs_NotifyNo = -1;
 					gg_sess->ggs_SessionState = GGS_STATE_DISCONNECTED;
 					gg_sess->ggs_Check |= GGS_CHECK_WRITE; /* biblioteka bdzie najpierw pisa (SSL handshake) */
 					tprintf("GGCreateSession() succeded\n");
@@ -180,11 +195,40 @@ VOID GGFreeSession(struct GGSession *gg_sess)
 		if(gg_sess->ggs_StatusDescription)
 			StrFree(gg_sess->ggs_StatusDescription);
 
-		if(gg_sess->ggs_WriteBuffer)
-			FreeVec(gg_sess->ggs_WriteBuffer);
+		GGFreeWriteBuffer(gg_sess);
+		GGImageUploadFree(gg_sess);
 
-		if(gg_sess->ggs_RecvBuffer)
-			FreeVec(gg_sess->ggs_RecvBuffer);
+		if(gg_sess->ggs_RecvBlock)
+			GGRecvBlockRelease(gg_sess->ggs_RecvBlock);
+
+		while(gg_sess->ggs_EventPool)
+		{
+			struct GGEvent *event = gg_sess->ggs_EventPool;
+
+			gg_sess->ggs_EventPool = event->gge_Next;
+			FreeMem(event, sizeof(struct GGEvent));
+		}
+
+		if(gg_sess->ggs_Dispatch)
+			FreeVec(gg_sess->ggs_Dispatch);
+
+		if(gg_sess->ggs_Roster)
+		{
+			ULONG i;
+
+			for(i = 0; i < GGS_ROSTER_SIZE; i++)
+			{
+				while(gg_sess->ggs_Roster[i])
+					GGRosterRemove(gg_sess, gg_sess->ggs_Roster[i]->ggpe_Uin);
+			}
+
+			FreeVec(gg_sess->ggs_Roster);
+		}
+
+		if(gg_sess->ggs_Notify)
+			FreeVec(gg_sess->ggs_Notify);
+
+		InternPoolFree(gg_sess->ggs_Descriptions);
 
 		if(gg_sess->ggs_Pass)
 			StrFree(gg_sess->ggs_Pass);
@@ -227,6 +271,7 @@ BOOL GGConnect(struct GGSession *gg_sess, STRPTR server, USHORT port)
 		if((gg_sess->ggs_Ip = inet_addr(server)) != INADDR_NONE)
 		{
 			gg_sess->ggs_Port = port;
+			gg_sess->ggs_NotifyNo = -1; /* nowy serwer nie zna jeszcze naszej listy kontaktw */
 
 			if((gg_sess->ggs_Socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) != -1)
 			{
@@ -238,240 +283,1056 @@ BOOL GGConnect(struct GGSession *gg_sess, STRPTR server, USHORT port)
 				{
 					LONG non_block = 1;
 
-					if(IoctlSocket(gg_sess->ggs_Socket, FIONBIO, (caddr_t)&non_block) != -1)
-					{
-						struct sockaddr_in addrname = {0};
-						struct hostent *he = (struct hostent *)gethostbyname(InetToStr(gg_sess->ggs_Ip));
+					if(IoctlSocket(gg_sess->ggs_Socket, FIONBIO, (caddr_t)&non_block) != -1)
+					{
+						struct sockaddr_in addrname = {0};
+						struct hostent *he = (struct hostent *)gethostbyname(InetToStr(gg_sess->ggs_Ip));
+
+						if(he)
+						{
+							addrname.sin_port = htons(port);
+							addrname.sin_family = AF_INET;
+							addrname.sin_addr = *((struct in_addr *) he->h_addr);
+
+							if(connect(gg_sess->ggs_Socket, (struct sockaddr*)&addrname, sizeof(addrname)) != -1 || Errno() == EINPROGRESS)
+							{
+								if((gg_sess->ggs_SSLCtx = SSL_CTX_new(TLS_client_method())))
+								{
+#ifdef __DEBUG__
+									SSL_CTX_set_verify(gg_sess->ggs_SSLCtx, SSL_VERIFY_NONE, NULL);
+#endif
+
+									if ((gg_sess->ggs_SSL = SSL_new(gg_sess->ggs_SSLCtx)))
+									{
+										SSL_set_fd(gg_sess->ggs_SSL, gg_sess->ggs_Socket);
+										gg_sess->ggs_SessionState = GGS_STATE_CONNECTING;
+										gg_sess->ggs_Check |= GGS_CHECK_WRITE;
+										result = TRUE;
+									}
+									else
+										GG_SESSION_ERROR(gg_sess, GGS_ERRNO_SOCKET_LIB);
+								}
+								else
+									GG_SESSION_ERROR(gg_sess, GGS_ERRNO_SOCKET_LIB);
+							}
+							else
+								GG_SESSION_ERROR(gg_sess, GGS_ERRNO_SOCKET_LIB);
+						}
+						else
+							GG_SESSION_ERROR(gg_sess, GGS_ERRNO_SERVER_OFF);
+					}
+					else
+						GG_SESSION_ERROR(gg_sess, GGS_ERRNO_SOCKET_LIB);
+				}
+				else
+					GG_SESSION_ERROR(gg_sess, GGS_ERRNO_SOCKET_LIB);
+			}
+			else
+				GG_SESSION_ERROR(gg_sess, GGS_ERRNO_SOCKET_LIB);
+		}
+	}
+	LEAVE();
+	return result;
+}
+
+/****if* gglib.c/GGAllocEvent()
+ *
+ *  NAME
+ *    GGAllocEvent()
+ *
+ *  SYNOPSIS
+ *    static struct GGEvent *GGAllocEvent(struct GGSession *gg_sess)
+ *
+ *  FUNCTION
+ *    Funkcja pobiera wyczyszczon struktur GGEvent z puli sesji, a jeli pula jest pusta,
+ *    alokuje now.
+ *
+ *  INPUTS
+ *    gg_sess -- wskanik na struktur GGSession odpowiadajc za poczenie.
+ *
+ *  RESULT
+ *    Wskanik na struktur GGEvent typu GGE_TYPE_NOOP lub NULL w przypadku braku pamici.
+ *
+ *****/
+
+static struct GGEvent *GGAllocEvent(struct GGSession *gg_sess)
+{
+	struct GGEvent *event;
+
+	if((event = gg_sess->ggs_EventPool))
+	{
+		gg_sess->ggs_EventPool = event->gge_Next;
+		gg_sess->ggs_EventPoolSize--;
+		MemSet(event, 0, sizeof(struct GGEvent));
+	}
+	else
+		event = AllocMem(sizeof(struct GGEvent), MEMF_ANY | MEMF_CLEAR);
+
+	if(event)
+		event->gge_Type = GGE_TYPE_NOOP;
+
+	return event;
+}
+
+/****if* gglib.c/GGWatchEventLoop()
+ *
+ *  NAME
+ *    GGWatchEventLoop()
+ *
+ *  SYNOPSIS
+ *    static LONG GGWatchEventLoop(struct GGSession *gg_sess, struct GGEvent *event)
+ *
+ *  FUNCTION
+ *    Funkcja wywouje handlery odpowiednie dla stanu poczenia dopty, dopki
+ *    nie zostanie wypenione zdarzenie albo biblioteka nie bdzie musiaa czeka na socket.
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajc za obserwowane poczenie;
+ *    - event -- wskanik na struktur GGEvent do wypenienia.
+ *
+ *  RESULT
+ *    Kod powrotu ostatniego handlera z gghandlers.h (nigdy GGH_RETURN_NEXT).
+ *
+ *****/
+
+static LONG GGWatchEventLoop(struct GGSession *gg_sess, struct GGEvent *event)
+{
+	LONG handler_result;
+
+	do
+	{
+		handler_result = GGH_RETURN_UNKNOWN;
+
+		switch(gg_sess->ggs_SessionState)
+		{
+			case GGS_STATE_CONNECTING:
+				handler_result = GGHandleConnecting(gg_sess, event);
+			break;
+
+			case GGS_STATE_CONNECTED:
+				handler_result = GGHandleConnected(gg_sess, event);
+			break;
+
+			case GGS_STATE_DISCONNECTING:
+				handler_result = GGHandleDisconnecting(gg_sess, event);
+			break;
+
+			case GGS_STATE_ERROR:
+				handler_result = GGH_RETURN_ERROR;
+			break;
+		}
+	}
+	while(handler_result == GGH_RETURN_NEXT);
+
+	if(handler_result == GGH_RETURN_ERROR)
+	{
+		event->gge_Type = GGE_TYPE_ERROR;
+		event->gge_Event.gge_Error.ggee_Errno = gg_sess->ggs_Errno;
+	}
+
+	return handler_result;
+}
+
+/****f* gglib.c/GGWatchEvent()
+ *
+ *  NAME
+ *    GGWatchEvent()
+ *
+ *  SYNOPSIS
+ *    struct GGEvent *GGWatchEvent(struct GGSession *gg_sess)
+ *
+ *  FUNCTION
+ *    Funkcja suy do obserwacji poczenia z sieci GG.
+ *
+ *  INPUTS
+ *    gg_sess -- wskanik na struktur GGSession odpowiadajc za obserwowane poczenie.
+ *
+ *  RESULT
+ *    Wskanik na struktur GGEvent opisujc aktualne zdarzenie. Zdarzenie naley zwolni
+ *    funkcj GGReleaseEvent() lub GGFreeEvent().
+ *
+ *  SEE ALSO
+ *    GGWatchEvents(), GGReleaseEvent()
+ *
+ *****/
+
+struct GGEvent *GGWatchEvent(struct GGSession *gg_sess)
+{
+	struct GGEvent *event;
+	ENTER();
+
+	if((event = GGAllocEvent(gg_sess)))
+	{
+		switch(GGWatchEventLoop(gg_sess, event))
+		{
+			case GGH_RETURN_ERROR:
+			case GGH_RETURN_WAIT:
+			case GGH_RETURN_BLOCK:
+			break;
+
+			default:
+				tprintf("Unknown handler's return code!\n");
+			case GGH_RETURN_UNKNOWN:
+				tprintf("Unknown connection state!\n");
+				GGReleaseEvent(gg_sess, event);
+				event = NULL;
+		}
+	}
+
+	/* pojedyncze zdarzenie jest ca porcj, potwierdzamy od razu */
+	if(gg_sess->ggs_SessionState == GGS_STATE_CONNECTED && GGAckFlush(gg_sess, TRUE) == FALSE)
+		tprintf("GGAckFlush() failed!\n");
+
+	LEAVE();
+	return event;
+}
+
+/****f* gglib.c/GGWatchEvents()
+ *
+ *  NAME
+ *    GGWatchEvents()
+ *
+ *  SYNOPSIS
+ *    struct GGEvent *GGWatchEvents(struct GGSession *gg_sess, ULONG max)
+ *
+ *  FUNCTION
+ *    Wsadowa wersja GGWatchEvent(). Funkcja odbiera i dekoduje kolejne pakiety dopki
+ *    odczyt z socketu nie musiaby si zablokowa, poczenie nie zmieni stanu lub nie
+ *    zostanie osignity limit zdarze. Dziki temu caa porcja pakietw, ktra przysza
+ *    naraz (np. lista statusw po zalogowaniu), jest obsugiwana w jednym wywoaniu.
+ *    Na czas wywoania wysyanie jest wstrzymane (GGCork()), wic pakiety utworzone podczas
+ *    obsugi porcji wychodz razem na jej kocu. Tak samo potwierdzenia wiadomoci
+ *    (GGAcceptMessage()) tworzone s dopiero po zdekodowaniu caej porcji.
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajc za obserwowane poczenie;
+ *    - max -- maksymalna ilo zwrconych zdarze, 0 oznacza brak limitu.
+ *
+ *  RESULT
+ *    Wskanik na pierwsz struktur GGEvent listy zdarze poczonych polem gge_Next
+ *    lub NULL w przypadku bdu. Jeli nie wydarzyo si nic nowego, zwracane jest jedno
+ *    zdarzenie GGE_TYPE_NOOP. Zdarzenia GGE_TYPE_ERROR i GGE_TYPE_DISCONNECT s zawsze
+ *    ostatnie na licie. Kade zdarzenie z listy naley zwolni funkcj GGReleaseEvent()
+ *    lub GGFreeEvent().
+ *
+ *  SEE ALSO
+ *    GGWatchEvent(), GGReleaseEvent(), GGFreeEvent()
+ *
+ *****/
+
+struct GGEvent *GGWatchEvents(struct GGSession *gg_sess, ULONG max)
+{
+	struct GGEvent *first = NULL, **last = &first, *event;
+	ULONG count = 0;
+	BOOL done = FALSE;
+	ENTER();
+
+	GGCork(gg_sess);
+
+	while(!done && (event = GGAllocEvent(gg_sess)))
+	{
+		LONG handler_result;
+
+		handler_result = GGWatchEventLoop(gg_sess, event);
+
+		if(handler_result == GGH_RETURN_UNKNOWN)
+		{
+			tprintf("Unknown connection state!\n");
+			GGReleaseEvent(gg_sess, event);
+			break;
+		}
+
+		if(event->gge_Type == GGE_TYPE_NOOP)
+		{
+			/* pustych zdarze nie przekazujemy dalej */
+			GGReleaseEvent(gg_sess, event);
+		}
+		else
+		{
+			*last = event;
+			last = &event->gge_Next;
+			count++;
+
+			if(event->gge_Type == GGE_TYPE_ERROR || event->gge_Type == GGE_TYPE_DISCONNECT)
+				done = TRUE;
+		}
+
+		/* GGH_RETURN_WAIT oznacza, e obsuylimy pakiet i by moe czekaj kolejne */
+		if(handler_result != GGH_RETURN_WAIT || gg_sess->ggs_SessionState != GGS_STATE_CONNECTED)
+			done = TRUE;
+
+		if(max != 0 && count >= max)
+			done = TRUE;
+	}
+
+	/* potwierdzenia wiadomoci z caej porcji wychodz razem */
+	if(gg_sess->ggs_SessionState == GGS_STATE_CONNECTED)
+		GGAckFlush(gg_sess, TRUE);
+
+	GGUncork(gg_sess);
+
+	if(done && first == NULL)
+		first = GGAllocEvent(gg_sess);
+
+	LEAVE();
+	return first;
+}
+
+/****if* gglib.c/GGFreeEventData()
+ *
+ *  NAME
+ *    GGFreeEventData()
+ *
+ *  SYNOPSIS
+ *    static VOID GGFreeEventData(struct GGEvent *event)
+ *
+ *  FUNCTION
+ *    Funkcja zwalnia dane zaalokowane dla zdarzenia, nie zwalnia samej struktury GGEvent.
+ *
+ *  INPUTS
+ *    event -- wskanik na struktur, ktrej dane naley zwolni.
+ *
+ *****/
+
+static VOID GGFreeEventData(struct GGEvent *event)
+{
+	switch(event->gge_Type)
+	{
+		/* opisy z puli sesji (poza trybem GGA_CreateSession_ZeroCopy, gdzie zdarzenie trzyma pakiet) */
+		case GGE_TYPE_STATUS_CHANGE:
+			if(event->gge_Packet == NULL)
+				InternRelease(event->gge_Event.gge_StatusChange.ggesc_Description);
+		break;
+
+		case GGE_TYPE_LIST_STATUS:
+			if(event->gge_Packet == NULL)
+			{
+				LONG i;
+
+				for(i = 0; i < event->gge_Event.gge_ListStatus.ggels_ChangesNo; i++)
+					InternRelease(event->gge_Event.gge_ListStatus.ggels_Descriptions[i]);
+			}
+		break;
+
+		/* w razie potrzeby zwalniania czego szczeglnego dla danego typu - doda tutaj */
+		case GGE_TYPE_RECV_MSG:
+			if(event->gge_Event.gge_RecvMsg.ggerm_Txt)
+				FreeVec(event->gge_Event.gge_RecvMsg.ggerm_Txt);
+			if(event->gge_Event.gge_RecvMsg.ggerm_ImagesIds)
+				FreeVec(event->gge_Event.gge_RecvMsg.ggerm_ImagesIds);
+		break;
+
+		case GGE_TYPE_LIST_IMPORT:
+			if(event->gge_Event.gge_ListImport.ggeli_Data)
+				FreeVec(event->gge_Event.gge_ListImport.ggeli_Data);
+		break;
+
+		case GGE_TYPE_IMAGE_DATA:
+			if(event->gge_Event.gge_ImageData.ggeid_FileName)
+				StrFree(event->gge_Event.gge_ImageData.ggeid_FileName);
+			if(event->gge_Event.gge_ImageData.ggeid_Data)
+				FreeMem(event->gge_Event.gge_ImageData.ggeid_Data, event->gge_Event.gge_ImageData.ggeid_DataSize);
+		break;
+	}
+
+	/* dane opisw, tablic kontaktw i katalogu publicznego le w arenie zdarzenia */
+	if(event->gge_Arena)
+	{
+		ArenaFree(event->gge_Arena);
+		event->gge_Arena = NULL;
+	}
+
+	/* opisy w trybie GGA_CreateSession_ZeroCopy i HTML wiadomoci pokazuj na bufor odbiorczy */
+	if(event->gge_Packet)
+	{
+		GGRecvBlockRelease(event->gge_Packet);
+		event->gge_Packet = NULL;
+	}
+}
+
+/****f* gglib.c/GGFreeEvent()
+ *
+ *  NAME
+ *    GGFreeEvent()
+ *
+ *  SYNOPSIS
+ *    VOID GGFreeEvent(struct GGEvent *event)
+ *
+ *  FUNCTION
+ *    Funkcja suy do zwalniania pamici zaalokowanej na struktur GGEvent.
+ *
+ *  INPUTS
+ *    event -- wskanik na struktur do zwolnienia.
+ *
+ *  SEE ALSO
+ *    GGReleaseEvent()
+ *
+ *****/
+
+VOID GGFreeEvent(struct GGEvent *event)
+{
+	if(event)
+	{
+		GGFreeEventData(event);
+		FreeMem(event, sizeof(struct GGEvent));
+	}
+}
+
+/****f* gglib.c/GGReleaseEvent()
+ *
+ *  NAME
+ *    GGReleaseEvent()
+ *
+ *  SYNOPSIS
+ *    VOID GGReleaseEvent(struct GGSession *gg_sess, struct GGEvent *event)
+ *
+ *  FUNCTION
+ *    Funkcja zwalnia dane zdarzenia, a sam struktur GGEvent oddaje do puli sesji,
+ *    z ktrej bd brane kolejne zdarzenia. Jeli pula jest pena lub sesja nie istnieje,
+ *    zdarzenie jest zwalniane tak jak w GGFreeEvent().
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession, z ktrej pochodzi zdarzenie, moe by NULL;
+ *    - event -- wskanik na struktur do zwolnienia.
+ *
+ *  SEE ALSO
+ *    GGFreeEvent(), GGWatchEvent(), GGWatchEvents()
+ *
+ *****/
+
+VOID GGReleaseEvent(struct GGSession *gg_sess, struct GGEvent *event)
+{
+	if(event)
+	{
+		if(gg_sess && gg_sess->ggs_EventPoolSize < GGS_EVENT_POOL_MAX)
+		{
+			GGFreeEventData(event);
+			event->gge_Next = gg_sess->ggs_EventPool;
+			gg_sess->ggs_EventPool = event;
+			gg_sess->ggs_EventPoolSize++;
+		}
+		else
+			GGFreeEvent(event);
+	}
+}
+
+/****f* gglib.c/GGSetPacketHandler()
+ *
+ *  NAME
+ *    GGSetPacketHandler()
+ *
+ *  SYNOPSIS
+ *    BOOL GGSetPacketHandler(struct GGSession *gg_sess, ULONG type, GGPacketHandlerFunc handler, ULONG flags)
+ *
+ *  FUNCTION
+ *    Funkcja ustawia dla sesji handler odebranych pakietw typu type, zastpujc handler
+ *    wbudowany lub dodajc obsug pakietu nieznanego bibliotece. Przy pierwszym wywoaniu
+ *    sesja dostaje wasn kopi domylnej tablicy handlerw.
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajc za poczenie;
+ *    - type -- typ pakietu (mniejszy ni GGP_DISPATCH_SIZE);
+ *    - handler -- funkcja obsugujca pakiet lub NULL, aby przywrci handler wbudowany;
+ *    - flags -- flagi:
+ *     - GG_PACKET_IGNORE -- pakiety tego typu s porzucane bez generowania zdarzenia.
+ *
+ *   RESULT
+ *    - TRUE -- jeli si udao;
+ *    - FALSE -- w.p.p.
+ *
+ *   SEE ALSO
+ *    GGPacketHandlerFunc
+ *
+ *****/
+
+BOOL GGSetPacketHandler(struct GGSession *gg_sess, ULONG type, GGPacketHandlerFunc handler, ULONG flags)
+{
+	BOOL result = FALSE;
+	ENTER();
+
+	if(gg_sess && type < GGP_DISPATCH_SIZE)
+	{
+		if(gg_sess->ggs_Dispatch == NULL &&
+		 (gg_sess->ggs_Dispatch = AllocVec(sizeof(GGPacketDispatchDefault), MEMF_ANY)))
+		{
+			CopyMem((APTR)GGPacketDispatchDefault, gg_sess->ggs_Dispatch, sizeof(GGPacketDispatchDefault));
+		}
+
+		if(gg_sess->ggs_Dispatch)
+		{
+			if(handler)
+			{
+				gg_sess->ggs_Dispatch[type].ggpd_Handler = handler;
+				gg_sess->ggs_Dispatch[type].ggpd_MinLength = 0;
+				gg_sess->ggs_Dispatch[type].ggpd_Event = GGE_TYPE_NOOP;
+			}
+			else
+			{
+				gg_sess->ggs_Dispatch[type] = GGPacketDispatchDefault[type];
+			}
+
+			gg_sess->ggs_Dispatch[type].ggpd_Flags = flags;
+			result = TRUE;
+		}
+	}
+
+	LEAVE();
+	return result;
+}
+
+/****f* gglib.c/GGSetEventMask()
+ *
+ *  NAME
+ *    GGSetEventMask()
+ *
+ *  SYNOPSIS
+ *    VOID GGSetEventMask(struct GGSession *gg_sess, ULONG mask)
+ *
+ *  FUNCTION
+ *    Funkcja zmienia mask zdarze generowanych przez sesj. Pakiety, ktrych zdarzenia
+ *    nie ma w masce, s odbierane i porzucane bez dekodowania. Pakiety wymagajce odpowiedzi
+ *    (np. wiadomoci, ktre trzeba potwierdzi) s obsugiwane zawsze.
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajc za poczenie;
+ *    - mask -- suma masek GGE_MASK() zdarze, ktre maj by generowane, lub GGE_MASK_ALL.
+ *
+ *   SEE ALSO
+ *    GGE_MASK(), GGA_CreateSession_EventMask
+ *
+ *****/
+
+VOID GGSetEventMask(struct GGSession *gg_sess, ULONG mask)
+{
+	if(gg_sess)
+		gg_sess->ggs_EventMask = mask;
+}
+
+/****f* gglib.c/GGCork()
+ *
+ *  NAME
+ *    GGCork()
+ *
+ *  SYNOPSIS
+ *    VOID GGCork(struct GGSession *gg_sess)
+ *
+ *  FUNCTION
+ *    Funkcja wstrzymuje wysyanie pakietw tworzonych przez funkcje biblioteki (GGChangeStatus(),
+ *    GGSendMessage() i inne) do czasu wywoania GGUncork(), tak eby kilka pakietw zostao
+ *    wysanych razem, w jak najmniejszej iloci rekordw TLS. Wywoania mona zagnieda.
+ *    Dane s wysyane mimo wstrzymania, jeli uzbiera si ich na peny rekord TLS lub od
+ *    wywoania GGCork() minie GGS_CORK_DEADLINE, ale termin sprawdzany jest tylko przy
+ *    obsudze zdarze, dlatego kade GGCork() naley zakoczy wywoaniem GGUncork().
+ *
+ *    GGWatchEvents() wstrzymuje wysyanie na czas obsugi caej porcji pakietw.
+ *
+ *  INPUTS
+ *    gg_sess -- wskanik na struktur GGSession odpowiadajc za poczenie.
+ *
+ *  SEE ALSO
+ *    GGUncork(), GGWatchEvents()
+ *
+ *****/
+
+VOID GGCork(struct GGSession *gg_sess)
+{
+	if(gg_sess)
+		GGCorkBegin(gg_sess);
+}
+
+/****f* gglib.c/GGUncork()
+ *
+ *  NAME
+ *    GGUncork()
+ *
+ *  SYNOPSIS
+ *    VOID GGUncork(struct GGSession *gg_sess)
+ *
+ *  FUNCTION
+ *    Funkcja koczy wstrzymanie wysyania rozpoczte przez GGCork(). Po zakoczeniu ostatniego
+ *    zagniedonego wstrzymania zebrane dane s od razu wysyane, a ich reszta, ktrej socket
+ *    nie przyj, czeka na gotowo socketu do zapisu (GG_SESSION_CHECK_WRITE()). Na gotowo
+ *    do zapisu czekaj te rozpoczte wysyki obrazkw, nawet jeli kolejka jest pusta.
+ *
+ *  INPUTS
+ *    gg_sess -- wskanik na struktur GGSession odpowiadajc za poczenie.
+ *
+ *  SEE ALSO
+ *    GGCork()
+ *
+ *****/
+
+VOID GGUncork(struct GGSession *gg_sess)
+{
+	ENTER();
+
+	if(gg_sess && gg_sess->ggs_Cork > 0 && --gg_sess->ggs_Cork == 0 && (gg_sess->ggs_WriteLen > 0 || gg_sess->ggs_UploadHead != NULL))
+	{
+		if(gg_sess->ggs_SessionState == GGS_STATE_CONNECTED)
+		{
+			if(gg_sess->ggs_UploadHead != NULL)
+				GGImageUploadPump(gg_sess);
+
+			if(gg_sess->ggs_WriteLen > 0)
+				GGWriteData(gg_sess);
+		}
+
+		if(gg_sess->ggs_WriteLen > 0 || gg_sess->ggs_UploadHead != NULL)
+			gg_sess->ggs_Check |= GGS_CHECK_WRITE;
+	}
+
+	LEAVE();
+}
+
+/****f* gglib.c/GGClock()
+ *
+ *  NAME
+ *    GGClock()
+ *
+ *  SYNOPSIS
+ *    ULONG GGClock(VOID)
+ *
+ *  FUNCTION
+ *    Funkcja zwraca biecy czas w tickach DateStamp() (1/TICKS_PER_SECOND s). Suy do
+ *    odmierzania terminw (GGS_CORK_DEADLINE, GGS_ACK_DEADLINE), take poza bibliotek.
+ *
+ *  RESULT
+ *    Czas w tickach. Warto przekrca si po ok. 2,7 roku, dlatego naley uywa
+ *    tylko rnic dwch wynikw, liczonych modulo 2^32.
+ *
+ *****/
+
+ULONG GGClock(VOID)
+{
+	struct DateStamp ds;
+
+	DateStamp(&ds);
+
+	return ((ULONG)ds.ds_Days * 24 * 60 + ds.ds_Minute) * 60 * TICKS_PER_SECOND + ds.ds_Tick;
+}
+
+/****f* gglib.c/GGGetPresence()
+ *
+ *  NAME
+ *    GGGetPresence()
+ *
+ *  SYNOPSIS
+ *    struct GGPresence *GGGetPresence(struct GGSession *gg_sess, ULONG uin)
+ *
+ *  FUNCTION
+ *    Funkcja zwraca ostatnio znany status kontaktu z tablicy statusw sesji.
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajc za poczenie;
+ *    - uin -- numer GG kontaktu.
+ *
+ *  RESULT
+ *    Wskanik na struktur GGPresence lub NULL, jeli status kontaktu nie jest znany lub sesja
+ *    nie zostaa utworzona z tagiem GGA_CreateSession_Roster. Struktury nie wolno modyfikowa,
+ *    jest wana do nastpnego wywoania GGWatchEvent(), GGWatchEvents() lub GGRemoveNotify().
+ *
+ *  SEE ALSO
+ *    GGPresence, GGA_CreateSession_Roster
+ *
+ *****/
+
+struct GGPresence *GGGetPresence(struct GGSession *gg_sess, ULONG uin)
+{
+	struct GGPresence *p = NULL;
+
+	if(gg_sess && gg_sess->ggs_Roster)
+	{
+		for(p = gg_sess->ggs_Roster[GGS_ROSTER_HASH(uin)]; p; p = p->ggpe_Next)
+		{
+			if(p->ggpe_Uin == uin)
+				break;
+		}
+	}
+
+	return p;
+}
+
+/* konwertuje HTML wiadomoci przy pierwszym wywoaniu GGGetMessageText() lub GGGetMessageImages() */
+static VOID GGConvertMessage(struct GGEventRecvMsg *rm)
+{
+	if(!rm->ggerm_Converted)
+	{
+		rm->ggerm_Txt = GGMessageHTMLtoText(rm->ggerm_Html, &rm->ggerm_ImagesIds);
+		rm->ggerm_Converted = TRUE;
+	}
+}
+
+/****f* gglib.c/GGGetMessageText()
+ *
+ *  NAME
+ *    GGGetMessageText()
+ *
+ *  SYNOPSIS
+ *    STRPTR GGGetMessageText(struct GGEventRecvMsg *rm)
+ *
+ *  FUNCTION
+ *    Funkcja zwraca tre odebranej wiadomoci czystym tekstem. Konwersja z HTML-a wykonywana
+ *    jest tylko przy pierwszym wywoaniu dla danego zdarzenia (razem z GGGetMessageImages()),
+ *    dziki czemu zdarzenia przekazujce dalej sam HTML nie ponosz jej kosztu.
+ *
+ *  INPUTS
+ *    rm -- wskanik na struktur GGEventRecvMsg zdarzenia GGE_TYPE_RECV_MSG.
+ *
+ *  RESULT
+ *    Tre wiadomoci w kodowaniu UTF-8 lub NULL, jeli wiadomo nie zawiera tekstu
+ *    (tylko obrazki) lub zabrako pamici. Bufor zwalnia GGFreeEvent().
+ *
+ *  SEE ALSO
+ *    GGGetMessageImages(), GGEventRecvMsg
+ *
+ *****/
+
+STRPTR GGGetMessageText(struct GGEventRecvMsg *rm)
+{
+	GGConvertMessage(rm);
+	return rm->ggerm_Txt;
+}
+
+/****f* gglib.c/GGGetMessageImages()
+ *
+ *  NAME
+ *    GGGetMessageImages()
+ *
+ *  SYNOPSIS
+ *    STRPTR GGGetMessageImages(struct GGEventRecvMsg *rm)
+ *
+ *  FUNCTION
+ *    Funkcja zwraca identyfikatory obrazkw wstawionych do odebranej wiadomoci, oddzielone
+ *    znakiem '|'. Konwersja z HTML-a wykonywana jest tylko raz, tak jak w GGGetMessageText().
+ *
+ *  INPUTS
+ *    rm -- wskanik na struktur GGEventRecvMsg zdarzenia GGE_TYPE_RECV_MSG.
+ *
+ *  RESULT
+ *    Identyfikatory obrazkw lub NULL, jeli wiadomo ich nie zawiera. Bufor zwalnia GGFreeEvent().
+ *
+ *  SEE ALSO
+ *    GGGetMessageText(), GGEventRecvMsg
+ *
+ *****/
+
+STRPTR GGGetMessageImages(struct GGEventRecvMsg *rm)
+{
+	GGConvertMessage(rm);
+	return rm->ggerm_ImagesIds;
+}
+
+/****if* gglib.c/GGNotifySort()
+ *
+ *  NAME
+ *    GGNotifySort()
+ *
+ *  SYNOPSIS
+ *    static struct GGNotifyEntry *GGNotifySort(struct GGNotifyEntry *src, struct GGNotifyEntry *tmp, LONG no)
+ *
+ *  FUNCTION
+ *    Sortuje wpisy listy kontaktw wedug numeru (stabilne sortowanie przez scalanie, bez
+ *    rekurencji). Kolejne przebiegi scalaj dane na przemian midzy tablicami src i tmp.
+ *
+ *  INPUTS
+ *    - src -- tablica no wpisw do posortowania;
+ *    - tmp -- tablica pomocnicza na no wpisw;
+ *    - no -- ilo wpisw.
+ *
+ *  RESULT
+ *    Wskanik na posortowane wpisy: src lub tmp, zalenie od iloci przebiegw.
+ *
+ *****/
+
+static struct GGNotifyEntry *GGNotifySort(struct GGNotifyEntry *src, struct GGNotifyEntry *tmp, LONG no)
+{
+	LONG width;
+
+	for(width = 1; width < no; width *= 2)
+	{
+		struct GGNotifyEntry *swap;
+		LONG i;
+
+		for(i = 0; i < no; i += 2 * width)
+		{
+			LONG a = i, b = i + width, k = i;
+			LONG a_end = b < no ? b : no;
+			LONG b_end = b + width < no ? b + width : no;
+
+			while(a < a_end && b < b_end)
+				tmp[k++] = src[b].ggne_Uin < src[a].ggne_Uin ? src[b++] : src[a++];
+			while(a < a_end)
+				tmp[k++] = src[a++];
+			while(b < b_end)
+				tmp[k++] = src[b++];
+		}
+
+		swap = src;
+		src = tmp;
+		tmp = swap;
+	}
+
+	return src;
+}
+
+/****if* gglib.c/GGNotifySend()
+ *
+ *  NAME
+ *    GGNotifySend()
+ *
+ *  SYNOPSIS
+ *    static BOOL GGNotifySend(struct GGSession *gg_sess, ULONG type, ULONG uin, UBYTE user_type)
+ *
+ *  FUNCTION
+ *    Funkcja dodaje do kolejki wysyania pakiet GGP_TYPE_ADD_NOTIFY lub GGP_TYPE_REMOVE_NOTIFY
+ *    dla jednego kontaktu.
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajc za poczenie;
+ *    - type -- typ pakietu;
+ *    - uin -- numer kontaktu;
+ *    - user_type -- typ kontaktu (GG_USER_#?).
+ *
+ *  RESULT
+ *    - TRUE -- jeli pakiet trafi do kolejki;
+ *    - FALSE -- w.p.p.
+ *
+ *****/
+
+static BOOL GGNotifySend(struct GGSession *gg_sess, ULONG type, ULONG uin, UBYTE user_type)
+{
+	struct GGPacketBuilder pb;
+	struct GGPNotify *n;
+	BOOL result = FALSE;
+
+	if((n = GGPacketBeginFixed(gg_sess, &pb, type, GGPNotify)))
+	{
+		n->ggpn_Uin = EndianFix32(uin);
+		n->ggpn_Type = user_type;
+		result = GGPacketCommit(&pb);
+	}
+
+	return result;
+}
+
+/****if* gglib.c/GGNotifySendFull()
+ *
+ *  NAME
+ *    GGNotifySendFull()
+ *
+ *  SYNOPSIS
+ *    static BOOL GGNotifySendFull(struct GGSession *gg_sess, struct GGNotifyEntry *list, LONG no)
+ *
+ *  FUNCTION
+ *    Funkcja wysya ca list kontaktw w pakietach GGP_TYPE_NOTIFY_NORMAL po GGP_NOTIFY_LIST_MAX
+ *    kontaktw, zakoczonych pakietem GGP_TYPE_NOTIFY_LAST. Pusta lista wysyana jest jako
+ *    GGP_TYPE_LIST_EMPTY.
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajc za poczenie;
+ *    - list -- tablica kontaktw;
+ *    - no -- ilo kontaktw w tablicy.
+ *
+ *  RESULT
+ *    - TRUE -- jeli wszystkie pakiety trafiy do kolejki;
+ *    - FALSE -- w.p.p.
+ *
+ *****/
+
+static BOOL GGNotifySendFull(struct GGSession *gg_sess, struct GGNotifyEntry *list, LONG no)
+{
+	struct GGPacketBuilder pb;
+	BOOL result = TRUE;
+	LONG i, j;
 
-						if(he)
-						{
-							addrname.sin_port = htons(port);
-							addrname.sin_family = AF_INET;
-							addrname.sin_addr = *((struct in_addr *) he->h_addr);
+	if(no == 0)
+	{
+		if((result = GGPacketBegin(gg_sess, &pb, GGP_TYPE_LIST_EMPTY, GGP_SIZE_LIST_EMPTY)))
+			result = GGPacketCommit(&pb);
+	}
 
-							if(connect(gg_sess->ggs_Socket, (struct sockaddr*)&addrname, sizeof(addrname)) != -1 || Errno() == EINPROGRESS)
-							{
-								if((gg_sess->ggs_SSLCtx = SSL_CTX_new(TLS_client_method())))
-								{
-#ifdef __DEBUG__
-									SSL_CTX_set_verify(gg_sess->ggs_SSLCtx, SSL_VERIFY_NONE, NULL);
-#endif
+	for(i = 0; i < no && result; i += GGP_NOTIFY_LIST_MAX)
+	{
+		LONG chunk = (no - i > GGP_NOTIFY_LIST_MAX) ? GGP_NOTIFY_LIST_MAX : no - i;
+		ULONG type = (i + chunk < no) ? GGP_TYPE_NOTIFY_NORMAL : GGP_TYPE_NOTIFY_LAST;
 
-									if ((gg_sess->ggs_SSL = SSL_new(gg_sess->ggs_SSLCtx)))
-									{
-										SSL_set_fd(gg_sess->ggs_SSL, gg_sess->ggs_Socket);
-										gg_sess->ggs_SessionState = GGS_STATE_CONNECTING;
-										gg_sess->ggs_Check |= GGS_CHECK_WRITE;
-										result = TRUE;
-									}
-									else
-										GG_SESSION_ERROR(gg_sess, GGS_ERRNO_SOCKET_LIB);
-								}
-								else
-									GG_SESSION_ERROR(gg_sess, GGS_ERRNO_SOCKET_LIB);
-							}
-							else
-								GG_SESSION_ERROR(gg_sess, GGS_ERRNO_SOCKET_LIB);
-						}
-						else
-							GG_SESSION_ERROR(gg_sess, GGS_ERRNO_SERVER_OFF);
-					}
-					else
-						GG_SESSION_ERROR(gg_sess, GGS_ERRNO_SOCKET_LIB);
-				}
-				else
-					GG_SESSION_ERROR(gg_sess, GGS_ERRNO_SOCKET_LIB);
+		if((result = GGPacketBegin(gg_sess, &pb, type, chunk * sizeof(struct GGPNotify))))
+		{
+			for(j = i; j < i + chunk; j++)
+			{
+				GGPacketPutULONG(&pb, list[j].ggne_Uin);
+				GGPacketPutUBYTE(&pb, list[j].ggne_Type);
 			}
-			else
-				GG_SESSION_ERROR(gg_sess, GGS_ERRNO_SOCKET_LIB);
+
+			result = GGPacketCommit(&pb);
 		}
 	}
-	LEAVE();
+
 	return result;
 }
 
-/****f* gglib.c/GGWatchEvent()
+/****if* gglib.c/GGNotifyDelta()
  *
  *  NAME
- *    GGWatchEvent()
+ *    GGNotifyDelta()
  *
  *  SYNOPSIS
- *    struct GGEvent *GGWatchEvent(struct GGSession *gg_sess)
+ *    static LONG GGNotifyDelta(struct GGSession *gg_sess, struct GGNotifyEntry *list, LONG no, BOOL send)
  *
  *  FUNCTION
- *    Funkcja suy do obserwacji poczenia z sieci GG.
+ *    Funkcja porwnuje (przez scalanie posortowanych list) now list kontaktw z list
+ *    znan serwerowi (ggs_Notify). Kontakty, ktrych nie ma w nowej licie, s usuwane
+ *    pakietem GGP_TYPE_REMOVE_NOTIFY, nowe dodawane pakietem GGP_TYPE_ADD_NOTIFY, a kontakty
+ *    ze zmienionym typem usuwane i dodawane ponownie. Jeli send jest rwne FALSE, funkcja
+ *    tylko liczy potrzebne pakiety.
  *
  *  INPUTS
- *    gg_sess -- wskanik na struktur GGSession odpowiadajc za obserwowane poczenie.
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajc za poczenie;
+ *    - list -- nowa lista kontaktw, posortowana wedug numeru, bez powtrze;
+ *    - no -- ilo kontaktw w list;
+ *    - send -- TRUE jeli pakiety maj zosta dodane do kolejki wysyania.
  *
  *  RESULT
- *    Wskanik na struktur GGEvent opisujc aktualne zdarzenie.
+ *    Ilo pakietw opisujcych zmiany lub -1, jeli nie udao si doda ich do kolejki.
  *
  *****/
 
-struct GGEvent *GGWatchEvent(struct GGSession *gg_sess)
+static LONG GGNotifyDelta(struct GGSession *gg_sess, struct GGNotifyEntry *list, LONG no, BOOL send)
 {
-	struct GGEvent *event;
-	ENTER();
+	struct GGNotifyEntry *old = gg_sess->ggs_Notify;
+	LONG old_no = gg_sess->ggs_NotifyNo;
+	LONG i = 0, j = 0, packets = 0;
 
-	if((event = AllocMem(sizeof(struct GGEvent), MEMF_ANY | MEMF_CLEAR)))
+	while(i < old_no || j < no)
 	{
-		event->gge_Type = GGE_TYPE_NOOP;
+		struct GGNotifyEntry *remove = NULL, *add = NULL;
 
-		while(TRUE)
+		if(j == no || (i < old_no && old[i].ggne_Uin < list[j].ggne_Uin))
+			remove = &old[i++];
+		else if(i == old_no || old[i].ggne_Uin > list[j].ggne_Uin)
+			add = &list[j++];
+		else
 		{
-			LONG handler_result = GGH_RETURN_UNKNOWN;
-
-			switch(gg_sess->ggs_SessionState)
+			if(old[i].ggne_Type != list[j].ggne_Type)
 			{
-				case GGS_STATE_CONNECTING:
-					handler_result = GGHandleConnecting(gg_sess, event);
-				break;
+				remove = &old[i];
+				add = &list[j];
+			}
+			i++;
+			j++;
+		}
 
-				case GGS_STATE_CONNECTED:
-					handler_result = GGHandleConnected(gg_sess, event);
-				break;
+		if(remove)
+		{
+			packets++;
 
-				case GGS_STATE_DISCONNECTING:
-					handler_result = GGHandleDisconnecting(gg_sess, event);
-				break;
+			if(send)
+			{
+				if(!GGNotifySend(gg_sess, GGP_TYPE_REMOVE_NOTIFY, remove->ggne_Uin, remove->ggne_Type))
+					return -1;
 
-				case GGS_STATE_ERROR:
-					handler_result = GGH_RETURN_ERROR;
-				break;
+				/* po ponownym dodaniu kontaktu jego status ma zosta zgoszony */
+				if(gg_sess->ggs_Roster)
+					GGRosterRemove(gg_sess, remove->ggne_Uin);
 			}
+		}
 
-			switch(handler_result)
-			{
-				case GGH_RETURN_NEXT:
-				continue;
-
-				default:
-					tprintf("Unknown handler's return code!\n");
-				case GGH_RETURN_UNKNOWN:
-					tprintf("Unknown connection state!\n");
-					GGFreeEvent(event);
-					return NULL;
-				case GGH_RETURN_ERROR:
-					event->gge_Type = GGE_TYPE_ERROR;
-					event->gge_Event.gge_Error.ggee_Errno = gg_sess->ggs_Errno;
-				case GGH_RETURN_WAIT:
-					LEAVE();
-				return event;
-			}
+		if(add)
+		{
+			packets++;
+
+			if(send && !GGNotifySend(gg_sess, GGP_TYPE_ADD_NOTIFY, add->ggne_Uin, add->ggne_Type))
+				return -1;
 		}
 	}
 
-	LEAVE();
-	return event;
+	return packets;
 }
 
-/****f* gglib.c/GGFreeEvent()
+/****if* gglib.c/GGNotifyUpdate()
  *
  *  NAME
- *    GGFreeEvent()
+ *    GGNotifyUpdate()
  *
  *  SYNOPSIS
- *    VOID GGFreeEvent(struct GGEvent *event)
+ *    static VOID GGNotifyUpdate(struct GGSession *gg_sess, ULONG uin, UBYTE type, BOOL add)
  *
  *  FUNCTION
- *    Funkcja suy do zwalniania pamici zaalokowanej na struktur GGEvent.
+ *    Funkcja nanosi na zapamitan list kontaktw (ggs_Notify) zmian wysan przez
+ *    GGAddNotify() lub GGRemoveNotify(). Jeli zabraknie pamici, lista jest zapominana
+ *    i nastpne wywoanie GGNotifyList() wyle j w caoci.
  *
  *  INPUTS
- *    event -- wskanik na struktur do zwolnienia.
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajc za poczenie;
+ *    - uin -- numer kontaktu;
+ *    - type -- typ kontaktu;
+ *    - add -- TRUE jeli kontakt zosta dodany, FALSE jeli usunity.
  *
  *****/
 
-VOID GGFreeEvent(struct GGEvent *event)
+static VOID GGNotifyUpdate(struct GGSession *gg_sess, ULONG uin, UBYTE type, BOOL add)
 {
-	if(event)
-	{
-		switch(event->gge_Type)
-		{
-			/* w razie potrzeby zwalniania czego szczeglnego dla danego typu - doda tutaj */
-			case GGE_TYPE_STATUS_CHANGE:
-				if(event->gge_Event.gge_StatusChange.ggesc_Description)
-					FreeVec(event->gge_Event.gge_StatusChange.ggesc_Description);
-			break;
-
-			case GGE_TYPE_LIST_STATUS:
-				if(event->gge_Event.gge_ListStatus.ggels_StatusChanges)
-					FreeVec(event->gge_Event.gge_ListStatus.ggels_StatusChanges);
-			break;
+	LONG low = 0, high = gg_sess->ggs_NotifyNo;
 
-			case GGE_TYPE_RECV_MSG:
-				if(event->gge_Event.gge_RecvMsg.ggerm_Txt)
-					FreeVec(event->gge_Event.gge_RecvMsg.ggerm_Txt);
-				if(event->gge_Event.gge_RecvMsg.ggerm_ImagesIds)
-					FreeVec(event->gge_Event.gge_RecvMsg.ggerm_ImagesIds);
-			break;
+	if(gg_sess->ggs_NotifyNo < 0)
+		return;
 
-			case GGE_TYPE_USER_DATA:
-				if(event->gge_Event.gge_UsersData.ggeud_Data)
-				{
-					LONG i;
+	while(low < high)
+	{
+		LONG mid = (low + high) / 2;
 
-					for(i = 0; i < event->gge_Event.gge_UsersData.ggeud_UsersNo; i++)
-					{
-						if(event->gge_Event.gge_UsersData.ggeud_Data[i].ggud_Attrs)
-						{
-							LONG j;
+		if(gg_sess->ggs_Notify[mid].ggne_Uin < uin)
+			low = mid + 1;
+		else
+			high = mid;
+	}
 
-							for(j = 0; j < event->gge_Event.gge_UsersData.ggeud_Data[i].ggud_AttrsNo; j++)
-							{
-								if(event->gge_Event.gge_UsersData.ggeud_Data[i].ggud_Attrs[j].gguda_Key)
-									StrFree(event->gge_Event.gge_UsersData.ggeud_Data[i].ggud_Attrs[j].gguda_Key);
+	if(low < gg_sess->ggs_NotifyNo && gg_sess->ggs_Notify[low].ggne_Uin == uin)
+	{
+		if(add)
+			gg_sess->ggs_Notify[low].ggne_Type = type;
+		else
+		{
+			LONG i;
 
-								if(event->gge_Event.gge_UsersData.ggeud_Data[i].ggud_Attrs[j].gguda_Value)
-									StrFree(event->gge_Event.gge_UsersData.ggeud_Data[i].ggud_Attrs[j].gguda_Value);
-							}
-							FreeMem(event->gge_Event.gge_UsersData.ggeud_Data[i].ggud_Attrs, sizeof(struct GGUserDataAttr) * event->gge_Event.gge_UsersData.ggeud_Data[i].ggud_AttrsNo);
-						}
-					}
-					FreeMem(event->gge_Event.gge_UsersData.ggeud_Data, sizeof(struct GGUserData) * event->gge_Event.gge_UsersData.ggeud_UsersNo);
-				}
-			break;
+			for(i = low + 1; i < gg_sess->ggs_NotifyNo; i++)
+				gg_sess->ggs_Notify[i - 1] = gg_sess->ggs_Notify[i];
 
-			case GGE_TYPE_LIST_IMPORT:
-				if(event->gge_Event.gge_ListImport.ggeli_Data)
-					FreeVec(event->gge_Event.gge_ListImport.ggeli_Data);
-			break;
+			gg_sess->ggs_NotifyNo--;
+		}
+	}
+	else if(add)
+	{
+		LONG i;
 
-			case GGE_TYPE_MULTILOGON_INFO:
-				if(event->gge_Event.gge_MultilogonInfo.ggemi_Data)
-				{
-					LONG i;
+		if(gg_sess->ggs_NotifyNo == gg_sess->ggs_NotifySize)
+		{
+			LONG size = gg_sess->ggs_NotifySize + GGS_NOTIFY_GROW;
+			struct GGNotifyEntry *list;
 
-					for(i = 0; i < event->gge_Event.gge_MultilogonInfo.ggemi_No; i++)
-					{
-						if(event->gge_Event.gge_MultilogonInfo.ggemi_Data[i].ggmi_Name)
-							StrFree(event->gge_Event.gge_MultilogonInfo.ggemi_Data[i].ggmi_Name);
-					}
-					FreeMem(event->gge_Event.gge_MultilogonInfo.ggemi_Data, sizeof(struct GGMultilogonInfo) * event->gge_Event.gge_MultilogonInfo.ggemi_No);
-				}
-			break;
+			if(!(list = AllocVec(size * sizeof(struct GGNotifyEntry), MEMF_ANY)))
+			{
+				gg_sess->ggs_NotifyNo = -1;
+				return;
+			}
 
-			case GGE_TYPE_IMAGE_DATA:
-				if(event->gge_Event.gge_ImageData.ggeid_FileName)
-					StrFree(event->gge_Event.gge_ImageData.ggeid_FileName);
-				if(event->gge_Event.gge_ImageData.ggeid_Data)
-					FreeMem(event->gge_Event.gge_ImageData.ggeid_Data, event->gge_Event.gge_ImageData.ggeid_DataSize);
-			break;
+			if(gg_sess->ggs_Notify)
+			{
+				CopyMem(gg_sess->ggs_Notify, list, gg_sess->ggs_NotifyNo * sizeof(struct GGNotifyEntry));
+				FreeVec(gg_sess->ggs_Notify);
+			}
 
-			case GGE_TYPE_PUBDIR_INFO:
-				if(event->gge_Event.gge_PubDirInfo.ggepdi_FirstName)
-					StrFree(event->gge_Event.gge_PubDirInfo.ggepdi_FirstName);
-				if(event->gge_Event.gge_PubDirInfo.ggepdi_LastName)
-					StrFree(event->gge_Event.gge_PubDirInfo.ggepdi_LastName);
-				if(event->gge_Event.gge_PubDirInfo.ggepdi_NickName)
-					StrFree(event->gge_Event.gge_PubDirInfo.ggepdi_NickName);
-				if(event->gge_Event.gge_PubDirInfo.ggepdi_BirthYear)
-					StrFree(event->gge_Event.gge_PubDirInfo.ggepdi_BirthYear);
-				if(event->gge_Event.gge_PubDirInfo.ggepdi_City)
-					StrFree(event->gge_Event.gge_PubDirInfo.ggepdi_City);
-			break;
+			gg_sess->ggs_Notify = list;
+			gg_sess->ggs_NotifySize = size;
 		}
-		FreeMem(event, sizeof(struct GGEvent));
+
+		/* przesunicie w gr od koca, obszary si nakadaj */
+		for(i = gg_sess->ggs_NotifyNo; i > low; i--)
+			gg_sess->ggs_Notify[i] = gg_sess->ggs_Notify[i - 1];
+
+		gg_sess->ggs_Notify[low].ggne_Uin = uin;
+		gg_sess->ggs_Notify[low].ggne_Type = type;
+		gg_sess->ggs_NotifyNo++;
 	}
 }
 
@@ -495,6 +1356,10 @@ VOID GGFreeEvent(struct GGEvent *event)
  *    Jeli uins bdzie rwne NULL zostanie wysany pakiet odpowiadajcy za pust list kontaktw.
  *    Jeli types bdzie rwne NULL wszystkie kontakty zostan wysane jako GG_USER_NORMAL.
  *
+ *    Biblioteka pamita list znan serwerowi. Przy kolejnych wywoaniach wysyane s tylko
+ *    rnice (pakiety GGP_TYPE_ADD_NOTIFY i GGP_TYPE_REMOVE_NOTIFY), chyba e zajyby wicej
+ *    miejsca ni caa lista - wtedy lista wysyana jest ponownie w caoci.
+ *
  *  INPUTS
  *    - gg_sess -- wskanik na struktur GGSession odpowiadajc za poczenie;
  *    - uins -- wskanik na tablic numerw GG (uin GG) kontaktw z listy;
@@ -507,6 +1372,10 @@ VOID GGFreeEvent(struct GGEvent *event)
  *
  *   NOTES
  *     Tablice, na ktre wskazuj uins i types musz mie dugo dokadnie rwn no!
+ *     Jeli numer powtarza si w tablicy, brany jest pod uwag tylko jeden z wpisw.
+ *
+ *   SEE ALSO
+ *    GGNotifyEntry, GGAddNotify, GGRemoveNotify
  *
  *****/
 
@@ -517,71 +1386,63 @@ BOOL GGNotifyList(struct GGSession *gg_sess, ULONG *uins, UBYTE *types, LONG no)
 
 	if(gg_sess && GG_SESSION_IS_CONNECTED(gg_sess))
 	{
+		struct GGNotifyEntry *list = NULL;
+		LONG i, count = 0;
+
 		if(uins == NULL)
+			no = 0;
+
+		/* druga poowa bloku to tablica pomocnicza sortowania, potem zapas na GGAddNotify() */
+		if(no == 0 || (list = AllocVec(2 * no * sizeof(struct GGNotifyEntry), MEMF_ANY)))
 		{
-			BYTE *pac;
-			ULONG len;
+			LONG packets = -1;
 
-			if((pac = GGPacketCreateTags(GGP_TYPE_LIST_EMPTY, &len, TAG_END)))
+			for(i = 0; i < no; i++)
 			{
-				if(GGAddToWriteBuffer(gg_sess, pac, len))
-				{
-					result = TRUE;
-				}
+				list[i].ggne_Uin = uins[i];
+				list[i].ggne_Type = types ? types[i] : GG_USER_NORMAL;
 			}
-		}
-		else
-		{
-			BYTE *buf;
-			LONG i;
 
-			while(no > 400)
+			if(no > 0)
 			{
-				ULONG buf_len = sizeof(struct GGPHeader) + 400 * sizeof(ULONG) + 400 * sizeof(UBYTE);
+				struct GGNotifyEntry *sorted = GGNotifySort(list, list + no, no);
 
-				if((buf = AllocVec(buf_len, MEMF_CLEAR | MEMF_ANY)))
+				for(i = 0; i < no; i++)
 				{
-					BYTE *temp = buf + sizeof(struct GGPHeader);
-					((struct GGPHeader*)buf)->ggph_Type = EndianFix32(GGP_TYPE_NOTIFY_NORMAL);
-					((struct GGPHeader*)buf)->ggph_Length = EndianFix32(buf_len - sizeof(struct GGPHeader));
-
-					for(i = 0; i < 400; i++)
-					{
-						*((ULONG*)temp) = EndianFix32(uins[i]);
-						temp += sizeof(ULONG);
-						*temp = types ? types[i] : GG_USER_NORMAL;
-						temp++;
-					}
-					if(!GGAddToWriteBuffer(gg_sess, buf, buf_len))
-					{
-						FreeVec(buf);
-						return FALSE;
-					}
+					if(count == 0 || list[count - 1].ggne_Uin != sorted[i].ggne_Uin)
+						list[count++] = sorted[i];
 				}
-				no -= 400;
-				uins += 400;
-				types += 400;
 			}
 
-			ULONG buf_len = sizeof(struct GGPHeader) + no * sizeof(ULONG) + no * sizeof(UBYTE);
+			if(gg_sess->ggs_NotifyNo >= 0)
+				packets = GGNotifyDelta(gg_sess, list, count, FALSE);
 
-			if((buf = AllocVec(buf_len, MEMF_CLEAR | MEMF_ANY)))
+			/* rnice wysyamy tylko, jeli s mniejsze ni caa lista (wraz z nagwkami pakietw) */
+			if(packets >= 0 && packets * (sizeof(struct GGPHeader) + sizeof(struct GGPNotify)) <=
+			 count * sizeof(struct GGPNotify) + ((count + GGP_NOTIFY_LIST_MAX - 1) / GGP_NOTIFY_LIST_MAX) * sizeof(struct GGPHeader))
 			{
-				BYTE *temp = buf + sizeof(struct GGPHeader);
-				((struct GGPHeader*)buf)->ggph_Type = EndianFix32(GGP_TYPE_NOTIFY_LAST);
-				((struct GGPHeader*)buf)->ggph_Length = EndianFix32(buf_len - sizeof(struct GGPHeader));
+				tprintf("notify list: %ld changes\n", packets);
+				result = (BOOL)(GGNotifyDelta(gg_sess, list, count, TRUE) >= 0);
+			}
+			else
+				result = GGNotifySendFull(gg_sess, list, count);
 
-				for(i = 0; i < no; i++)
-				{
-					*((ULONG*)temp) = EndianFix32(uins[i]);
-					temp += sizeof(ULONG);
-					*temp = types ? types[i] : GG_USER_NORMAL;
-					temp++;
-				}
-				if(GGAddToWriteBuffer(gg_sess, buf, buf_len))
-					result = TRUE;
-				else
-					FreeVec(buf);
+			if(result)
+			{
+				if(gg_sess->ggs_Notify)
+					FreeVec(gg_sess->ggs_Notify);
+
+				gg_sess->ggs_Notify = list;
+				gg_sess->ggs_NotifyNo = count;
+				gg_sess->ggs_NotifySize = 2 * no;
+			}
+			else
+			{
+				/* cz pakietw moga trafi do kolejki, serwer dostanie nastpn list w caoci */
+				gg_sess->ggs_NotifyNo = -1;
+
+				if(list)
+					FreeVec(list);
 			}
 		}
 	}
@@ -726,16 +1587,10 @@ BOOL GGPing(struct GGSession *gg_sess)
 
 	if(gg_sess && GG_SESSION_IS_CONNECTED(gg_sess))
 	{
-		BYTE *pac;
-		ULONG len;
+		struct GGPacketBuilder pb;
 
-		if((pac = GGPacketCreateTags(GGP_TYPE_PING, &len, TAG_END)))
-		{
-			if(GGAddToWriteBuffer(gg_sess, pac, len))
-				result = TRUE;
-			else
-				FreeVec(pac);
-		}
+		if(GGPacketBegin(gg_sess, &pb, GGP_TYPE_PING, GGP_SIZE_PING))
+			result = GGPacketCommit(&pb);
 	}
 
 	LEAVE();
@@ -771,18 +1626,14 @@ BOOL GGTypingNotify(struct GGSession *gg_sess, ULONG uin, USHORT len)
 
 	if(gg_sess && GG_SESSION_IS_CONNECTED(gg_sess))
 	{
-		BYTE *pac;
-		ULONG plen;
+		struct GGPacketBuilder pb;
+		struct GGPTypingNotify *tn;
 
-		if((pac = GGPacketCreateTags(GGP_TYPE_TYPING_NOTIFY, &plen,
-			GGA_CreatePacket_USHORT, len,
-			GGA_CreatePacket_ULONG, uin,
-		TAG_END)))
+		if((tn = GGPacketBeginFixed(gg_sess, &pb, GGP_TYPE_TYPING_NOTIFY, GGPTypingNotify)))
 		{
-			if((GGAddToWriteBuffer(gg_sess, pac, plen)))
-				result = TRUE;
-			else
-				FreeVec(pac);
+			tn->ggptn_Type = EndianFix16(len);
+			tn->ggptn_Uin = EndianFix32(uin);
+			result = GGPacketCommit(&pb);
 		}
 	}
 
@@ -820,34 +1671,27 @@ BOOL GGSendMessage(struct GGSession *gg_sess, ULONG uin, STRPTR msg, STRPTR imag
 
 	if(gg_sess && GG_SESSION_IS_CONNECTED(gg_sess) && (msg || image))
 	{
-		STRPTR html_msg;
-		BYTE *pac;
+		struct GGPacketBuilder pb;
 		struct DateStamp ds;
 		ULONG seq;
-		ULONG len;
 
-		if((html_msg = GGMessageTextToHTML(msg, image)))
-		{
-			DateStamp(&ds);
+		DateStamp(&ds);
 
-			seq = ds.ds_Days * (24 * 60 * 60);
-			seq += (ds.ds_Minute * 60);
-			seq += (ds.ds_Tick / TICKS_PER_SECOND);
-			seq += 2 * 366 * 24 * 3600 + 6 * 365 * 24 * 3600;
+		seq = ds.ds_Days * (24 * 60 * 60);
+		seq += (ds.ds_Minute * 60);
+		seq += (ds.ds_Tick / TICKS_PER_SECOND);
+		seq += 2 * 366 * 24 * 3600 + 6 * 365 * 24 * 3600;
 
-			if((pac = GGPacketCreateTags(GGP_TYPE_SEND_MSG, &len,
-				GGA_CreatePacket_ULONG, uin,
-				GGA_CreatePacket_ULONG, seq,
-				GGA_CreatePacket_ULONG, 0x00000008UL,
-				GGA_CreatePacket_ULONG, 0,
-				GGA_CreatePacket_ULONG, 0,
-				GGA_CreatePacket_STRPTR, (ULONG)html_msg,
-			TAG_END)))
-			{
-				if(GGAddToWriteBuffer(gg_sess, pac, len))
-					result = TRUE;
-			}
-			FreeVec(html_msg);
+		/* wiadomo w HTML-u zapisywana jest od razu w pakiecie, rezerwujemy dokadnie jej dugo */
+		if(GGPacketBegin(gg_sess, &pb, GGP_TYPE_SEND_MSG, 5 * sizeof(ULONG) + GGMessageHTMLLength(msg, image)))
+		{
+			GGPacketPutULONG(&pb, uin);
+			GGPacketPutULONG(&pb, seq);
+			GGPacketPutULONG(&pb, 0x00000008UL);
+			GGPacketPutULONG(&pb, 0);
+			GGPacketPutULONG(&pb, 0);
+			GGPacketPutHTML(&pb, msg, image);
+			result = GGPacketCommit(&pb);
 		}
 	}
 
@@ -887,19 +1731,8 @@ BOOL GGAddNotify(struct GGSession *gg_sess, ULONG uin, UBYTE type)
 
 	if(gg_sess && GG_SESSION_IS_CONNECTED(gg_sess))
 	{
-		BYTE *pac;
-		ULONG plen;
-
-		if((pac = GGPacketCreateTags(GGP_TYPE_ADD_NOTIFY, &plen,
-			GGA_CreatePacket_ULONG, uin,
-			GGA_CreatePacket_UBYTE, type,
-		TAG_END)))
-		{
-			if((GGAddToWriteBuffer(gg_sess, pac, plen)))
-				result = TRUE;
-			else
-				FreeVec(pac);
-		}
+		if((result = GGNotifySend(gg_sess, GGP_TYPE_ADD_NOTIFY, uin, type)))
+			GGNotifyUpdate(gg_sess, uin, type, TRUE);
 	}
 
 	LEAVE();
@@ -939,19 +1772,12 @@ BOOL GGRemoveNotify(struct GGSession *gg_sess, ULONG uin, UBYTE type)
 
 	if(gg_sess && GG_SESSION_IS_CONNECTED(gg_sess))
 	{
-		BYTE *pac;
-		ULONG plen;
+		if((result = GGNotifySend(gg_sess, GGP_TYPE_REMOVE_NOTIFY, uin, type)))
+			GGNotifyUpdate(gg_sess, uin, type, FALSE);
 
-		if((pac = GGPacketCreateTags(GGP_TYPE_REMOVE_NOTIFY, &plen,
-			GGA_CreatePacket_ULONG, uin,
-			GGA_CreatePacket_UBYTE, type,
-		TAG_END)))
-		{
-			if((GGAddToWriteBuffer(gg_sess, pac, plen)))
-				result = TRUE;
-			else
-				FreeVec(pac);
-		}
+		/* po ponownym dodaniu kontaktu jego status ma zosta zgoszony */
+		if(result && gg_sess->ggs_Roster)
+			GGRosterRemove(gg_sess, uin);
 	}
 
 	LEAVE();
@@ -990,20 +1816,16 @@ BOOL GGRequestContactList(struct GGSession *gg_sess, UBYTE format)
 
 	if(gg_sess && GG_SESSION_IS_CONNECTED(gg_sess))
 	{
-		BYTE *pac;
-		ULONG plen;
+		struct GGPacketBuilder pb;
+		struct GGPUserListRequest *req;
 
-		if((pac = GGPacketCreateTags(GGP_TYPE_USER_LIST_REQ, &plen,
-			GGA_CreatePacket_BYTE,  0x02,    /* typ zapytania, dla importu 0x02 */
-			GGA_CreatePacket_ULONG, 0x00,    /* wersja listy (dla importu oryginalny klient wysya 0 */
-			GGA_CreatePacket_BYTE,  format,  /* typ formatu listy kontaktw */
-			GGA_CreatePacket_BYTE,  0x01,    /* pole o nieznanym przeznaczeniu, zawsze rwne 0x01 */
-		TAG_END)))
+		if((req = GGPacketBeginFixed(gg_sess, &pb, GGP_TYPE_USER_LIST_REQ, GGPUserListRequest)))
 		{
-			if((GGAddToWriteBuffer(gg_sess, pac, plen)))
-				result = TRUE;
-			else
-				FreeVec(pac);
+			req->ggpulr_Type = 0x02;      /* typ zapytania, dla importu 0x02 */
+			req->ggpulr_Version = 0x00;   /* wersja listy (dla importu oryginalny klient wysya 0 */
+			req->ggpulr_Format = format;  /* typ formatu listy kontaktw */
+			req->ggpulr_Unknown = 0x01;   /* pole o nieznanym przeznaczeniu, zawsze rwne 0x01 */
+			result = GGPacketCommit(&pb);
 		}
 	}
 
@@ -1105,17 +1927,13 @@ BOOL GGDisconnectMultilogon(struct GGSession *gg_sess, UQUAD id)
 
 	if(gg_sess && GG_SESSION_IS_CONNECTED(gg_sess))
 	{
-		BYTE *pac;
-		ULONG plen;
+		struct GGPacketBuilder pb;
+		struct GGPMultilogonDisconnect *md;
 
-		if((pac = GGPacketCreateTags(GGP_TYPE_MULTILOGON_DISCONNECT, &plen,
-			GGA_CreatePacket_UQUAD, (IPTR)&id,
-		TAG_END)))
+		if((md = GGPacketBeginFixed(gg_sess, &pb, GGP_TYPE_MULTILOGON_DISCONNECT, GGPMultilogonDisconnect)))
 		{
-			if((GGAddToWriteBuffer(gg_sess, pac, plen)))
-				result = TRUE;
-			else
-				FreeVec(pac);
+			md->ggpmd_Id = EndianFix64(id);
+			result = GGPacketCommit(&pb);
 		}
 	}
 
@@ -1192,7 +2010,11 @@ BOOL GGRequestImage(struct GGSession *gg_sess, ULONG uin, STRPTR id)
  *    BOOL GGSendImageData(struct GGSession *gg_sess, ULONG uin, BPTR fh)
  *
  *  FUNCTION
- *    Funkcja suy do wysania danych obrazka w odpowiedzi na danie obrazka.
+ *    Funkcja suy do wysania danych obrazka w odpowiedzi na danie obrazka. Obrazek
+ *    nie jest wysyany od razu - funkcja tylko docza go do listy wysyanych obrazkw
+ *    sesji, a kolejne porcje danych czytane s z pliku i dopisywane do kolejki wysyania
+ *    w miar jak si ona oprnia (GGImageUploadPump()). Postp i zakoczenie wysyania
+ *    zgaszane s zdarzeniami GGE_TYPE_IMAGE_UPLOAD.
  *
  *  INPUTS
  *    - gg_sess -- wskanik na struktur GGSession odpowiadajc za poczenie;
@@ -1200,11 +2022,13 @@ BOOL GGRequestImage(struct GGSession *gg_sess, ULONG uin, STRPTR id)
  *    - fh -- uchwyt do pliku zawierajcego obrazek.
  *
  *   RESULT
- *    - TRUE -- jeli si udao;
- *    - FALSE -- w.p.p.
+ *    - TRUE -- jeli si udao, uchwyt pliku przechodzi na wasno biblioteki i zostanie
+ *      zamknity po wysaniu obrazka (lub zwolnieniu sesji);
+ *    - FALSE -- w.p.p., uchwyt pliku naley zamkn samemu.
  *
  *   SEE ALSO
- *    GGE_TYPE_IMAGE_DATA, GGEventImageData, GGE_TYPE_IMAGE_REQUEST, GGEventImageRequest, GGSendImageData()
+ *    GGE_TYPE_IMAGE_DATA, GGEventImageData, GGE_TYPE_IMAGE_REQUEST, GGEventImageRequest,
+ *    GGE_TYPE_IMAGE_UPLOAD, GGEventImageUpload
  *
  *****/
 
@@ -1215,115 +2039,34 @@ BOOL GGSendImageData(struct GGSession *gg_sess, ULONG uin, BPTR fh)
 
 	if(gg_sess && GG_SESSION_IS_CONNECTED(gg_sess) && fh != (BPTR)0)
 	{
-		BYTE *pac;
-		ULONG plen;
-		ULONG crc, size, old_pos;
-		UBYTE file_name[17];
+		struct GGImageUpload *up;
 
-		crc = FileCrc32(fh);
-
-		old_pos = Seek(fh, 0, OFFSET_END);
-		size = Seek(fh, old_pos, OFFSET_BEGINING);
-
-		FmtNPut(file_name, "%08lx%08lx", sizeof(file_name), crc, size);
-
-		if(size <= 1873)
-		{
-			UBYTE *pic;
-
-			if((pic = AllocMem(size, MEMF_ANY)))
-			{
-				if(FRead(fh, pic, size, 1) == 1)
-				{
-					struct TagItem pic_data = {size, (IPTR)pic};
-
-					if((pac = GGPacketCreateTags(GGP_TYPE_SEND_MSG_OLD, &plen,
-						GGA_CreatePacket_ULONG,  uin,             /* numer nadawcy obrazka */
-						GGA_CreatePacket_ULONG,  0UL,             /* numer sekwencyjny, tutaj moe by 0 */
-						GGA_CreatePacket_ULONG,  0x0000004UL,     /* klasa wiadomoci - obrazek (4) */
-						GGA_CreatePacket_UBYTE,  0x00,            /* pusta tre wiadomoci */
-						GGA_CreatePacket_UBYTE,  0x05,            /* flaga -> pierwszy pakiet danych: 0x05 */
-						GGA_CreatePacket_ULONG,  size,            /* rozmiar obrazka */
-						GGA_CreatePacket_ULONG,  crc,             /* suma CRC32 obrazka */
-						GGA_CreatePacket_STRPTR, (IPTR)file_name, /* nazwa pliku */
-						GGA_CreatePacket_UBYTE,  0x00,            /* bajt koczcy nazw pliku */
-						GGA_CreatePacket_BLOCK,  (IPTR)&pic_data, /* dane obrazka */
-					TAG_END)))
-					{
-						if((GGAddToWriteBuffer(gg_sess, pac, plen)))
-							result = TRUE;
-						else
-							FreeVec(pac);
-					}
-				}
-				FreeMem(pic, size);
-			}
-		}
-		else
+		if((up = AllocMem(sizeof(struct GGImageUpload), MEMF_ANY)))
 		{
-			UBYTE *pic;
-
-			if((pic = AllocMem(1843, MEMF_ANY)))
-			{
-				struct TagItem pic_data;
+			up->ggiu_Next = NULL;
+			up->ggiu_Uin = uin;
+			up->ggiu_File = fh;
+			up->ggiu_Crc32 = FileCrc32(fh);
+			up->ggiu_Sent = 0;
+			up->ggiu_Seq = 0;
+			up->ggiu_Reported = 0;
 
-				pic_data.ti_Tag = 1843;
-				pic_data.ti_Data = (IPTR)pic;
+			Seek(fh, 0, OFFSET_END);
+			up->ggiu_Size = Seek(fh, 0, OFFSET_BEGINING);
 
-				if(FRead(fh, pic, 1843, 1) == 1)
-				{
-					if((pac = GGPacketCreateTags(GGP_TYPE_SEND_MSG_OLD, &plen,
-						GGA_CreatePacket_ULONG,  uin,             /* numer nadawcy obrazka */
-						GGA_CreatePacket_ULONG,  0UL,             /* numer sekwencyjny, teraz zero, pniej kolejne liczby */
-						GGA_CreatePacket_ULONG,  0x0000004UL,     /* klasa wiadomoci - obrazek (4) */
-						GGA_CreatePacket_UBYTE,  0x00,            /* pusta tre wiadomoci */
-						GGA_CreatePacket_UBYTE,  0x05,            /* flaga -> pierwszy pakiet danych: 0x05 */
-						GGA_CreatePacket_ULONG,  size,            /* rozmiar obrazka */
-						GGA_CreatePacket_ULONG,  crc,             /* suma CRC32 obrazka */
-						GGA_CreatePacket_STRPTR, (IPTR)file_name, /* nazwa pliku */
-						GGA_CreatePacket_UBYTE,  0x00,            /* bajt koczcy nazw pliku */
-						GGA_CreatePacket_BLOCK,  (IPTR)&pic_data, /* dane obrazka */
-					TAG_END)))
-					{
-						if((GGAddToWriteBuffer(gg_sess, pac, plen)))
-						{
-							ULONG bytes;
-							ULONG seq = 1;
-
-							GGWriteData(gg_sess);
+			FmtNPut(up->ggiu_FileName, "%08lx%08lx", sizeof(up->ggiu_FileName), up->ggiu_Crc32, up->ggiu_Size);
 
-							while((bytes = FRead(fh, pic, 1, 1843)))
-							{
-								pic_data.ti_Tag = bytes;
-								pic_data.ti_Data = (IPTR)pic;
-
-								if((pac = GGPacketCreateTags(GGP_TYPE_SEND_MSG_OLD, &plen,
-									GGA_CreatePacket_ULONG,  uin,             /* numer nadawcy obrazka */
-									GGA_CreatePacket_ULONG,  seq++,           /* numer sekwencyjny, kolejne liczby */
-									GGA_CreatePacket_ULONG,  0x0000004UL,     /* klasa wiadomoci - obrazek (4) */
-									GGA_CreatePacket_UBYTE,  0x00,            /* pusta tre wiadomoci */
-									GGA_CreatePacket_UBYTE,  0x06,            /* flaga -> kolejne pakiety danych: 0x06 */
-									GGA_CreatePacket_ULONG,  size,            /* rozmiar obrazka */
-									GGA_CreatePacket_ULONG,  crc,             /* suma CRC32 obrazka */
-									GGA_CreatePacket_BLOCK,  (IPTR)&pic_data, /* dane obrazka */
-								TAG_END)))
-								{
-									if(!GGAddToWriteBuffer(gg_sess, pac, plen))
-										break;
-
-									GGWriteData(gg_sess);
-								}
-							}
+			if(up->ggiu_Size > 0 && up->ggiu_Size != (ULONG)-1)
+			{
+				*gg_sess->ggs_UploadTail = up;
+				gg_sess->ggs_UploadTail = &up->ggiu_Next;
 
-							if(Seek(fh, 0, OFFSET_END) == size)
-								result = TRUE;
-						}
-						else
-							FreeVec(pac);
-					}
-				}
-				FreeMem(pic, 1843);
+				/* pierwsz porcj dopisze GGHandleConnected(), gdy socket bdzie gotowy do zapisu */
+				gg_sess->ggs_Check |= GGS_CHECK_WRITE;
+				result = TRUE;
 			}
+			else
+				FreeMem(up, sizeof(struct GGImageUpload));
 		}
 	}
 
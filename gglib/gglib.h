@@ -38,6 +38,9 @@
 #define GGA_CreateSession_Status          (TAG_USER + 1)
 #define GGA_CreateSession_Status_Desc     (TAG_USER + 2)
 #define GGA_CreateSession_Image_Size      (TAG_USER + 3)
+#define GGA_CreateSession_ZeroCopy        (TAG_USER + 4)
+#define GGA_CreateSession_EventMask       (TAG_USER + 5)
+#define GGA_CreateSession_Roster          (TAG_USER + 6)
 
 /****d* gglib.h/GGS_ERRNO_#?
  *
@@ -112,6 +115,13 @@
 #define GGS_CHECK_NONE           (0)      /* biblioteka nic nie chce */
 #define GGS_CHECK_READ           (1<<0)   /* biblioteka chce czyta */
 #define GGS_CHECK_WRITE          (1<<1)   /* biblioteka chce zapisywa */
+#define GGS_CHECK_PENDING        (1<<2)   /* biblioteka ma ju odebrane dane, naley od razu wywoa GGWatchEvent() */
+
+/* maksymalna ilo struktur GGEvent przechowywanych przez sesj do ponownego uycia */
+#define GGS_EVENT_POOL_MAX       (16)
+
+/* flagi dla GGSetPacketHandler() */
+#define GG_PACKET_IGNORE         (1<<0)   /* pakiet jest porzucany bez generowania zdarzenia */
 
 /****f* gglib.h/GG_SESSION_CHECK_READ()
  *
@@ -155,6 +165,121 @@
 
 /*******GG_SESSION_CHECK_WRITE()*******/
 
+/****f* gglib.h/GG_SESSION_CHECK_PENDING()
+ *
+ *  NAME
+ *    GG_SESSION_CHECK_PENDING()
+ *
+ *  SYNOPSIS
+ *    GG_SESSION_CHECK_PENDING(struct GGSession *gg_sess)
+ *
+ *  FUNCTION
+ *    Makro sprawdza czy biblioteka ma ju odebrane, nieprzetworzone dane. W takim
+ *    przypadku socket moe nie sta si gotowy do odczytu, wic GGWatchEvent() naley
+ *    wywoa bez czekania w WaitSelect().
+ *
+ *  INPUTS
+ *    gg_sess - wskanik na struktur sesji do sprawdzenia.
+ *
+ *  SOURCE
+ */
+
+#define GG_SESSION_CHECK_PENDING(gg_sess) ((gg_sess)->ggs_Check & GGS_CHECK_PENDING)
+
+/*******GG_SESSION_CHECK_PENDING()*******/
+
+/****id* gglib.h/GGS_LANE_#?
+ *
+ *  NAME
+ *    GGS_LANE_#?
+ *
+ *  FUNCTION
+ *    Klasy priorytetu kolejki wysyania sesji. Pakiety wysyane s z najwyszej niepustej
+ *    klasy, przy czym po GGS_LANE_BULK_SKIP_MAX segmentach wyszych klas wysyany jest jeden
+ *    segment klasy GGS_LANE_BULK, jeli na niego czeka. Klas pakietu wybiera GGPacketLane()
+ *    na podstawie jego typu.
+ *
+ *    - GGS_LANE_CONTROL -- logowanie, ping, potwierdzenia wiadomoci, zmiany statusu;
+ *    - GGS_LANE_CHAT -- wiadomoci, powiadomienia o pisaniu i pozostae pakiety;
+ *    - GGS_LANE_BULK -- dane obrazkw, lista kontaktw i jej zmiany, import i eksport listy.
+ *
+ *  SOURCE
+ */
+
+#define GGS_LANE_CONTROL         (0)
+#define GGS_LANE_CHAT            (1)
+#define GGS_LANE_BULK            (2)
+#define GGS_LANE_COUNT           (3)
+
+#define GGS_LANE_BULK_SKIP_MAX   (4)
+
+/* maksymalny czas wstrzymania wysyania przez GGCork() w tickach (1/TICKS_PER_SECOND s) */
+#define GGS_CORK_DEADLINE        (1)
+
+/* potwierdzenia wiadomoci zbierane przez GGAcceptMessage(): ilo i maksymalny czas (w tickach) oczekiwania */
+#define GGS_ACK_BATCH_MAX        (64)
+#define GGS_ACK_DEADLINE         (5)
+
+/* o ile wpisw powikszana jest zapamitana lista kontaktw (ggs_Notify) przy GGAddNotify() */
+#define GGS_NOTIFY_GROW          (64)
+
+/*********GGS_LANE_#?*****************/
+
+/****is* gglib.h/GGWriteLane
+ *
+ *  NAME
+ *    GGWriteLane
+ *
+ *  FUNCTION
+ *    Kolejka danych wysyanych jednej klasy priorytetu (GGS_LANE_#?).
+ *
+ *  ATTRIBUTES
+ *    - ggwl_Head -- pierwszy segment kolejki (GGWriteSegment) lub NULL;
+ *    - ggwl_Tail -- ostatni segment kolejki lub NULL;
+ *    - ggwl_Len -- ilo danych w kolejce, ktre nie zostay jeszcze wysane.
+ *
+ *  SEE ALSO
+ *    GGSession, GGWriteData()
+ *
+ *  SOURCE
+ */
+
+struct GGWriteLane
+{
+	struct GGWriteSegment *ggwl_Head;
+	struct GGWriteSegment *ggwl_Tail;
+	LONG ggwl_Len;
+};
+
+/********GGWriteLane****/
+
+/****is* gglib.h/GGNotifyEntry
+ *
+ *  NAME
+ *    GGNotifyEntry
+ *
+ *  FUNCTION
+ *    Wpis listy kontaktw ostatnio wysanej do serwera (ggs_Notify). Lista jest posortowana
+ *    rosnco wedug numeru, bez powtrze, co pozwala GGNotifyList() wysya tylko zmiany.
+ *
+ *  ATTRIBUTES
+ *    - ggne_Uin -- numer kontaktu;
+ *    - ggne_Type -- typ kontaktu (GG_USER_#?).
+ *
+ *  SEE ALSO
+ *    GGSession, GGNotifyList()
+ *
+ *  SOURCE
+ */
+
+struct GGNotifyEntry
+{
+	ULONG ggne_Uin;
+	UBYTE ggne_Type;
+};
+
+/********GGNotifyEntry****/
+
 /****s* gglib.h/GGSession
  *
  *  NAME
@@ -173,17 +298,45 @@
  *    - ggs_Errno -- kod bdu;
  *    - ggs_SessionState -- status poczenia;
  *    - ggs_Socket -- socket poczenia;
- *    - ggs_RecvBuffer -- bufor na dane wysyane;
- *    - ggs_RecvLen -- ilo ju odebranych danych;
- *    - ggs_WriteBuffer -- bufor na dane wysyane;
- *    - ggs_WriteLen -- aktualna dugo bufora wysyanych danych;
- *    - ggs_WrittenLen -- ilo danych z bufora wysyania, ktra zostaa ju wysana;
+ *    - ggs_RecvBlock -- blok pamici bufora odbiorczego (z licznikiem odwoa);
+ *    - ggs_RecvBuffer -- bufor na dane odbierane (dane ggs_RecvBlock), moe zawiera kilka pakietw naraz;
+ *    - ggs_RecvLen -- ilo ju odebranych danych w buforze;
+ *    - ggs_RecvSize -- rozmiar zaalokowanego bufora odbiorczego;
+ *    - ggs_RecvPos -- pozycja w buforze, od ktrej zaczyna si nastpny nieprzetworzony pakiet;
+ *    - ggs_RecvSaved -- bajt bufora nadpisany zerem koczcym ostatnio zwrcony pakiet;
+ *    - ggs_WriteLanes -- kolejki danych wysyanych, po jednej na klas priorytetu (GGS_LANE_#?);
+ *    - ggs_WriteLen -- ilo danych we wszystkich kolejkach, ktre nie zostay jeszcze wysane;
+ *    - ggs_WriteBusy -- kolejka, ktrej pierwszy segment zosta wysany tylko czciowo
+ *      i musi zosta dokoczony przed innymi, lub NULL;
+ *    - ggs_WriteSkipped -- ilo segmentw wyszych klas wysanych od ostatniego segmentu
+ *      klasy GGS_LANE_BULK, gdy ta na nie czekaa;
+ *    - ggs_Cork -- ilo niezakoczonych wywoa GGCork(), dopki jest rna od zera dane
+ *      s tylko zbierane w kolejkach (GGWriteCorked());
+ *    - ggs_CorkTime -- czas pierwszego wywoania GGCork() (w tickach, GGS_CORK_DEADLINE);
+ *    - ggs_AckSeq -- numery sekwencyjne wiadomoci czekajcych na potwierdzenie (GGAckFlush());
+ *    - ggs_AckCount -- ilo numerw w ggs_AckSeq;
+ *    - ggs_AckTime -- czas odebrania najstarszej niepotwierdzonej wiadomoci (w tickach);
  *    - ggs_Check -- pole bitowe informujce czy biblioteka chce
  *      czyta czy pisa do socketu;
+ *    - ggs_ZeroCopy -- opisy statusw w zdarzeniach pokazuj na bufor odbiorczy zamiast by kopiowane;
+ *    - ggs_EventPool -- lista struktur GGEvent gotowych do ponownego uycia;
+ *    - ggs_EventPoolSize -- ilo struktur w ggs_EventPool (co najwyej GGS_EVENT_POOL_MAX);
+ *    - ggs_Dispatch -- tablica handlerw pakietw sesji lub NULL jeli uywana jest domylna;
+ *    - ggs_EventMask -- maska zdarze, ktre maj by generowane (GGE_MASK());
+ *    - ggs_Descriptions -- pula opisw statusw wspdzielonych przez zdarzenia sesji;
+ *    - ggs_Roster -- tablica haszujca (GGS_ROSTER_SIZE list) ostatnio znanych statusw
+ *      kontaktw lub NULL jeli sesja ich nie przechowuje (GGA_CreateSession_Roster);
+ *    - ggs_UploadHead -- lista obrazkw wysyanych przez GGSendImageData() (GGImageUpload);
+ *    - ggs_UploadTail -- wskanik na pole ggiu_Next ostatniego obrazka listy (lub na ggs_UploadHead);
+ *    - ggs_UploadDone -- lista zakoczonych wysyek obrazkw, jeszcze nie zgoszonych zdarzeniem;
+ *    - ggs_Notify -- posortowana lista kontaktw, ktr zna serwer (GGNotifyEntry);
+ *    - ggs_NotifyNo -- ilo wpisw w ggs_Notify lub -1, jeli serwer nie dosta jeszcze listy;
+ *    - ggs_NotifySize -- ilo wpisw, na ktre zaalokowano ggs_Notify;
  *    - SocketBase -- wskanik na baz bsdsocket.library.
  *
  *  SEE ALSO
- *    GGS_ERRNO_#?, GGS_STATE_#?, GG_SESSION_CHECK_WRITE(), GG_SESSION_CHECK_READ()
+ *    GGS_ERRNO_#?, GGS_STATE_#?, GG_SESSION_CHECK_WRITE(), GG_SESSION_CHECK_READ(),
+ *    GG_SESSION_CHECK_PENDING()
  *
  *  SOURCE
  */
@@ -201,12 +354,35 @@ struct GGSession
 	ULONG ggs_Errno;
 	LONG ggs_SessionState;
 	LONG ggs_Socket;
+	struct GGRecvBlock *ggs_RecvBlock;
 	BYTE *ggs_RecvBuffer;
 	LONG ggs_RecvLen;
-	BYTE *ggs_WriteBuffer;
+	LONG ggs_RecvSize;
+	LONG ggs_RecvPos;
+	BYTE ggs_RecvSaved;
+	struct GGWriteLane ggs_WriteLanes[GGS_LANE_COUNT];
 	LONG ggs_WriteLen;
-	LONG ggs_WrittenLen;
+	struct GGWriteLane *ggs_WriteBusy;
+	ULONG ggs_WriteSkipped;
+	ULONG ggs_Cork;
+	ULONG ggs_CorkTime;
+	ULONG ggs_AckSeq[GGS_ACK_BATCH_MAX];
+	ULONG ggs_AckCount;
+	ULONG ggs_AckTime;
 	LONG ggs_Check;
+	BOOL ggs_ZeroCopy;
+	struct GGEvent *ggs_EventPool;
+	ULONG ggs_EventPoolSize;
+	struct GGPacketDispatch *ggs_Dispatch;
+	ULONG ggs_EventMask;
+	struct InternPool *ggs_Descriptions;
+	struct GGPresence **ggs_Roster;
+	struct GGImageUpload *ggs_UploadHead;
+	struct GGImageUpload **ggs_UploadTail;
+	struct GGImageUpload *ggs_UploadDone;
+	struct GGNotifyEntry *ggs_Notify;
+	LONG ggs_NotifyNo;
+	LONG ggs_NotifySize;
 	struct Library* SocketBase;
 
 	SSL *ggs_SSL;
@@ -376,7 +552,8 @@ struct GGMultilogonInfo
  *    - GGE_TYPE_USER_DATA -- otrzymano dodatkowe dane dotyczce kontaktw;
  *    - GGE_TYPE_LIST_IMPORT -- otrzymano list kontaktw od serwera;
  *    - GGE_TYPE_LIST_EXPORT -- wysanie listy kontaktw do serwera;
- *    - GGE_TYPE_MULTILOGON_INFO -- otrzymano informacje o rwnolegle zalogowanych klientach.
+ *    - GGE_TYPE_MULTILOGON_INFO -- otrzymano informacje o rwnolegle zalogowanych klientach;
+ *    - GGE_TYPE_IMAGE_UPLOAD -- postp lub zakoczenie wysyania obrazka (GGSendImageData()).
  *
  *  SOURCE
  */
@@ -398,9 +575,31 @@ struct GGMultilogonInfo
 #define GGE_TYPE_IMAGE_DATA      (13)
 #define GGE_TYPE_IMAGE_REQUEST   (14)
 #define GGE_TYPE_PUBDIR_INFO     (15)
+#define GGE_TYPE_IMAGE_UPLOAD    (16)
 
 /*********GGE_TYPE_#?*****************/
 
+/****id* gglib.h/GGE_MASK()
+ *
+ *  NAME
+ *    GGE_MASK()
+ *
+ *  FUNCTION
+ *    Maska subskrypcji zdarze (GGA_CreateSession_EventMask, GGSetEventMask()). Pakiety,
+ *    ktrych zdarzenia nie ma w masce, s odbierane i porzucane bez dekodowania.
+ *    GGE_MASK_ALL (domylnie) oznacza wszystkie zdarzenia.
+ *
+ *  SEE ALSO
+ *    GGE_TYPE_#?
+ *
+ *  SOURCE
+ */
+
+#define GGE_MASK(type)           (1UL << (type))
+#define GGE_MASK_ALL             (0xFFFFFFFFUL)
+
+/*********GGE_MASK()*****************/
+
 /****s* gglib.h/GGEventStatusChange
  *
  *  NAME
@@ -414,7 +613,8 @@ struct GGMultilogonInfo
  *    - ggesc_Uin -- numer GG uytkownika zmieniajcego status;
  *    - ggesc_Status -- nowy status;
  *    - ggesc_ImageSize -- maksymalny rozmiar odbieranych przez uytkownika obrazkw;
- *    - ggesc_Description -- opis statusu (NULL jeli brak).
+ *    - ggesc_Description -- opis statusu (NULL jeli brak). Poza trybem GGA_CreateSession_ZeroCopy
+ *      opisy pochodz ze wsplnej puli sesji, wic rwne opisy maj rwne wskaniki.
  *
  *  SOURCE
  */
@@ -435,11 +635,16 @@ struct GGEventStatusChange
  *    GGEventListStatus
  *
  *  FUNCTION
- *    Struktura opisuje zdarzenie odebrania statusw kontaktw z listy.
+ *    Struktura opisuje zdarzenie odebrania statusw kontaktw z listy. Zmiany statusu
+ *    zapisane s w rwnolegych tablicach (i-ty element kadej z nich opisuje i-ty kontakt),
+ *    ktre le w jednym bloku pamici.
  *
  *  ATTRIBUTES
- *    - ggels_ChangesNo -- dugo tablicy ggels_StatusChanges;
- *    - ggels_StatusChanges - tablica struktur opisujcych zmiany statusu.
+ *    - ggels_ChangesNo -- dugo tablic;
+ *    - ggels_Uins -- numery GG uytkownikw zmieniajcych status;
+ *    - ggels_Statuses -- nowe statusy;
+ *    - ggels_ImageSizes -- maksymalne rozmiary odbieranych przez uytkownikw obrazkw;
+ *    - ggels_Descriptions -- opisy statusw (NULL jeli brak), wspdzielone tak jak ggesc_Description.
  *
  *  SEE ALSO
  *    GGEventStatusChange, GGPacketHandlerListStatus()
@@ -450,11 +655,51 @@ struct GGEventStatusChange
 struct GGEventListStatus
 {
 	LONG ggels_ChangesNo;
-	struct GGEventStatusChange *ggels_StatusChanges;
+	ULONG *ggels_Uins;
+	ULONG *ggels_Statuses;
+	UBYTE *ggels_ImageSizes;
+	STRPTR *ggels_Descriptions;
 };
 
 /********GGEventListStatus****/
 
+/****s* gglib.h/GGPresence
+ *
+ *  NAME
+ *    GGPresence
+ *
+ *  FUNCTION
+ *    Struktura opisuje ostatnio znany status kontaktu, przechowywany przez sesj utworzon
+ *    z tagiem GGA_CreateSession_Roster. Wpisy le w tablicy haszujcej ggs_Roster,
+ *    indeksowanej przez GGS_ROSTER_HASH() numeru GG.
+ *
+ *  ATTRIBUTES
+ *    - ggpe_Next -- nastpny wpis z tej samej listy tablicy;
+ *    - ggpe_Uin -- numer GG kontaktu;
+ *    - ggpe_Status -- status kontaktu;
+ *    - ggpe_ImageSize -- maksymalny rozmiar odbieranych przez kontakt obrazkw;
+ *    - ggpe_Description -- opis statusu z puli ggs_Descriptions (NULL jeli brak).
+ *
+ *  SEE ALSO
+ *    GGGetPresence(), GGA_CreateSession_Roster
+ *
+ *  SOURCE
+ */
+
+#define GGS_ROSTER_SIZE       (1024)
+#define GGS_ROSTER_HASH(uin)  ((uin) & (GGS_ROSTER_SIZE - 1))
+
+struct GGPresence
+{
+	struct GGPresence *ggpe_Next;
+	ULONG ggpe_Uin;
+	ULONG ggpe_Status;
+	UBYTE ggpe_ImageSize;
+	STRPTR ggpe_Description;
+};
+
+/********GGPresence****/
+
 /****s* gglib.h/GGEventError
  *
  *  NAME
@@ -519,12 +764,16 @@ struct GGEventTypingNotify
  *    - ggerm_Flags -- flagi wiadomoci:
  *     - GG_MSG_NORMAL -- zwyka wiadomo;
  *     - GG_MSG_OWN -- wiadomo wysana z innego, rwnoczenie zalogowanego klienta
- *    - ggerm_Txt -- tre wiadomoci (czysty tekst, kodowanie UTF-8,
- *     moe by NULL w przypadku samego obrazka);
- *    - ggerm_ImageId -- identyfikator obrazka (jeli wystpi w wiadomoci).
+ *    - ggerm_Html -- tre wiadomoci w formacie HTML (kodowanie UTF-8, zakoczona 0x00),
+ *     pokazuje bezporednio na odebrany pakiet i jest wana do zwolnienia zdarzenia;
+ *    - ggerm_HtmlLength -- dugo ggerm_Html (bez 0x00);
+ *    - ggerm_Attrs -- blok atrybutw wiadomoci wewntrz pakietu lub NULL jeli go nie ma;
+ *    - ggerm_AttrsLength -- dugo bloku atrybutw;
+ *    - ggerm_Txt, ggerm_ImagesIds, ggerm_Converted -- wynik konwersji HTML-a, wypeniany
+ *     przy pierwszym wywoaniu GGGetMessageText() lub GGGetMessageImages() (prywatne).
  *
  *  SEE ALSO
- *    GGPacketHandlerRecvMsg()
+ *    GGPacketHandlerRecvMsg(), GGGetMessageText(), GGGetMessageImages()
  *
  *  SOURCE
  */
@@ -537,8 +786,13 @@ struct GGEventRecvMsg
 	ULONG ggerm_Uin;
 	ULONG ggerm_Time;
 	ULONG ggerm_Flags;
+	STRPTR ggerm_Html;
+	ULONG ggerm_HtmlLength;
+	UBYTE *ggerm_Attrs;
+	ULONG ggerm_AttrsLength;
 	STRPTR ggerm_Txt;
 	STRPTR ggerm_ImagesIds;
+	BOOL ggerm_Converted;
 };
 
 /********GGEventRecvMsg****/
@@ -720,6 +974,46 @@ struct GGEventImageRequest
 
 /********GGEventImageRequest****/
 
+/****s* gglib.h/GGEventImageUpload
+ *
+ *  NAME
+ *    GGEventImageUpload
+ *
+ *  FUNCTION
+ *    Struktura opisuje zdarzenie postpu wysyania obrazka rozpocztego przez GGSendImageData().
+ *
+ *  ATTRIBUTES
+ *    - ggeiu_Uin -- numer, do ktrego wysyany jest obrazek;
+ *    - ggeiu_State -- stan wysyania:
+ *     - GG_IMAGE_UPLOAD_PROGRESS -- kolejne porcje obrazka trafiy do kolejki wysyania
+ *       (zgaszane co GGP_IMAGE_UPLOAD_PROGRESS_STEP bajtw);
+ *     - GG_IMAGE_UPLOAD_DONE -- cay obrazek trafi do kolejki wysyania;
+ *     - GG_IMAGE_UPLOAD_FAILED -- wysyanie przerwano (bd odczytu pliku lub brak pamici);
+ *    - ggeiu_ImageSize -- rozmiar obrazka;
+ *    - ggeiu_Crc32 -- suma kontrolna obrazka (CRC32);
+ *    - ggeiu_Sent -- ilo danych obrazka dopisanych do kolejki wysyania.
+ *
+ *  SEE ALSO
+ *    GGSendImageData(), GGImageUploadPump(), GGImageUploadReport()
+ *
+ *  SOURCE
+ */
+
+#define GG_IMAGE_UPLOAD_PROGRESS (1UL)
+#define GG_IMAGE_UPLOAD_DONE     (2UL)
+#define GG_IMAGE_UPLOAD_FAILED   (3UL)
+
+struct GGEventImageUpload
+{
+	ULONG ggeiu_Uin;
+	ULONG ggeiu_State;
+	ULONG ggeiu_ImageSize;
+	ULONG ggeiu_Crc32;
+	ULONG ggeiu_Sent;
+};
+
+/********GGEventImageUpload****/
+
 /****s* gglib.h/GGEventPubDirInfo
  *
  *  NAME
@@ -772,8 +1066,13 @@ struct GGEventPubDirInfo
  *    Struktura opisujca aktualne zdarzenie.
  *
  *  ATTRIBUTES
+ *    - gge_Next -- nastpne zdarzenie na licie zwrconej przez GGWatchEvents() lub NULL;
  *    - gge_Type -- typ zdarzenia;
- *    - gge_Event -- unia struktur opisujcych rne rodzaje zdarze
+ *    - gge_Event -- unia struktur opisujcych rne rodzaje zdarze;
+ *    - gge_Arena -- arena, z ktrej wydzielone s napisy i tablice zdarzenia, zwalniana
+ *      jednorazowo przez GGFreeEvent() (prywatne);
+ *    - gge_Packet -- blok bufora odbiorczego utrzymywany przy yciu do GGFreeEvent(), jeli
+ *      dane zdarzenia na niego pokazuj (prywatne).
  *
  *  SEE ALSO
  *    GGE_TYPE_#?, GGEventError, GGEventStatusChange
@@ -783,6 +1082,7 @@ struct GGEventPubDirInfo
 
 struct GGEvent
 {
+	struct GGEvent *gge_Next;
 	LONG gge_Type;
 	union GGEvents
 	{
@@ -797,18 +1097,45 @@ struct GGEvent
 		struct GGEventMultilogonInfo   gge_MultilogonInfo;
 		struct GGEventImageData        gge_ImageData;
 		struct GGEventImageRequest     gge_ImageRequest;
+		struct GGEventImageUpload      gge_ImageUpload;
 		struct GGEventPubDirInfo       gge_PubDirInfo;
 	} gge_Event;
+	APTR gge_Arena;
+	APTR gge_Packet;
 };
 
 /********GGEvent****/
 
+/****t* gglib.h/GGPacketHandlerFunc
+ *
+ *  NAME
+ *    GGPacketHandlerFunc
+ *
+ *  FUNCTION
+ *    Typ funkcji obsugujcej odebrany pakiet. Handler dostaje nagwek pakietu
+ *    (pola ggph_Type i ggph_Length ju w kolejnoci bajtw procesora), za ktrym
+ *    w pamici le dane pakietu, i wypenia struktur zdarzenia. Pakiet ley
+ *    w buforze odbiorczym sesji i jest wany tylko w trakcie wywoania.
+ *
+ *  SEE ALSO
+ *    GGSetPacketHandler()
+ *
+ *  SOURCE
+ */
+
+struct GGPHeader;
+
+typedef VOID (*GGPacketHandlerFunc)(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac);
+
+/********GGPacketHandlerFunc****/
+
 struct GGSession *GGCreateSessionTagList(ULONG uin, STRPTR password, struct TagItem *taglist);
 #ifdef USE_INLINE_STDARG
 #define GGCreateSessionTags(uin, password, ...)	({ULONG _tags[] = {__VA_ARGS__}; GGCreateSessionTagList(uin, password, (struct TagItem*)_tags);})
 #endif /* USE_INLINE_STDARG */
 BOOL GGConnect(struct GGSession *gg_sess, STRPTR server, USHORT port);
 struct GGEvent *GGWatchEvent(struct GGSession *gg_sess);
+struct GGEvent *GGWatchEvents(struct GGSession *gg_sess, ULONG max);
 BOOL GGNotifyList(struct GGSession *gg_sess, ULONG *uins, UBYTE *types, LONG no);
 BOOL GGChangeStatus(struct GGSession *gg_sess, ULONG status, STRPTR desc);
 BOOL GGPing(struct GGSession *gg_sess);
@@ -823,7 +1150,16 @@ BOOL GGRequestImage(struct GGSession *gg_sess, ULONG uin, STRPTR id);
 BOOL GGSendImageData(struct GGSession *gg_sess, ULONG uin, BPTR fh);
 ULONG GGFindInPubDir(struct GGSession *gg_sess, ULONG uin);
 VOID GGFreeEvent(struct GGEvent *event);
+VOID GGReleaseEvent(struct GGSession *gg_sess, struct GGEvent *event);
 VOID GGFreeSession(struct GGSession *gg_sess);
+BOOL GGSetPacketHandler(struct GGSession *gg_sess, ULONG type, GGPacketHandlerFunc handler, ULONG flags);
+VOID GGSetEventMask(struct GGSession *gg_sess, ULONG mask);
+VOID GGCork(struct GGSession *gg_sess);
+VOID GGUncork(struct GGSession *gg_sess);
+ULONG GGClock(VOID);
+struct GGPresence *GGGetPresence(struct GGSession *gg_sess, ULONG uin);
+STRPTR GGGetMessageText(struct GGEventRecvMsg *rm);
+STRPTR GGGetMessageImages(struct GGEventRecvMsg *rm);
 
 STRPTR GGCreateImageId(BPTR fh);
 
@@ -24,6 +24,198 @@
 
 extern struct Library *SysBase;
 
+/* znaki koczce cig zwykego tekstu w GGMessageHTMLtoText() */
+static const UBYTE GGHtmlStop[256] =
+{
+	[0x00] = 1, ['<'] = 1, ['&'] = 1
+};
+
+#define GG_HTML_TAG_UNKNOWN   0
+#define GG_HTML_TAG_SKIP      1
+#define GG_HTML_TAG_NEWLINE   2
+#define GG_HTML_TAG_IMAGE     3
+
+#define GG_HTML_ENTITY_MAX    8   /* najdusza obsugiwana nazwa lub liczba encji */
+
+static inline BOOL GGHtmlIsAlnum(UBYTE c)
+{
+	return (BOOL)(_between('a', c, 'z') || _between('A', c, 'Z') || _between('0', c, '9'));
+}
+
+/****if* ggmessage.c/GGHtmlTagType()
+ *
+ *  NAME
+ *    GGHtmlTagType()
+ *
+ *  SYNOPSIS
+ *    static LONG GGHtmlTagType(UBYTE *name, LONG len)
+ *
+ *  FUNCTION
+ *    Funkcja rozpoznaje znacznik HTML po dugoci i pierwszej literze nazwy, wic
+ *    kada nazwa porwnywana jest co najwyej z dwoma wzorcami.
+ *
+ *  INPUTS
+ *    - name -- nazwa znacznika (bez '<' i '/');
+ *    - len -- dugo nazwy.
+ *
+ *  RESULT
+ *    Jedna z wartoci GG_HTML_TAG_#?.
+ *
+ *****/
+
+static LONG GGHtmlTagType(UBYTE *name, LONG len)
+{
+	switch(len)
+	{
+		case 1:
+			if(*name == 'b' || *name == 'i' || *name == 'u' || *name == 's')
+				return GG_HTML_TAG_SKIP;
+		break;
+
+		case 2:
+			if(name[0] == 'b' && name[1] == 'r')
+				return GG_HTML_TAG_NEWLINE;
+			if(name[0] == 'e' && name[1] == 'm')
+				return GG_HTML_TAG_SKIP;
+		break;
+
+		case 3:
+			if(!StrNCmp((STRPTR)name, "img", 3))
+				return GG_HTML_TAG_IMAGE;
+		break;
+
+		case 4:
+			if(!StrNCmp((STRPTR)name, "span", 4) || !StrNCmp((STRPTR)name, "font", 4))
+				return GG_HTML_TAG_SKIP;
+		break;
+
+		case 6:
+			if(!StrNCmp((STRPTR)name, "strong", 6))
+				return GG_HTML_TAG_SKIP;
+		break;
+	}
+
+	return GG_HTML_TAG_UNKNOWN;
+}
+
+/****if* ggmessage.c/GGHtmlEntity()
+ *
+ *  NAME
+ *    GGHtmlEntity()
+ *
+ *  SYNOPSIS
+ *    static LONG GGHtmlEntity(UBYTE *src, UBYTE *dst, LONG *used)
+ *
+ *  FUNCTION
+ *    Funkcja dekoduje encj HTML zaczynajc si w src od znaku '&'. Rozpoznawane s
+ *    encje &lt; &gt; &amp; &quot; &apos; &nbsp; oraz encje liczbowe (&#NNN; i &#xHHH;),
+ *    ktre zapisywane s w UTF-8. Zdekodowany znak nigdy nie jest duszy od encji.
+ *
+ *  INPUTS
+ *    - src -- wskanik na znak '&';
+ *    - dst -- miejsce na zdekodowany znak (do 4 bajtw);
+ *    - used -- miejsce na dugo encji w src.
+ *
+ *  RESULT
+ *    Ilo bajtw zapisanych do dst lub 0 jeli to nie jest znana encja.
+ *
+ *****/
+
+static LONG GGHtmlEntity(UBYTE *src, UBYTE *dst, LONG *used)
+{
+	UBYTE *name = src + 1;
+	LONG len = 0;
+	ULONG c = 0;
+
+	if(*name == '#')
+	{
+		BOOL hex = (name[1] == 'x' || name[1] == 'X');
+		UBYTE *digit = name + (hex ? 2 : 1);
+
+		for(; len < GG_HTML_ENTITY_MAX; len++, digit++)
+		{
+			if(_between('0', *digit, '9'))
+				c = c * (hex ? 16 : 10) + (*digit - '0');
+			else if(hex && _between('a', *digit | 0x20, 'f'))
+				c = c * 16 + ((*digit | 0x20) - 'a' + 10);
+			else
+				break;
+		}
+
+		if(len == 0 || *digit != ';' || c == 0 || c > 0x10FFFF)
+			return 0;
+
+		*used = digit + 1 - src;
+
+		if(c < 0x80)
+		{
+			dst[0] = c;
+			return 1;
+		}
+		if(c < 0x800)
+		{
+			dst[0] = 0xC0 | (c >> 6);
+			dst[1] = 0x80 | (c & 0x3F);
+			return 2;
+		}
+		if(c < 0x10000)
+		{
+			dst[0] = 0xE0 | (c >> 12);
+			dst[1] = 0x80 | ((c >> 6) & 0x3F);
+			dst[2] = 0x80 | (c & 0x3F);
+			return 3;
+		}
+		dst[0] = 0xF0 | (c >> 18);
+		dst[1] = 0x80 | ((c >> 12) & 0x3F);
+		dst[2] = 0x80 | ((c >> 6) & 0x3F);
+		dst[3] = 0x80 | (c & 0x3F);
+		return 4;
+	}
+
+	while(len < GG_HTML_ENTITY_MAX && GGHtmlIsAlnum(name[len]))
+		len++;
+
+	if(name[len] != ';')
+		return 0;
+
+	switch(*name)
+	{
+		case 'l':
+			if(len == 2 && name[1] == 't')
+				c = '<';
+		break;
+
+		case 'g':
+			if(len == 2 && name[1] == 't')
+				c = '>';
+		break;
+
+		case 'a':
+			if(len == 3 && !StrNCmp((STRPTR)name, "amp", 3))
+				c = '&';
+			else if(len == 4 && !StrNCmp((STRPTR)name, "apos", 4))
+				c = '\'';
+		break;
+
+		case 'q':
+			if(len == 4 && !StrNCmp((STRPTR)name, "quot", 4))
+				c = '"';
+		break;
+
+		case 'n':
+			if(len == 4 && !StrNCmp((STRPTR)name, "nbsp", 4))
+				c = ' ';
+		break;
+	}
+
+	if(c == 0)
+		return 0;
+
+	*used = len + 2;
+	*dst = c;
+	return 1;
+}
+
 /****if* ggmessage.c/GGMessageHTMLtoText()
  *
  *  NAME
@@ -39,6 +231,10 @@ extern struct Library *SysBase;
  *    pod adresem wskazywanym przez image. Identyfikatory kolejnych obrazkw s oddzielone
  *    znakiem '|'. Wszelkie informacje o dodatkowym formatowaniu tekstu wiadomoci zostaj zignorowane.
  *
+ *    Cigi zwykego tekstu wyszukiwane s przez tablic GGHtmlStop i kopiowane w caoci,
+ *    znaczniki rozpoznaje GGHtmlTagType(), a encje GGHtmlEntity(). Nieznane znaczniki
+ *    i encje przepisywane s bez zmian.
+ *
  *  INPUTS
  *    - html -- tre wiadomoci w formacie HTML, zakoczona 0x00;
  *    - images -- miejsce na zapisanie adresu bufora z identyfikatorami obrazkw.
@@ -50,127 +246,114 @@ extern struct Library *SysBase;
  *   NOTES
  *    W przypadku wiadomoci zawierajcych tylko obrazki (brak tekstu) funkcja zwrci NULL.
  *
+ *    Cigi tekstu midzy znacznikami s w wiadomociach GG krtkie, dlatego znaczniki i encje
+ *    wyszukiwane s po bajcie, tablic GGHtmlStop. Porwnanie z wyszukiwaniem po sowie
+ *    zawiera bench/htmlbench.c ("make bench").
+ *
  *****/
 
 STRPTR GGMessageHTMLtoText(STRPTR html, STRPTR *images)
 {
 	STRPTR result = NULL;
-	STRPTR html_act, result_act;
+	ULONG html_len, images_len = 0;
+	UBYTE *src, *dst;
 	ENTER();
 
 	*images = NULL;
 
-	if(html && (result = AllocVec(StrLen(html), MEMF_ANY)))
+	/* tekst nigdy nie jest duszy od HTML-a, z ktrego powsta */
+	if(html && (result = AllocVec((html_len = StrLen(html)) + 1, MEMF_ANY)))
 	{
-		html_act = html;
-		result_act = result;
+		src = (UBYTE*)html;
+		dst = (UBYTE*)result;
 
-		while(*html_act != 0x00)
+		for(;;)
 		{
-			if(*html_act == '<')
+			UBYTE *run = src;
+
+			while(!GGHtmlStop[*src])
+				src++;
+
+			if(src != run)
 			{
-				if(!StrNCmp(html_act, "<b>", 3) || !StrNCmp(html_act, "<i>", 3) || !StrNCmp(html_act, "<u>", 3))
-				{
-					html_act += 3;
-				}
-				else if(!StrNCmp(html_act, "</b>", 4) || !StrNCmp(html_act, "</i>", 4) || !StrNCmp(html_act, "</u>", 4))
-				{
-					html_act += 4;
-				}
-				else if(!StrNCmp(html_act, "<span", 5))
-				{
-					while(*html_act != 0x00 && *html_act != '>')
-						html_act++;
-					html_act++;
-				}
-				else if(!StrNCmp(html_act, "</span>", 7))
-				{
-					html_act += 7;
-				}
-				else if(!StrNCmp(html_act, "<br>", 4))
+				CopyMem(run, dst, src - run);
+				dst += src - run;
+			}
+
+			if(*src == 0x00)
+				break;
+
+			if(*src == '<')
+			{
+				UBYTE *name = src + 1, *end;
+				LONG len = 0, type;
+
+				if(*name == '/')
+					name++;
+
+				while(GGHtmlIsAlnum(name[len]))
+					len++;
+
+				if((type = GGHtmlTagType(name, len)) == GG_HTML_TAG_UNKNOWN)
 				{
-					html_act += 4;
-					*result_act++ = '\n';
+					*dst++ = *src++;
+					continue;
 				}
-				else if(!StrNCmp(html_act, "<br/>", 5))
+
+				for(end = name + len; *end != 0x00 && *end != '>'; end++);
+
+				if(*end == 0x00) /* niedomknity znacznik, reszta wiadomoci jest pomijana */
+					break;
+
+				if(type == GG_HTML_TAG_NEWLINE && name == src + 1)
 				{
-					html_act += 5;
-					*result_act++ = '\n';
+					*dst++ = '\n';
 				}
-				else if(!StrNCmp(html_act, "<img name=\"", 4))
+				else if(type == GG_HTML_TAG_IMAGE)
 				{
-					STRPTR name_end = html_act + 11;
+					UBYTE *id;
 
-					html_act += 11;
-
-					while(*name_end != 0x00 && *name_end != '"')
-						name_end++;
-
-					if(*name_end != 0x00)
+					/* szukamy atrybutu name="..." wewntrz znacznika */
+					for(id = name + len; id + 6 <= end; id++)
 					{
-						*name_end = 0x00;
-
-						if(*images)
+						if(!StrNCmp((STRPTR)id, "name=\"", 6))
 						{
-							STRPTR old = *images;
+							UBYTE *id_end;
 
-							*images = FmtNew("%ls|%ls", old, html_act);
+							id += 6;
 
-							StrFree(old);
-						}
-						else
-							*images = StrNewLen(html_act, name_end - html_act);
+							for(id_end = id; id_end < end && *id_end != '"'; id_end++);
 
-						*name_end = '"';
-					}
-
-					while(*name_end != 0x00 && *name_end != '>')
-						name_end++;
+							if(id_end < end && (*images || (*images = AllocVec(html_len + 1, MEMF_ANY))))
+							{
+								if(images_len > 0)
+									(*images)[images_len++] = '|';
 
-					html_act = name_end + 1;
+								CopyMem(id, *images + images_len, id_end - id);
+								images_len += id_end - id;
+								(*images)[images_len] = 0x00;
+							}
+							break;
+						}
+					}
 				}
-				else
-					*result_act++ = *html_act++;
+
+				src = end + 1;
 			}
-			else if(*html_act == '&')
+			else
 			{
-				if(!StrNCmp(html_act, "&lt;", 4))
-				{
-					html_act += 4;
-					*result_act++ = '<';
-				}
-				else if(!StrNCmp(html_act, "&gt;", 4))
-				{
-					html_act += 4;
-					*result_act++ = '>';
-				}
-				else if(!StrNCmp(html_act, "&quot;", 6))
-				{
-					html_act += 6;
-					*result_act++ = '"';
-				}
-				else if(!StrNCmp(html_act, "&apos;", 6))
-				{
-					html_act += 6;
-					*result_act++ = '\'';
-				}
-				else if(!StrNCmp(html_act, "&amp;", 5))
-				{
-					html_act += 5;
-					*result_act++ = '&';
-				}
-				else if(!StrNCmp(html_act, "&nbsp;", 6))
+				LONG used, written;
+
+				if((written = GGHtmlEntity(src, dst, &used)))
 				{
-					html_act += 6;
-					*result_act++ = ' ';
+					src += used;
+					dst += written;
 				}
 				else
-					*result_act++ = *html_act++;
+					*dst++ = *src++;
 			}
-			else
-				*result_act++ = *html_act++;
 		}
-		*result_act = 0x00;
+		*dst = 0x00;
 
 		if(*result == 0x00) /* wiadomo nie zawieraa adnego tekstu (np. przesyanie tylko obrazka) */
 		{
@@ -183,155 +366,226 @@ STRPTR GGMessageHTMLtoText(STRPTR html, STRPTR *images)
 	return result;
 }
 
-/****if* ggmessage.c/GGMessageTextToHTML()
+#define GG_HTML_SPAN_OPEN   "<span style=\"color:#000000; font-family:'MS Shell Dlg 2'; font-size:9pt; \">"
+#define GG_HTML_SPAN_CLOSE  "</span>"
+#define GG_HTML_IMG_OPEN    "<img name=\""
+#define GG_HTML_IMG_CLOSE   "\">"
+
+#define GG_TEXT_END         0xFF
+
+/* indeksy w GGTextEntities[] dla znakw, ktre trzeba zapisa inaczej, GG_TEXT_END dla 0x00 */
+static const UBYTE GGTextEscape[256] =
+{
+	[0x00] = GG_TEXT_END, ['<'] = 1, ['>'] = 2, ['"'] = 3, ['\''] = 4, ['&'] = 5, ['\n'] = 6
+};
+
+static const struct
+{
+	CONST_STRPTR str;
+	LONG len;
+} GGTextEntities[] =
+{
+	{"", 0}, {"&lt;", 4}, {"&gt;", 4}, {"&quot;", 6}, {"&apos;", 6}, {"&amp;", 5}, {"<br>", 4}
+};
+
+/* dopisuje len bajtw do bufora, jeli si mieszcz */
+static inline BOOL GGHtmlPut(UBYTE **dst, UBYTE *end, CONST_STRPTR data, LONG len)
+{
+	if(end - *dst < len)
+		return FALSE;
+
+	CopyMem((APTR)data, *dst, len);
+	*dst += len;
+	return TRUE;
+}
+
+/****if* ggmessage.c/GGMessageHTMLLength()
  *
  *  NAME
- *    GGMessageTextToHTML()
+ *    GGMessageHTMLLength()
  *
  *  SYNOPSIS
- *    STRPTR GGMessageTextToHTML(STRPTR txt, STRPTR image)
+ *    LONG GGMessageHTMLLength(STRPTR txt, STRPTR images)
  *
  *  FUNCTION
- *    Funkcja przeprowadza konwersj czystego tekstu na tekst w HTML-u zgodny
- *    z formatem wiadomoci sieci GG.
+ *    Funkcja zwraca dokadn dugo wiadomoci HTML, jak utworzy GGMessageTextToHTMLBuffer()
+ *    z podanego tekstu i obrazkw (bez koczcego 0x00). Tekst przegldany jest t sam tablic
+ *    GGTextEscape, ale bez kopiowania, wic miejsce w pakiecie mona zarezerwowa dokadnie,
+ *    a nie na najgorszy przypadek (kady znak jako szecioznakowa encja).
  *
  *  INPUTS
- *    - txt -- tre wiadomoci zakoczona 0x00;
- *    - images -- identyfikatory obrazkw, ktre naley wstawi do wiadomoci oddzielone
- *     znakiem '|' (jeli NULL to aden obrazek nie bdzie wstawiony).
+ *    - txt -- tre wiadomoci zakoczona 0x00 lub NULL;
+ *    - images -- identyfikatory obrazkw oddzielone znakiem '|' lub NULL.
  *
  *  RESULT
- *    Wskanik na bufor zawierajcy tekst wiadomoci zapisany w HTML-u
- *    w kodowaniu UTF-8.
+ *    Dugo wiadomoci w HTML-u.
  *
  *****/
 
-STRPTR GGMessageTextToHTML(STRPTR txt, STRPTR images)
+LONG GGMessageHTMLLength(STRPTR txt, STRPTR images)
 {
-	STRPTR result = NULL;
-	STRPTR span = "<span style=\"color:#000000; font-family:'MS Shell Dlg 2'; font-size:9pt; \">";
-	ULONG imgs = 0;
-	ULONG html_len = 75 + 7; /* <span...> + </span> */
-	STRPTR txt_act = txt;
-	ENTER();
+	LONG result = sizeof(GG_HTML_SPAN_OPEN) - 1 + sizeof(GG_HTML_SPAN_CLOSE) - 1;
 
-	if(images)
+	if(txt)
 	{
-		STRPTR t = images;
-
-		imgs++;
+		UBYTE *src = (UBYTE*)txt;
+		UBYTE e;
 
-		while(*t++ != 0x00)
+		for(;;)
 		{
-			if(*t == '|')
-				imgs++;
-		}
+			UBYTE *run = src;
+
+			while(!GGTextEscape[*src])
+				src++;
+
+			result += src - run;
+
+			if((e = GGTextEscape[*src++]) == GG_TEXT_END)
+				break;
 
-		html_len += imgs * 29; /* <img name="xxxxxxxxxxxxxxxx"> */
+			result += GGTextEntities[e].len;
+		}
 	}
 
-	if(txt)
+	if(images)
 	{
-		while(*txt != 0x00)
+		UBYTE *id = (UBYTE*)images;
+
+		while(*id != 0x00)
 		{
-			if(*txt == '<' || *txt == '>' || *txt == '\n')
-				html_len += 4;
-			else if(*txt == '"' || *txt == '\'')
-				html_len += 6;
-			else if(*txt == '&')
-				html_len += 5;
-			else
-				html_len++;
+			UBYTE *id_end = id;
+
+			while(*id_end != 0x00 && *id_end != '|')
+				id_end++;
+
+			result += sizeof(GG_HTML_IMG_OPEN) - 1 + (id_end - id) + sizeof(GG_HTML_IMG_CLOSE) - 1;
 
-			txt++;
+			id = (*id_end == '|') ? id_end + 1 : id_end;
 		}
 	}
 
-	if((result = AllocVec(html_len + 1, MEMF_ANY)))
-	{
-		LONG i;
-		STRPTR result_act = result + 75;
+	return result;
+}
 
-		StrNCopy(span, result, 75);
+/****if* ggmessage.c/GGMessageTextToHTMLBuffer()
+ *
+ *  NAME
+ *    GGMessageTextToHTMLBuffer()
+ *
+ *  SYNOPSIS
+ *    LONG GGMessageTextToHTMLBuffer(STRPTR txt, STRPTR images, UBYTE *buf, LONG size)
+ *
+ *  FUNCTION
+ *    Funkcja w jednym przejciu zapisuje do bufora czysty tekst jako wiadomo HTML zgodn
+ *    z formatem wiadomoci sieci GG. Znaki wymagajce zamiany wyszukiwane s przez tablic
+ *    GGTextEscape, cigi znakw pomidzy nimi kopiowane s w caoci, a znaczniki <span>
+ *    i <img> pochodz z gotowych wzorcw. Dziki temu wiadomo mona zapisa bezporednio
+ *    do pakietu (GGPacketPutHTML()).
+ *
+ *  INPUTS
+ *    - txt -- tre wiadomoci zakoczona 0x00 lub NULL;
+ *    - images -- identyfikatory obrazkw, ktre naley wstawi do wiadomoci oddzielone
+ *     znakiem '|' (jeli NULL to aden obrazek nie bdzie wstawiony);
+ *    - buf -- bufor na wiadomo;
+ *    - size -- rozmiar bufora, wystarczy GGMessageHTMLLength().
+ *
+ *  RESULT
+ *    Dugo zapisanej wiadomoci (bez koczcego 0x00, ktry nie jest zapisywany)
+ *    lub -1 jeli wiadomo nie zmiecia si w buforze.
+ *
+ *****/
+
+LONG GGMessageTextToHTMLBuffer(STRPTR txt, STRPTR images, UBYTE *buf, LONG size)
+{
+	UBYTE *dst = buf, *end = buf + size;
 
-		if(txt)
+	if(!GGHtmlPut(&dst, end, GG_HTML_SPAN_OPEN, sizeof(GG_HTML_SPAN_OPEN) - 1))
+		return -1;
+
+	if(txt)
+	{
+		UBYTE *src = (UBYTE*)txt;
+
+		for(;;)
 		{
-			while(*txt_act != 0x00)
-			{
-				if(*txt_act == '<')
-				{
-					*result_act++ = '&';
-					*result_act++ = 'l';
-					*result_act++ = 't';
-					*result_act++ = ';';
-				}
-				else if(*txt_act == '>')
-				{
-					*result_act++ = '&';
-					*result_act++ = 'g';
-					*result_act++ = 't';
-					*result_act++ = ';';
-				}
-				else if(*txt_act == '"')
-				{
-					*result_act++ = '&';
-					*result_act++ = 'q';
-					*result_act++ = 'u';
-					*result_act++ = 'o';
-					*result_act++ = 't';
-					*result_act++ = ';';
-				}
-				else if(*txt_act == '\'')
-				{
-					*result_act++ = '&';
-					*result_act++ = 'a';
-					*result_act++ = 'p';
-					*result_act++ = 'o';
-					*result_act++ = 's';
-					*result_act++ = ';';
-				}
-				else if(*txt_act == '&')
-				{
-					*result_act++ = '&';
-					*result_act++ = 'a';
-					*result_act++ = 'm';
-					*result_act++ = 'p';
-					*result_act++ = ';';
-				}
-				else if(*txt_act == '\n')
-				{
-					*result_act++ = '<';
-					*result_act++ = 'b';
-					*result_act++ = 'r';
-					*result_act++ = '>';
-				}
-				else
-				{
-					*result_act++ = *txt_act;
-				}
-				txt_act++;
-			}
+			UBYTE *run = src;
+			UBYTE e;
+
+			while(!GGTextEscape[*src])
+				src++;
+
+			if(!GGHtmlPut(&dst, end, (CONST_STRPTR)run, src - run))
+				return -1;
+
+			if((e = GGTextEscape[*src++]) == GG_TEXT_END)
+				break;
+
+			if(!GGHtmlPut(&dst, end, GGTextEntities[e].str, GGTextEntities[e].len))
+				return -1;
 		}
+	}
 
-		*result_act = 0x00;
+	if(images)
+	{
+		UBYTE *id = (UBYTE*)images;
 
-		for(i = 0; i < imgs; i++)
+		while(*id != 0x00)
 		{
-			result_act = StrCat("<img name=\"", result_act);
-			result_act = StrNCopy(images + i * 16 + i, result_act, 16);
-			result_act = StrCat("\">", result_act);
-		}
+			UBYTE *id_end = id;
 
-		*result_act++ = '<';
-		*result_act++ = '/';
-		*result_act++ = 's';
-		*result_act++ = 'p';
-		*result_act++ = 'a';
-		*result_act++ = 'n';
-		*result_act++ = '>';
-		*result_act = 0x00;
+			while(*id_end != 0x00 && *id_end != '|')
+				id_end++;
+
+			if(!GGHtmlPut(&dst, end, GG_HTML_IMG_OPEN, sizeof(GG_HTML_IMG_OPEN) - 1)
+			 || !GGHtmlPut(&dst, end, (CONST_STRPTR)id, id_end - id)
+			 || !GGHtmlPut(&dst, end, GG_HTML_IMG_CLOSE, sizeof(GG_HTML_IMG_CLOSE) - 1))
+				return -1;
+
+			id = (*id_end == '|') ? id_end + 1 : id_end;
+		}
 	}
 
+	if(!GGHtmlPut(&dst, end, GG_HTML_SPAN_CLOSE, sizeof(GG_HTML_SPAN_CLOSE) - 1))
+		return -1;
+
+	return dst - buf;
+}
+
+/****if* ggmessage.c/GGMessageTextToHTML()
+ *
+ *  NAME
+ *    GGMessageTextToHTML()
+ *
+ *  SYNOPSIS
+ *    STRPTR GGMessageTextToHTML(STRPTR txt, STRPTR image)
+ *
+ *  FUNCTION
+ *    Funkcja przeprowadza konwersj czystego tekstu na tekst w HTML-u zgodny
+ *    z formatem wiadomoci sieci GG.
+ *
+ *  INPUTS
+ *    - txt -- tre wiadomoci zakoczona 0x00;
+ *    - images -- identyfikatory obrazkw, ktre naley wstawi do wiadomoci oddzielone
+ *     znakiem '|' (jeli NULL to aden obrazek nie bdzie wstawiony).
+ *
+ *  RESULT
+ *    Wskanik na bufor zawierajcy tekst wiadomoci zapisany w HTML-u
+ *    w kodowaniu UTF-8.
+ *
+ *  SEE ALSO
+ *    GGMessageTextToHTMLBuffer()
+ *
+ *****/
+
+STRPTR GGMessageTextToHTML(STRPTR txt, STRPTR images)
+{
+	STRPTR result;
+	LONG len = GGMessageHTMLLength(txt, images);
+	ENTER();
+
+	if((result = AllocVec(len + 1, MEMF_ANY)))
+		result[GGMessageTextToHTMLBuffer(txt, images, (UBYTE*)result, len)] = 0x00;
+
 	LEAVE();
 	return result;
 }
@@ -22,5 +22,7 @@
 
 STRPTR GGMessageHTMLtoText(STRPTR html, STRPTR *images);
 STRPTR GGMessageTextToHTML(STRPTR txt, STRPTR images);
+LONG GGMessageHTMLLength(STRPTR txt, STRPTR images);
+LONG GGMessageTextToHTMLBuffer(STRPTR txt, STRPTR images, UBYTE *buf, LONG size);
 
 #endif /* __GGMESSAGE_H__ */
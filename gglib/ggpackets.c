@@ -22,7 +22,10 @@
 #include <proto/socket.h>
 #include <sys/errno.h>
 #include <proto/utility.h>
+#include <proto/dos.h>
+#include <dos/dos.h>
 #include <libvstring.h>
+#include <stddef.h>
 #include "globaldefines.h"
 #include "endianess.h"
 #include "support.h"
@@ -31,6 +34,7 @@
 #include "sha1.h"
 #include "ggmessage.h"
 #include "ggdefs.h"
+#include "gghandlers.h"
 
 #define SocketBase gg_sess->SocketBase
 
@@ -45,55 +49,123 @@ extern struct Library *SysBase, *DOSBase, *UtilityBase, *OpenSSL3Base;
  *    GGPHeader *GGReceivePacket(struct GGSession *gg_sess)
  *
  *  FUNCTION
- *    Funkcja najpierw odbiera nagwek pakietu GG, pniej reszt pakietu.
+ *    Funkcja zwraca kolejny kompletny pakiet z bufora odbiorczego sesji. Jeli w buforze
+ *    nie ma caego pakietu, funkcja jednym wywoaniem SSL_read() pobiera do bufora tyle danych,
+ *    ile aktualnie jest dostpnych (zwykle kilka pakietw naraz), po czym wydziela z nich
+ *    pierwszy pakiet. Kolejne wywoania zwracaj nastpne pakiety ju bez odczytu z sieci.
  *
  *  INPUTS
  *    gg_sess -- wskanik na struktur GGSession odpowiadajcej za poczenie.
  *
  *  RESULT
- *    Wskanik na zaalokowan struktur GGPHeader po ktrej bezporednio w pamici
- *    jest dalsza cz pakietu lub NULL w przypadku bdu. Zwrcony bufor naley zwolni
- *    uywajc FreeVec().
+ *    Wskanik na struktur GGPHeader po ktrej bezporednio w pamici jest dalsza cz
+ *    pakietu lub NULL w przypadku bdu. Zwrcony wskanik pokazuje na wntrze bufora
+ *    odbiorczego sesji, nie naley go zwalnia. Pakiet jest wany do nastpnego wywoania
+ *    GGReceivePacket(), handler moe modyfikowa jego zawarto.
+ *
+ *  NOTES
+ *    Pakiet zakoczony jest zerem. Bajt zera nadpisuje pocztek nastpnego pakietu w buforze,
+ *    dlatego jego oryginalna warto jest zapamitywana w ggs_RecvSaved i przywracana
+ *    przy kolejnym wywoaniu.
+ *
+ *    Jeli zdarzenie zatrzymao blok bufora (GGRecvBlock), wczeniejsze pakiety nie s
+ *    nadpisywane - niekompletny pakiet przenoszony jest wtedy do nowego bloku.
  *
  *****/
 
 struct GGPHeader *GGReceivePacket(struct GGSession *gg_sess)
 {
-	struct GGPHeader *header = NULL;
-	BYTE *packet;
-	LONG len = -1, res;
+	struct GGPHeader *header;
+	LONG need, res;
+	BOOL pinned;
 	ENTER();
 
+	if(gg_sess->ggs_RecvBuffer != NULL)
+	{
+		/* przywracamy bajt nadpisany zerem koczcym poprzedni pakiet */
+		gg_sess->ggs_RecvBuffer[gg_sess->ggs_RecvPos] = gg_sess->ggs_RecvSaved;
+	}
+
 	while(TRUE)
 	{
-		if((gg_sess->ggs_RecvBuffer == NULL && gg_sess->ggs_RecvLen == 0))
+		LONG avail = gg_sess->ggs_RecvLen - gg_sess->ggs_RecvPos;
+
+		if(avail >= (LONG)sizeof(struct GGPHeader))
 		{
-			if((gg_sess->ggs_RecvBuffer = AllocVec(sizeof(struct GGPHeader) + 1, MEMF_ANY | MEMF_CLEAR)) == NULL)
+			header = (struct GGPHeader*)(gg_sess->ggs_RecvBuffer + gg_sess->ggs_RecvPos);
+
+			if(EndianFix32(header->ggph_Length) > GGP_MAX_PACKET_LENGTH)
 			{
-				/* brak pamici */
+				/* strumie jest rozsynchronizowany, nie da si go ju poskada */
+				GG_SESSION_ERROR(gg_sess, GGS_ERRNO_UNKNOWN_PACKET);
 				goto fail;
 			}
-		}
 
-		header = (struct GGPHeader*)gg_sess->ggs_RecvBuffer;
+			need = sizeof(struct GGPHeader) + EndianFix32(header->ggph_Length);
 
-		if(gg_sess->ggs_RecvLen < sizeof(struct GGPHeader))
+			if(avail >= need)
+			{
+				/* mamy cay pakiet */
+				break;
+			}
+		}
+		else
 		{
 			/* nie odebralimy jeszcze caego nagwka */
-			len = sizeof(struct GGPHeader) - gg_sess->ggs_RecvLen;
+			need = sizeof(struct GGPHeader);
 		}
-		else if(gg_sess->ggs_RecvLen >= sizeof(struct GGPHeader) + EndianFix32(header->ggph_Length))
+
+		/* jeli zdarzenia pokazuj na dane w buforze, nie wolno ich przesuwa ani nadpisywa */
+		pinned = gg_sess->ggs_RecvBlock != NULL && gg_sess->ggs_RecvBlock->ggrb_Refs > 1;
+
+		/* przesuwamy niekompletny pakiet na pocztek bufora */
+		if(gg_sess->ggs_RecvPos > 0 && !pinned)
 		{
-			/* odebralimy cay pakiet */
-			break;
+			/* CopyMem() w MorphOS obsuguje nakadajce si obszary */
+			if(avail > 0)
+				CopyMem(gg_sess->ggs_RecvBuffer + gg_sess->ggs_RecvPos, gg_sess->ggs_RecvBuffer, avail);
+
+			gg_sess->ggs_RecvLen = avail;
+			gg_sess->ggs_RecvPos = 0;
 		}
-		else
+
+		/* w buforze musi zmieci si cay pakiet i zero koczce, jeli nie - przenosimy
+		 * niekompletny pakiet do nowego bloku; to samo robimy gdy w zablokowanym buforze koczy si miejsce */
+		if(gg_sess->ggs_RecvPos + need + 1 > gg_sess->ggs_RecvSize ||
+		 (pinned && gg_sess->ggs_RecvSize - gg_sess->ggs_RecvLen - 1 < gg_sess->ggs_RecvSize / 4))
 		{
-			/* nie odebralimy jeszcze caego pakietu */
-			len = sizeof(struct GGPHeader) + EndianFix32(header->ggph_Length) - gg_sess->ggs_RecvLen;
+			LONG size = gg_sess->ggs_RecvSize ? gg_sess->ggs_RecvSize : GGP_RECV_BUFFER_SIZE;
+			struct GGRecvBlock *block;
+
+			while(size < need + 1)
+				size <<= 1;
+
+			if((block = AllocVec(sizeof(struct GGRecvBlock) + size, MEMF_ANY)) == NULL)
+			{
+				GG_SESSION_ERROR(gg_sess, GGS_ERRNO_MEM);
+				goto fail;
+			}
+
+			block->ggrb_Refs = 1;
+
+			if(gg_sess->ggs_RecvBlock)
+			{
+				if(avail > 0)
+					CopyMem(gg_sess->ggs_RecvBuffer + gg_sess->ggs_RecvPos, block->ggrb_Data, avail);
+
+				GGRecvBlockRelease(gg_sess->ggs_RecvBlock);
+			}
+
+			gg_sess->ggs_RecvBlock = block;
+			gg_sess->ggs_RecvBuffer = block->ggrb_Data;
+			gg_sess->ggs_RecvSize = size;
+			gg_sess->ggs_RecvLen = avail;
+			gg_sess->ggs_RecvPos = 0;
 		}
 
-		res = RecvAllSSL(SocketBase, gg_sess->ggs_SSL, (BYTE*)header + gg_sess->ggs_RecvLen, len);
+		/* pobieramy wszystko co si zmieci, a nie tylko brakujc cz pakietu */
+		res = RecvAllSSL(SocketBase, gg_sess->ggs_SSL, gg_sess->ggs_RecvBuffer + gg_sess->ggs_RecvLen,
+			gg_sess->ggs_RecvSize - gg_sess->ggs_RecvLen - 1);
 
 		if(res == 0)
 		{
@@ -116,52 +188,283 @@ struct GGPHeader *GGReceivePacket(struct GGSession *gg_sess)
 			goto fail;
 		}
 
-		if(gg_sess->ggs_RecvLen + res == sizeof(struct GGPHeader))
-		{
-			BYTE *buf;
-			/* odebralimy cay nagwek */
-
-			if(EndianFix32(header->ggph_Length) == 0)
-				break; /* nie ma dalszej czci pakietu, zwracamy co mamy, niech si martwi dispacher pakietw */
-
-			if(EndianFix32(header->ggph_Length) > 65535)
-				goto fail;
-
-			if((buf = AllocVec(sizeof(struct GGPHeader) + EndianFix32(header->ggph_Length) + 1, MEMF_ANY | MEMF_CLEAR)) == NULL)
-				goto fail;
-
-			CopyMem(gg_sess->ggs_RecvBuffer, buf, sizeof(struct GGPHeader));
-			FreeVec(gg_sess->ggs_RecvBuffer);
-			gg_sess->ggs_RecvBuffer = buf;
-		}
 		gg_sess->ggs_RecvLen += res;
 	}
 
-	/* przepinamy bufor jako nasz nowy pakiet */
-	packet = gg_sess->ggs_RecvBuffer;
-	/* przygotowujemy bufor do kolejnego odbierania pakietu */
-	gg_sess->ggs_RecvBuffer = NULL;
-	gg_sess->ggs_RecvLen = 0;
+	/* przesuwamy si za zwracany pakiet */
+	gg_sess->ggs_RecvPos += need;
 
 	/* zakaczamy pakiet zerem (stringi s zwykle na kocu pakietu) */
-	*(packet + sizeof(struct GGPHeader) + EndianFix32(header->ggph_Length)) = 0;
+	gg_sess->ggs_RecvSaved = gg_sess->ggs_RecvBuffer[gg_sess->ggs_RecvPos];
+	gg_sess->ggs_RecvBuffer[gg_sess->ggs_RecvPos] = 0;
 
 	header->ggph_Length = EndianFix32(header->ggph_Length);
 	header->ggph_Type = EndianFix32(header->ggph_Type);
 
 	LEAVE();
-	return (struct GGPHeader*)packet;
+	return header;
 
-fail: /* bd, tego pakietu ju nie uratujemy... */
-	if(gg_sess->ggs_RecvBuffer)
-		FreeVec(gg_sess->ggs_RecvBuffer);
-	gg_sess->ggs_RecvBuffer = NULL;
+fail: /* bd, danych z bufora ju nie uratujemy... */
+	if(gg_sess->ggs_RecvBlock)
+	{
+		/* blok moe by jeszcze uywany przez zdarzenia, wic nie zapisujemy go od pocztku */
+		GGRecvBlockRelease(gg_sess->ggs_RecvBlock);
+		gg_sess->ggs_RecvBlock = NULL;
+		gg_sess->ggs_RecvBuffer = NULL;
+		gg_sess->ggs_RecvSize = 0;
+	}
+	gg_sess->ggs_RecvLen = 0;
+	gg_sess->ggs_RecvPos = 0;
 
 eagain: /* zwracamy nulla i czekamy na ponowne wywoanie */
+	if(gg_sess->ggs_RecvBuffer != NULL)
+		gg_sess->ggs_RecvSaved = gg_sess->ggs_RecvBuffer[gg_sess->ggs_RecvPos];
 	LEAVE();
 	return NULL;
 }
 
+/****if* ggpackets.c/GGRecvBlockRelease()
+ *
+ *  NAME
+ *    GGRecvBlockRelease()
+ *
+ *  SYNOPSIS
+ *    VOID GGRecvBlockRelease(struct GGRecvBlock *block)
+ *
+ *  FUNCTION
+ *    Funkcja zmniejsza licznik odwoa bloku bufora odbiorczego i zwalnia go, jeli
+ *    nikt ju go nie uywa.
+ *
+ *  INPUTS
+ *    block -- wskanik na blok do zwolnienia.
+ *
+ *****/
+
+VOID GGRecvBlockRelease(struct GGRecvBlock *block)
+{
+	if(--block->ggrb_Refs == 0)
+		FreeVec(block);
+}
+
+/****if* ggpackets.c/GGPacketPending()
+ *
+ *  NAME
+ *    GGPacketPending()
+ *
+ *  SYNOPSIS
+ *    BOOL GGPacketPending(struct GGSession *gg_sess)
+ *
+ *  FUNCTION
+ *    Funkcja sprawdza czy s dane do przetworzenia, na ktre nie zareaguje ju WaitSelect():
+ *    kompletny pakiet w buforze odbiorczym sesji lub rekordy odszyfrowane wczeniej przez
+ *    OpenSSL i trzymane w jego wewntrznym buforze (SSL_pending()).
+ *
+ *  INPUTS
+ *    gg_sess -- wskanik na struktur GGSession odpowiadajcej za poczenie.
+ *
+ *  RESULT
+ *    - TRUE -- jeli GGReceivePacket() zwrci kolejne dane bez czekania na socket;
+ *    - FALSE -- w.p.p.
+ *
+ *****/
+
+BOOL GGPacketPending(struct GGSession *gg_sess)
+{
+	LONG avail = gg_sess->ggs_RecvLen - gg_sess->ggs_RecvPos;
+
+	if(avail >= (LONG)sizeof(struct GGPHeader))
+	{
+		/* pierwszy bajt nagwka moe by nadpisany zerem, ale ggph_Length ley za nim */
+		struct GGPHeader *header = (struct GGPHeader*)(gg_sess->ggs_RecvBuffer + gg_sess->ggs_RecvPos);
+
+		if(avail >= (LONG)(sizeof(struct GGPHeader) + EndianFix32(header->ggph_Length)))
+			return TRUE;
+	}
+
+	if(gg_sess->ggs_SSL != NULL && SSL_pending(gg_sess->ggs_SSL) > 0)
+		return TRUE;
+
+	return FALSE;
+}
+
+/****if* ggpackets.c/GGPacketLane()
+ *
+ *  NAME
+ *    GGPacketLane()
+ *
+ *  SYNOPSIS
+ *    static struct GGWriteLane *GGPacketLane(struct GGSession *gg_sess, ULONG type)
+ *
+ *  FUNCTION
+ *    Funkcja zwraca kolejk wysyania odpowiedni dla klasy priorytetu pakietu danego typu.
+ *    Zmiany listy kontaktw trafiaj do tej samej klasy co sama lista, eby serwer otrzyma
+ *    je we waciwej kolejnoci.
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajcej za poczenie;
+ *    - type -- typ pakietu.
+ *
+ *  RESULT
+ *    Wskanik na kolejk z tablicy ggs_WriteLanes.
+ *
+ *  SEE ALSO
+ *    GGS_LANE_#?
+ *
+ *****/
+
+static struct GGWriteLane *GGPacketLane(struct GGSession *gg_sess, ULONG type)
+{
+	ULONG lane;
+
+	switch(type)
+	{
+		case GGP_TYPE_GGLOGIN:
+		case GGP_TYPE_PING:
+		case GGP_TYPE_MSG_ACK:
+		case GGP_TYPE_NEW_STATUS:
+		case GGP_TYPE_MULTILOGON_DISCONNECT:
+			lane = GGS_LANE_CONTROL;
+		break;
+
+		case GGP_TYPE_SEND_MSG_OLD:
+		case GGP_TYPE_LIST_EMPTY:
+		case GGP_TYPE_NOTIFY_NORMAL:
+		case GGP_TYPE_NOTIFY_LAST:
+		case GGP_TYPE_ADD_NOTIFY:
+		case GGP_TYPE_REMOVE_NOTIFY:
+		case GGP_TYPE_USER_LIST_REQ:
+			lane = GGS_LANE_BULK;
+		break;
+
+		default:
+			lane = GGS_LANE_CHAT;
+	}
+
+	return &gg_sess->ggs_WriteLanes[lane];
+}
+
+/****if* ggpackets.c/GGWriteNextLane()
+ *
+ *  NAME
+ *    GGWriteNextLane()
+ *
+ *  SYNOPSIS
+ *    static struct GGWriteLane *GGWriteNextLane(struct GGSession *gg_sess)
+ *
+ *  FUNCTION
+ *    Funkcja wybiera kolejk, z ktrej naley wysa nastpny segment. Czciowo wysany
+ *    segment (ggs_WriteBusy) jest zawsze dokaczany. W pozostaych przypadkach wybierana
+ *    jest najwysza niepusta klasa priorytetu, chyba e klasa GGS_LANE_BULK czekaa ju
+ *    przez GGS_LANE_BULK_SKIP_MAX segmentw.
+ *
+ *  INPUTS
+ *    gg_sess -- wskanik na struktur GGSession odpowiadajcej za poczenie.
+ *
+ *  RESULT
+ *    Wskanik na kolejk lub NULL jeli wszystkie kolejki s puste.
+ *
+ *****/
+
+static struct GGWriteLane *GGWriteNextLane(struct GGSession *gg_sess)
+{
+	struct GGWriteLane *bulk = &gg_sess->ggs_WriteLanes[GGS_LANE_BULK];
+	ULONG i;
+
+	if(gg_sess->ggs_WriteBusy)
+		return gg_sess->ggs_WriteBusy;
+
+	/* nie pozwalamy, eby cigy ruch wyszych klas cakiem wstrzyma obrazki i list */
+	if(bulk->ggwl_Head && gg_sess->ggs_WriteSkipped >= GGS_LANE_BULK_SKIP_MAX)
+		return bulk;
+
+	for(i = 0; i < GGS_LANE_COUNT; i++)
+	{
+		if(gg_sess->ggs_WriteLanes[i].ggwl_Head)
+			return &gg_sess->ggs_WriteLanes[i];
+	}
+
+	return NULL;
+}
+
+/* docza segment na koniec kolejki (jeli jeszcze go w niej nie ma) i dolicza len nowych danych */
+static VOID GGWriteLaneAppend(struct GGSession *gg_sess, struct GGWriteLane *lane, struct GGWriteSegment *seg, LONG len)
+{
+	if(seg != lane->ggwl_Tail)
+	{
+		if(lane->ggwl_Tail)
+			lane->ggwl_Tail->ggws_Next = seg;
+		else
+			lane->ggwl_Head = seg;
+		lane->ggwl_Tail = seg;
+	}
+
+	lane->ggwl_Len += len;
+	gg_sess->ggs_WriteLen += len;
+
+	/* przy wstrzymanym wysyaniu czekamy a uzbiera si peny rekord TLS lub minie termin */
+	if(gg_sess->ggs_Cork == 0 || gg_sess->ggs_WriteLen >= GGP_WRITE_RECORD_SIZE)
+		gg_sess->ggs_Check |= GGS_CHECK_WRITE;
+}
+
+/****if* ggpackets.c/GGWriteCorked()
+ *
+ *  NAME
+ *    GGWriteCorked()
+ *
+ *  SYNOPSIS
+ *    BOOL GGWriteCorked(struct GGSession *gg_sess)
+ *
+ *  FUNCTION
+ *    Funkcja sprawdza czy wysyanie danych z kolejek jest wstrzymane przez GGCork().
+ *    Wstrzymanie przestaje obowizywa, gdy w kolejkach uzbiera si peny rekord TLS
+ *    (GGP_WRITE_RECORD_SIZE) lub od pierwszego GGCork() minie GGS_CORK_DEADLINE.
+ *
+ *  INPUTS
+ *    gg_sess -- wskanik na struktur GGSession odpowiadajcej za poczenie.
+ *
+ *  RESULT
+ *    - TRUE -- jeli dane naley dalej zbiera;
+ *    - FALSE -- jeli naley je wysa.
+ *
+ *  SEE ALSO
+ *    GGCork(), GGUncork()
+ *
+ *****/
+
+BOOL GGWriteCorked(struct GGSession *gg_sess)
+{
+	if(gg_sess->ggs_Cork == 0 || gg_sess->ggs_WriteLen >= GGP_WRITE_RECORD_SIZE)
+		return FALSE;
+
+	return (BOOL)(GGClock() - gg_sess->ggs_CorkTime < GGS_CORK_DEADLINE);
+}
+
+/****if* ggpackets.c/GGCorkBegin()
+ *
+ *  NAME
+ *    GGCorkBegin()
+ *
+ *  SYNOPSIS
+ *    VOID GGCorkBegin(struct GGSession *gg_sess)
+ *
+ *  FUNCTION
+ *    Funkcja wstrzymuje wysyanie danych z kolejek sesji (zagniedone wywoania s
+ *    zliczane), termin GGS_CORK_DEADLINE liczony jest od pierwszego wywoania.
+ *
+ *  INPUTS
+ *    gg_sess -- wskanik na struktur GGSession odpowiadajcej za poczenie.
+ *
+ *  SEE ALSO
+ *    GGCork(), GGWriteCorked()
+ *
+ *****/
+
+VOID GGCorkBegin(struct GGSession *gg_sess)
+{
+	if(gg_sess->ggs_Cork++ == 0)
+		gg_sess->ggs_CorkTime = GGClock();
+}
+
 /****if* ggpackets.c/GGWriteData()
  *
  *  NAME
@@ -171,7 +474,9 @@ eagain: /* zwracamy nulla i czekamy na ponowne wywo
  *    LONG GGWriteData(struct GGSession *gg_sess)
  *
  *  FUNCTION
- *    Funkcja wysya dane z bufora wysyanych danych sesji.
+ *    Funkcja wysya kolejne segmenty z kolejek wysyanych danych sesji, dopki socket
+ *    je przyjmuje. Segmenty wybierane s wedug klas priorytetu (GGWriteNextLane()),
+ *    a wysane s od razu zwalniane.
  *
  *  INPUTS
  *    gg_sess -- wskanik na struktur GGSession odpowiadajcej za poczenie.
@@ -185,42 +490,66 @@ eagain: /* zwracamy nulla i czekamy na ponowne wywo
 
 LONG GGWriteData(struct GGSession *gg_sess)
 {
-	LONG result;
+	struct GGWriteLane *lane, *bulk = &gg_sess->ggs_WriteLanes[GGS_LANE_BULK];
+	struct GGWriteSegment *seg;
+	LONG result = 0;
 	ENTER();
 
-	if(gg_sess->ggs_WriteBuffer == NULL || gg_sess->ggs_WriteLen == 0)
+	while((lane = GGWriteNextLane(gg_sess)))
 	{
-		return 0;
-	}
+		LONG res;
 
-	result = SendAllSSL(gg_sess->ggs_SSL, gg_sess->ggs_WriteBuffer + gg_sess->ggs_WrittenLen, gg_sess->ggs_WriteLen - gg_sess->ggs_WrittenLen);
+		seg = lane->ggwl_Head;
 
-	if(result == -1)
-	{
-		/* bd wysyania */
+		/* SSL_write() trzeba powtrzy z tym samym segmentem, wic zapamitujemy go do czasu wysania */
+		gg_sess->ggs_WriteBusy = lane;
 
-		if(Errno() == EAGAIN)
+		res = SendAllSSL(gg_sess->ggs_SSL, seg->ggws_Data + seg->ggws_Written, seg->ggws_Len - seg->ggws_Written);
+
+		if(res == -1)
 		{
-			/* nic krytycznego, mona sprbowa ponownie */
-			result = -2;
+			/* bd wysyania */
+
+			if(Errno() == EAGAIN)
+			{
+				/* nic krytycznego, mona sprbowa ponownie */
+				if(result == 0)
+					result = -2;
+			}
+			else
+			{
+				/* krytyczny, umieramy */
+				GG_SESSION_ERROR(gg_sess, GGS_ERRNO_SOCKET_LIB);
+				result = -1;
+			}
+			break;
 		}
-		else
+
+		seg->ggws_Written += res;
+		lane->ggwl_Len -= res;
+		gg_sess->ggs_WriteLen -= res;
+		result += res;
+
+		if(seg->ggws_Written < seg->ggws_Len)
 		{
-			/* krytyczny, umieramy */
-			GG_SESSION_ERROR(gg_sess, GGS_ERRNO_SOCKET_LIB);
+			/* troch poszo, ale jeszcze nie cay segment, socket jest peny */
+			break;
 		}
-	}
-	else if(gg_sess->ggs_WrittenLen + result >= gg_sess->ggs_WriteLen)
-	{
-		/* wysano cay bufor */
-		FreeVec(gg_sess->ggs_WriteBuffer);
-		gg_sess->ggs_WriteBuffer = NULL;
-		gg_sess->ggs_WrittenLen = gg_sess->ggs_WriteLen = 0;
-	}
-	else if(result > 0)
-	{
-		/* troch poszo, ale jeszcze nie cae, aktualizujemy ile wysalimy */
-		gg_sess->ggs_WrittenLen += result;
+
+		/* wysano cay segment */
+		gg_sess->ggs_WriteBusy = NULL;
+
+		if(lane == bulk)
+			gg_sess->ggs_WriteSkipped = 0;
+		else if(bulk->ggwl_Head)
+			gg_sess->ggs_WriteSkipped++;
+
+		if((lane->ggwl_Head = seg->ggws_Next) == NULL)
+			lane->ggwl_Tail = NULL;
+
+		if(seg->ggws_Size == 0)
+			FreeVec(seg->ggws_Data);
+		FreeVec(seg);
 	}
 
 	LEAVE();
@@ -265,6 +594,13 @@ LONG GGWriteData(struct GGSession *gg_sess)
  *  RESULT
  *    Wskanik na zaalokowany bufor pakietu lub NULL w przypadku bdu.
  *
+ *  NOTES
+ *    Funkcja przeznaczona jest dla pakietw o zmiennej dugoci, pakiety o staej
+ *    dugoci naley budowa przez GGPacketBeginFixed().
+ *
+ *  SEE ALSO
+ *    GGP_SIZE_#?, GGPacketBeginFixed()
+ *
  *****/
 
 BYTE *GGPacketCreateTagList(ULONG type, ULONG *len, struct TagItem *taglist)
@@ -437,8 +773,11 @@ BYTE *GGPacketCreateTagList(ULONG type, ULONG *len, struct TagItem *taglist)
  *    BOOL GGAddToWriteBuffer(struct GGSession *gg_sess, BYTE *add, LONG len)
  *
  *  FUNCTION
- *    Funkcja dodaje dane wskazywane przez add o dugoci len na koniec bufora wysyania
- *    sesji opisanej przez gg_sess. Automatycznie ustawiane jest pole ggs_Check
+ *    Funkcja dodaje dane wskazywane przez add o dugoci len na koniec kolejki wysyania
+ *    sesji opisanej przez gg_sess, odpowiedniej dla typu pakietu zapisanego w nagwku
+ *    (GGPacketLane()). Mae pakiety s doklejane do ostatniego segmentu czcego
+ *    (i od razu zwalniane), due staj si osobnym segmentem. Koszt doczenia nie zaley od
+ *    iloci danych czekajcych w kolejce. Automatycznie ustawiane jest pole ggs_Check
  *    struktury sesji tak, aby biblioteka informowaa o chci zapisania bufora do socketu.
  *
  *  INPUTS
@@ -458,188 +797,1158 @@ BYTE *GGPacketCreateTagList(ULONG type, ULONG *len, struct TagItem *taglist)
 
 BOOL GGAddToWriteBuffer(struct GGSession *gg_sess, BYTE *add, LONG len)
 {
+	struct GGWriteLane *lane;
+	struct GGWriteSegment *tail;
 	BOOL result = FALSE;
 	ENTER();
 
-	if(add && len > 0)
+	if(add && len >= (LONG)sizeof(struct GGPHeader))
 	{
-		if(gg_sess->ggs_WriteBuffer == NULL && gg_sess->ggs_WriteLen == 0)
+		lane = GGPacketLane(gg_sess, EndianFix32(((struct GGPHeader*)add)->ggph_Type));
+		tail = lane->ggwl_Tail;
+
+		if(tail && tail->ggws_Size - tail->ggws_Len >= len)
 		{
-			gg_sess->ggs_WriteBuffer = add;
-			gg_sess->ggs_WriteLen = len;
-			gg_sess->ggs_WrittenLen = 0;
-			gg_sess->ggs_Check |= GGS_CHECK_WRITE;
+			/* mieci si w segmencie czcym */
+			CopyMem(add, tail->ggws_Data + tail->ggws_Len, len);
+			tail->ggws_Len += len;
+			FreeVec(add);
 			result = TRUE;
 		}
-		else
+		else if(len <= GGP_WRITE_COALESCE_MAX)
 		{
-			BYTE *old_buf = gg_sess->ggs_WriteBuffer + gg_sess->ggs_WrittenLen;
-			LONG old_len = gg_sess->ggs_WriteLen - gg_sess->ggs_WrittenLen;
-			BYTE *new_buf;
+			/* may pakiet, zaczynamy nowy segment czcy */
+			struct GGWriteSegment *seg;
 
-			if((new_buf = AllocVec(old_len + len, MEMF_ANY | MEMF_CLEAR)))
+			if((seg = AllocVec(sizeof(struct GGWriteSegment) + GGP_WRITE_RECORD_SIZE, MEMF_ANY)))
 			{
-				CopyMem(old_buf, new_buf, old_len);
-				CopyMem(add, new_buf + old_len, len);
-
-				FreeVec(gg_sess->ggs_WriteBuffer);
+				seg->ggws_Next = NULL;
+				seg->ggws_Data = (BYTE*)(seg + 1);
+				seg->ggws_Len = len;
+				seg->ggws_Size = GGP_WRITE_RECORD_SIZE;
+				seg->ggws_Written = 0;
+				CopyMem(add, seg->ggws_Data, len);
 				FreeVec(add);
+				result = TRUE;
+			}
+			tail = seg;
+		}
+		else
+		{
+			/* duy pakiet, doczamy go do kolejki bez kopiowania */
+			struct GGWriteSegment *seg;
 
-				gg_sess->ggs_WriteBuffer = new_buf;
-				gg_sess->ggs_WriteLen = old_len + len;
-				gg_sess->ggs_WrittenLen = 0;
-				gg_sess->ggs_Check |= GGS_CHECK_WRITE;
-
+			if((seg = AllocVec(sizeof(struct GGWriteSegment), MEMF_ANY)))
+			{
+				seg->ggws_Next = NULL;
+				seg->ggws_Data = add;
+				seg->ggws_Len = len;
+				seg->ggws_Size = 0;
+				seg->ggws_Written = 0;
 				result = TRUE;
 			}
+			tail = seg;
 		}
+
+		if(result)
+			GGWriteLaneAppend(gg_sess, lane, tail, len);
 	}
 
 	LEAVE();
 	return result;
 }
 
-/****if* ggpackets.c/GGAcceptMessage()
+/****if* ggpackets.c/GGFreeWriteBuffer()
  *
  *  NAME
- *    GGAcceptMessage()
+ *    GGFreeWriteBuffer()
  *
  *  SYNOPSIS
- *    BOOL GGAcceptMessage(struct GGSession *gg_sess, ULONG seq)
+ *    VOID GGFreeWriteBuffer(struct GGSession *gg_sess)
  *
  *  FUNCTION
- *    Funkcja dodaje do bufora wysyania pakiet potwierdzenia otrzymania wiadomoci.
+ *    Funkcja zwalnia wszystkie niewysane segmenty z kolejek wysyania sesji.
  *
  *  INPUTS
- *    - gg_sess -- wskanik na struktur GGSession odpowiadajce za poczenie;
- *    - seq -- numer sekwencyjny otrzymanej wiadomoci
+ *    gg_sess -- wskanik na struktur GGSession odpowiadajcej za poczenie.
+ *
+ *****/
+
+VOID GGFreeWriteBuffer(struct GGSession *gg_sess)
+{
+	struct GGWriteSegment *seg;
+	ULONG i;
+
+	for(i = 0; i < GGS_LANE_COUNT; i++)
+	{
+		struct GGWriteLane *lane = &gg_sess->ggs_WriteLanes[i];
+
+		while((seg = lane->ggwl_Head))
+		{
+			lane->ggwl_Head = seg->ggws_Next;
+
+			if(seg->ggws_Size == 0)
+				FreeVec(seg->ggws_Data);
+			FreeVec(seg);
+		}
+
+		lane->ggwl_Tail = NULL;
+		lane->ggwl_Len = 0;
+	}
+
+	gg_sess->ggs_WriteLen = 0;
+	gg_sess->ggs_WriteBusy = NULL;
+	gg_sess->ggs_WriteSkipped = 0;
+}
+
+/****if* ggpackets.c/GGPacketBegin()
+ *
+ *  NAME
+ *    GGPacketBegin()
+ *
+ *  SYNOPSIS
+ *    BOOL GGPacketBegin(struct GGSession *gg_sess, struct GGPacketBuilder *pb, ULONG type, LONG max_len)
+ *
+ *  FUNCTION
+ *    Funkcja rezerwuje w kolejce wysyania sesji (tej klasy priorytetu, do ktrej naley
+ *    typ pakietu) miejsce na pakiet typu type o dugoci danych nie wikszej ni max_len
+ *    i wpisuje jego typ do nagwka. Jeli ostatni segment
+ *    czcy ma do miejsca, pakiet budowany jest bezporednio w nim, w przeciwnym wypadku
+ *    alokowany jest nowy segment. Pola pakietu naley dopisa funkcjami GGPacketPut#?(),
+ *    po czym wywoa GGPacketCommit().
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajcej za poczenie;
+ *    - pb -- wskanik na struktur GGPacketBuilder do wypenienia;
+ *    - type -- typ pakietu;
+ *    - max_len -- maksymalna dugo danych pakietu (bez nagwka).
  *
  *  RESULT
- *    - TRUE -- jeli wszystko zakoczyo si sukcesem;
- *    - FALSE -- w.p.p.
+ *    - TRUE -- jeli udao si zarezerwowa miejsce;
+ *    - FALSE -- jeli zabrako pamici.
+ *
+ *  NOTES
+ *    Po udanym wywoaniu naley zawsze wywoa GGPacketCommit(), nawet jeli budowa pakietu
+ *    si nie powioda, poniewa zwalnia ono nowo zaalokowany segment. Pomidzy
+ *    GGPacketBegin() a GGPacketCommit() nie wolno dodawa do kolejki innych danych.
+ *
+ *  SEE ALSO
+ *    GGPacketBuilder, GGPacketCommit()
  *
  *****/
 
-BOOL GGAcceptMessage(struct GGSession *gg_sess, ULONG seq)
+BOOL GGPacketBegin(struct GGSession *gg_sess, struct GGPacketBuilder *pb, ULONG type, LONG max_len)
 {
+	struct GGWriteLane *lane = GGPacketLane(gg_sess, type);
+	struct GGWriteSegment *seg = lane->ggwl_Tail;
+	LONG need = sizeof(struct GGPHeader) + max_len;
 	BOOL result = FALSE;
-	BYTE *pac;
-	ULONG len;
 	ENTER();
 
-	if((pac = GGPacketCreateTags(GGP_TYPE_MSG_ACK, &len,
-		GGA_CreatePacket_ULONG, seq,
-	TAG_END)))
+	if(!(seg && seg->ggws_Size - seg->ggws_Len >= need))
+	{
+		/* nie mieci si, nowy segment trafi do kolejki dopiero w GGPacketCommit() */
+		LONG size = (need > GGP_WRITE_COALESCE_MAX) ? need : GGP_WRITE_RECORD_SIZE;
+
+		if((seg = AllocVec(sizeof(struct GGWriteSegment) + size, MEMF_ANY)))
+		{
+			seg->ggws_Next = NULL;
+			seg->ggws_Data = (BYTE*)(seg + 1);
+			seg->ggws_Len = 0;
+			seg->ggws_Size = size;
+			seg->ggws_Written = 0;
+		}
+	}
+
+	if(seg)
+	{
+		pb->ggpb_Session = gg_sess;
+		pb->ggpb_Lane = lane;
+		pb->ggpb_Segment = seg;
+		pb->ggpb_Start = seg->ggws_Data + seg->ggws_Len;
+		pb->ggpb_Pos = pb->ggpb_Start + sizeof(struct GGPHeader);
+		pb->ggpb_End = pb->ggpb_Start + need;
+		pb->ggpb_Overflow = FALSE;
+
+		((struct GGPHeader*)pb->ggpb_Start)->ggph_Type = EndianFix32(type);
+		result = TRUE;
+	}
+
+	LEAVE();
+	return result;
+}
+
+/****if* ggpackets.c/GGPacketBeginRecord()
+ *
+ *  NAME
+ *    GGPacketBeginRecord()
+ *
+ *  SYNOPSIS
+ *    - APTR GGPacketBeginRecord(struct GGSession *gg_sess, struct GGPacketBuilder *pb, ULONG type, LONG size)
+ *    - struct name *GGPacketBeginFixed(struct GGSession *gg_sess, struct GGPacketBuilder *pb, ULONG type, name)
+ *
+ *  FUNCTION
+ *    Funkcja rozpoczyna budow pakietu o staej dugoci size (jak GGPacketBegin())
+ *    i zwraca wskanik na jego dane, ktre naley wypeni bezporednio (z konwersj
+ *    EndianFix#?()) przed wywoaniem GGPacketCommit(). Makro GGPacketBeginFixed() pobiera
+ *    rozmiar ze struktury pakietu w czasie kompilacji.
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajcej za poczenie;
+ *    - pb -- wskanik na struktur GGPacketBuilder do wypenienia;
+ *    - type -- typ pakietu;
+ *    - size -- dugo danych pakietu.
+ *
+ *  RESULT
+ *    Wskanik na dane pakietu lub NULL jeli zabrako pamici.
+ *
+ *  NOTES
+ *    Wskanik nie musi by wyrwnany, pola struktur pakietw s spakowane.
+ *
+ *  SEE ALSO
+ *    GGP_SIZE_#?, GGPacketBegin(), GGPacketCommit()
+ *
+ *****/
+
+APTR GGPacketBeginRecord(struct GGSession *gg_sess, struct GGPacketBuilder *pb, ULONG type, LONG size)
+{
+	APTR result = NULL;
+	ENTER();
+
+	if(GGPacketBegin(gg_sess, pb, type, size))
+	{
+		result = pb->ggpb_Pos;
+		pb->ggpb_Pos += size;
+	}
+
+	LEAVE();
+	return result;
+}
+
+/* sprawdza czy w pakiecie jest jeszcze miejsce na len bajtw */
+static inline BOOL GGPacketFits(struct GGPacketBuilder *pb, LONG len)
+{
+	if(len < 0 || pb->ggpb_End - pb->ggpb_Pos < len)
+		pb->ggpb_Overflow = TRUE;
+
+	return (BOOL)!pb->ggpb_Overflow;
+}
+
+/****if* ggpackets.c/GGPacketPut#?()
+ *
+ *  NAME
+ *    GGPacketPut#?()
+ *
+ *  SYNOPSIS
+ *    - VOID GGPacketPutULONG(struct GGPacketBuilder *pb, ULONG val)
+ *    - VOID GGPacketPutUSHORT(struct GGPacketBuilder *pb, USHORT val)
+ *    - VOID GGPacketPutUBYTE(struct GGPacketBuilder *pb, UBYTE val)
+ *    - VOID GGPacketPutBlock(struct GGPacketBuilder *pb, APTR data, LONG len)
+ *    - VOID GGPacketPutString(struct GGPacketBuilder *pb, STRPTR str)
+ *    - VOID GGPacketPutZero(struct GGPacketBuilder *pb, LONG len)
+ *    - VOID GGPacketPutHTML(struct GGPacketBuilder *pb, STRPTR txt, STRPTR images)
+ *
+ *  FUNCTION
+ *    Funkcje dopisuj kolejne pole do pakietu rozpocztego przez GGPacketBegin(), z konwersj
+ *    na little endian. GGPacketPutString() wpisuje tekst bez koczcego 0x00 (tak jak
+ *    GGA_CreatePacket_STRPTR), GGPacketPutZero() wpisuje blok len zer, a GGPacketPutHTML()
+ *    zapisuje tekst i obrazki jako wiadomo HTML bezporednio w pakiecie (bez 0x00,
+ *    naley zarezerwowa na ni GGMessageHTMLLength() bajtw). Jeli pole nie mieci
+ *    si w zarezerwowanym miejscu, nic nie jest zapisywane, a ustawiane jest pole ggpb_Overflow.
+ *
+ *  INPUTS
+ *    - pb -- wskanik na struktur GGPacketBuilder;
+ *    - val, data, len, str, txt, images -- dopisywane pole.
+ *
+ *  SEE ALSO
+ *    GGPacketBegin(), GGPacketCreateTagList()
+ *
+ *****/
+
+VOID GGPacketPutULONG(struct GGPacketBuilder *pb, ULONG val)
+{
+	if(GGPacketFits(pb, sizeof(ULONG)))
+	{
+		*((ULONG*)pb->ggpb_Pos) = EndianFix32(val);
+		pb->ggpb_Pos += sizeof(ULONG);
+	}
+}
+
+VOID GGPacketPutUSHORT(struct GGPacketBuilder *pb, USHORT val)
+{
+	if(GGPacketFits(pb, sizeof(USHORT)))
+	{
+		*((USHORT*)pb->ggpb_Pos) = EndianFix16(val);
+		pb->ggpb_Pos += sizeof(USHORT);
+	}
+}
+
+VOID GGPacketPutUBYTE(struct GGPacketBuilder *pb, UBYTE val)
+{
+	if(GGPacketFits(pb, sizeof(UBYTE)))
+		*pb->ggpb_Pos++ = val;
+}
+
+VOID GGPacketPutBlock(struct GGPacketBuilder *pb, APTR data, LONG len)
+{
+	if(GGPacketFits(pb, len))
+	{
+		CopyMem(data, (APTR)pb->ggpb_Pos, len);
+		pb->ggpb_Pos += len;
+	}
+}
+
+VOID GGPacketPutString(struct GGPacketBuilder *pb, STRPTR str)
+{
+	if(str)
+		GGPacketPutBlock(pb, (APTR)str, StrLen(str));
+}
+
+VOID GGPacketPutZero(struct GGPacketBuilder *pb, LONG len)
+{
+	if(GGPacketFits(pb, len))
+	{
+		MemSet(pb->ggpb_Pos, 0x00, len);
+		pb->ggpb_Pos += len;
+	}
+}
+
+VOID GGPacketPutHTML(struct GGPacketBuilder *pb, STRPTR txt, STRPTR images)
+{
+	LONG len;
+
+	if(!pb->ggpb_Overflow)
+	{
+		if((len = GGMessageTextToHTMLBuffer(txt, images, (UBYTE*)pb->ggpb_Pos, pb->ggpb_End - pb->ggpb_Pos)) >= 0)
+			pb->ggpb_Pos += len;
+		else
+			pb->ggpb_Overflow = TRUE;
+	}
+}
+
+/****if* ggpackets.c/GGPacketCommit()
+ *
+ *  NAME
+ *    GGPacketCommit()
+ *
+ *  SYNOPSIS
+ *    BOOL GGPacketCommit(struct GGPacketBuilder *pb)
+ *
+ *  FUNCTION
+ *    Funkcja koczy budow pakietu rozpoczt przez GGPacketBegin(): uzupenia dugo
+ *    w nagwku i docza pakiet do kolejki wysyania sesji. Automatycznie ustawiane jest
+ *    pole ggs_Check struktury sesji. Jeli podczas budowy pakietu zabrako zarezerwowanego
+ *    miejsca, pakiet jest porzucany.
+ *
+ *  INPUTS
+ *    pb -- wskanik na struktur GGPacketBuilder wypenion przez GGPacketBegin().
+ *
+ *  RESULT
+ *    - TRUE -- jeli pakiet trafi do kolejki;
+ *    - FALSE -- w.p.p.
+ *
+ *  SEE ALSO
+ *    GGPacketBegin()
+ *
+ *****/
+
+BOOL GGPacketCommit(struct GGPacketBuilder *pb)
+{
+	struct GGWriteSegment *seg = pb->ggpb_Segment;
+	BOOL result = FALSE;
+	ENTER();
+
+	if(!pb->ggpb_Overflow)
+	{
+		LONG len = pb->ggpb_Pos - pb->ggpb_Start;
+
+		((struct GGPHeader*)pb->ggpb_Start)->ggph_Length = EndianFix32(len - sizeof(struct GGPHeader));
+		seg->ggws_Len += len;
+
+		GGWriteLaneAppend(pb->ggpb_Session, pb->ggpb_Lane, seg, len);
+		result = TRUE;
+	}
+	else if(seg != pb->ggpb_Lane->ggwl_Tail)
+	{
+		FreeVec(seg);
+	}
+
+	LEAVE();
+	return result;
+}
+
+/****if* ggpackets.c/GGImageUploadChunk()
+ *
+ *  NAME
+ *    GGImageUploadChunk()
+ *
+ *  SYNOPSIS
+ *    static BOOL GGImageUploadChunk(struct GGSession *gg_sess, struct GGImageUpload *up)
+ *
+ *  FUNCTION
+ *    Funkcja dopisuje do kolejki wysyania pakiet z nastpn porcj danych obrazka.
+ *    Pierwszy pakiet (flaga 0x05) zawiera nazw pliku, a obrazek nie wikszy ni
+ *    GGP_IMAGE_SINGLE_MAX mieci si w nim w caoci. Kolejne pakiety (flaga 0x06) nios
+ *    po GGP_IMAGE_CHUNK_SIZE bajtw. Dane czytane s z pliku bezporednio do pakietu.
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajc za poczenie;
+ *    - up -- wskanik na wysyany obrazek.
+ *
+ *  RESULT
+ *    - TRUE -- jeli pakiet trafi do kolejki;
+ *    - FALSE -- jeli zabrako pamici lub nie udao si odczyta pliku.
+ *
+ *****/
+
+static BOOL GGImageUploadChunk(struct GGSession *gg_sess, struct GGImageUpload *up)
+{
+	struct GGPacketBuilder pb;
+	BOOL first = (up->ggiu_Sent == 0);
+	LONG chunk = up->ggiu_Size - up->ggiu_Sent;
+	BOOL result = FALSE;
+
+	if(chunk > GGP_IMAGE_CHUNK_SIZE && !(first && chunk <= GGP_IMAGE_SINGLE_MAX))
+		chunk = GGP_IMAGE_CHUNK_SIZE;
+
+	if(GGPacketBegin(gg_sess, &pb, GGP_TYPE_SEND_MSG_OLD, 5 * sizeof(ULONG) + 2 + (first ? sizeof(up->ggiu_FileName) : 0) + chunk))
+	{
+		GGPacketPutULONG(&pb, up->ggiu_Uin);           /* numer odbiorcy obrazka */
+		GGPacketPutULONG(&pb, up->ggiu_Seq++);         /* numer sekwencyjny, kolejne liczby od zera */
+		GGPacketPutULONG(&pb, 0x0000004UL);            /* klasa wiadomoci - obrazek (4) */
+		GGPacketPutUBYTE(&pb, 0x00);                   /* pusta tre wiadomoci */
+		GGPacketPutUBYTE(&pb, first ? 0x05 : 0x06);    /* flaga -> pierwszy (0x05) lub kolejny (0x06) pakiet danych */
+		GGPacketPutULONG(&pb, up->ggiu_Size);          /* rozmiar obrazka */
+		GGPacketPutULONG(&pb, up->ggiu_Crc32);         /* suma CRC32 obrazka */
+
+		if(first)
+		{
+			GGPacketPutString(&pb, up->ggiu_FileName);  /* nazwa pliku */
+			GGPacketPutUBYTE(&pb, 0x00);                /* bajt koczcy nazw pliku */
+		}
+
+		/* dane obrazka czytamy z pliku od razu do pakietu */
+		if(GGPacketFits(&pb, chunk) && FRead(up->ggiu_File, pb.ggpb_Pos, 1, chunk) == chunk)
+			pb.ggpb_Pos += chunk;
+		else
+			pb.ggpb_Overflow = TRUE;
+
+		if((result = GGPacketCommit(&pb)))
+			up->ggiu_Sent += chunk;
+	}
+
+	return result;
+}
+
+/* wypenia zdarzenie GGE_TYPE_IMAGE_UPLOAD, jeli nie jest wyczone mask zdarze */
+static BOOL GGImageUploadEvent(struct GGSession *gg_sess, struct GGEvent *event, struct GGImageUpload *up, ULONG state)
+{
+	if(!(gg_sess->ggs_EventMask & GGE_MASK(GGE_TYPE_IMAGE_UPLOAD)))
+		return FALSE;
+
+	event->gge_Type = GGE_TYPE_IMAGE_UPLOAD;
+	event->gge_Event.gge_ImageUpload.ggeiu_Uin = up->ggiu_Uin;
+	event->gge_Event.gge_ImageUpload.ggeiu_State = state;
+	event->gge_Event.gge_ImageUpload.ggeiu_ImageSize = up->ggiu_Size;
+	event->gge_Event.gge_ImageUpload.ggeiu_Crc32 = up->ggiu_Crc32;
+	event->gge_Event.gge_ImageUpload.ggeiu_Sent = up->ggiu_Sent;
+
+	return TRUE;
+}
+
+/****if* ggpackets.c/GGImageUploadPump()
+ *
+ *  NAME
+ *    GGImageUploadPump()
+ *
+ *  SYNOPSIS
+ *    VOID GGImageUploadPump(struct GGSession *gg_sess)
+ *
+ *  FUNCTION
+ *    Funkcja dopisuje do kolejki wysyania kolejne porcje wysyanych obrazkw, dopki
+ *    w kolejce klasy GGS_LANE_BULK jest mniej ni GGP_IMAGE_UPLOAD_WATERMARK danych. Obrazki obsugiwane s
+ *    na zmian (po jednym pakiecie, obsuony obrazek trafia na koniec listy), dziki
+ *    czemu kilka jednoczesnych wysyek postpuje rwno. Zakoczone wysyki s przenoszone
+ *    na list ggs_UploadDone (jeli zdarzenia GGE_TYPE_IMAGE_UPLOAD nie s wyczone mask),
+ *    a ich pliki zamykane.
+ *
+ *    Wywoywana przez GGHandleConnected() przed wysaniem danych z kolejki. Funkcja nie
+ *    wypenia zdarze, aby wysyanie obrazkw nie wstrzymywao odbioru pakietw.
+ *
+ *  INPUTS
+ *    gg_sess -- wskanik na struktur GGSession odpowiadajc za poczenie.
+ *
+ *  SEE ALSO
+ *    GGImageUpload, GGImageUploadReport(), GGSendImageData()
+ *
+ *****/
+
+VOID GGImageUploadPump(struct GGSession *gg_sess)
+{
+	struct GGImageUpload *up;
+	ENTER();
+
+	while((up = gg_sess->ggs_UploadHead) && gg_sess->ggs_WriteLanes[GGS_LANE_BULK].ggwl_Len < GGP_IMAGE_UPLOAD_WATERMARK)
+	{
+		BOOL ok = GGImageUploadChunk(gg_sess, up);
+
+		if(!(gg_sess->ggs_UploadHead = up->ggiu_Next))
+			gg_sess->ggs_UploadTail = &gg_sess->ggs_UploadHead;
+		up->ggiu_Next = NULL;
+
+		if(ok && up->ggiu_Sent < up->ggiu_Size)
+		{
+			*gg_sess->ggs_UploadTail = up;
+			gg_sess->ggs_UploadTail = &up->ggiu_Next;
+		}
+		else
+		{
+			Close(up->ggiu_File);
+			up->ggiu_File = (BPTR)NULL;
+
+			if(gg_sess->ggs_EventMask & GGE_MASK(GGE_TYPE_IMAGE_UPLOAD))
+			{
+				struct GGImageUpload **link = &gg_sess->ggs_UploadDone;
+
+				/* zakoczenia zgaszamy w kolejnoci, na licie jest zwykle jedna lub dwie wysyki */
+				while(*link)
+					link = &(*link)->ggiu_Next;
+
+				up->ggiu_State = ok ? GG_IMAGE_UPLOAD_DONE : GG_IMAGE_UPLOAD_FAILED;
+				*link = up;
+			}
+			else
+				FreeMem(up, sizeof(struct GGImageUpload));
+		}
+	}
+
+	LEAVE();
+}
+
+/****if* ggpackets.c/GGImageUploadReport()
+ *
+ *  NAME
+ *    GGImageUploadReport()
+ *
+ *  SYNOPSIS
+ *    BOOL GGImageUploadReport(struct GGSession *gg_sess, struct GGEvent *event)
+ *
+ *  FUNCTION
+ *    Funkcja wypenia zdarzenie GGE_TYPE_IMAGE_UPLOAD dla jednej wysyki obrazka. Zakoczenia
+ *    i bdy (lista ggs_UploadDone) zgaszane s zawsze, postp tylko wtedy, gdy od ostatniego
+ *    zgoszenia do kolejki trafio co najmniej GGP_IMAGE_UPLOAD_PROGRESS_STEP bajtw obrazka.
+ *
+ *    Wywoywana przez GGHandleConnected() dopiero, gdy nie odebrano adnego pakietu.
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajc za poczenie;
+ *    - event -- wskanik na struktur zdarzenia do wypenienia.
+ *
+ *  RESULT
+ *    - TRUE -- jeli wypeniono zdarzenie;
+ *    - FALSE -- jeli nie ma nic do zgoszenia.
+ *
+ *  SEE ALSO
+ *    GGImageUploadPump(), GGEventImageUpload
+ *
+ *****/
+
+BOOL GGImageUploadReport(struct GGSession *gg_sess, struct GGEvent *event)
+{
+	struct GGImageUpload *up;
+	BOOL result = FALSE;
+	ENTER();
+
+	if((up = gg_sess->ggs_UploadDone))
+	{
+		gg_sess->ggs_UploadDone = up->ggiu_Next;
+		result = GGImageUploadEvent(gg_sess, event, up, up->ggiu_State);
+		FreeMem(up, sizeof(struct GGImageUpload));
+	}
+	else
+	{
+		for(up = gg_sess->ggs_UploadHead; up && !result; up = up->ggiu_Next)
+		{
+			if(up->ggiu_Sent - up->ggiu_Reported >= GGP_IMAGE_UPLOAD_PROGRESS_STEP)
+			{
+				up->ggiu_Reported = up->ggiu_Sent;
+				result = GGImageUploadEvent(gg_sess, event, up, GG_IMAGE_UPLOAD_PROGRESS);
+			}
+		}
+	}
+
+	LEAVE();
+	return result;
+}
+
+/****if* ggpackets.c/GGImageUploadFree()
+ *
+ *  NAME
+ *    GGImageUploadFree()
+ *
+ *  SYNOPSIS
+ *    VOID GGImageUploadFree(struct GGSession *gg_sess)
+ *
+ *  FUNCTION
+ *    Funkcja przerywa wszystkie wysyki obrazkw sesji, zamyka ich pliki i zwalnia pami,
+ *    razem z niezgoszonymi jeszcze zakoczonymi wysykami.
+ *
+ *  INPUTS
+ *    gg_sess -- wskanik na struktur GGSession odpowiadajc za poczenie.
+ *
+ *****/
+
+VOID GGImageUploadFree(struct GGSession *gg_sess)
+{
+	struct GGImageUpload *up;
+
+	while((up = gg_sess->ggs_UploadHead))
+	{
+		gg_sess->ggs_UploadHead = up->ggiu_Next;
+		Close(up->ggiu_File);
+		FreeMem(up, sizeof(struct GGImageUpload));
+	}
+
+	while((up = gg_sess->ggs_UploadDone))
+	{
+		gg_sess->ggs_UploadDone = up->ggiu_Next;
+		FreeMem(up, sizeof(struct GGImageUpload));
+	}
+
+	gg_sess->ggs_UploadTail = &gg_sess->ggs_UploadHead;
+}
+
+/****if* ggpackets.c/GGAcceptMessage()
+ *
+ *  NAME
+ *    GGAcceptMessage()
+ *
+ *  SYNOPSIS
+ *    BOOL GGAcceptMessage(struct GGSession *gg_sess, ULONG seq)
+ *
+ *  FUNCTION
+ *    Funkcja zapamituje potwierdzenie otrzymania wiadomoci w tablicy ggs_AckSeq sesji.
+ *    Pakiety potwierdze tworzone s razem przez GGAckFlush(), po zdekodowaniu caej porcji
+ *    odebranych pakietw, a jeli tablica jest pena - od razu.
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajce za poczenie;
+ *    - seq -- numer sekwencyjny otrzymanej wiadomoci
+ *
+ *  RESULT
+ *    - TRUE -- jeli wszystko zakoczyo si sukcesem;
+ *    - FALSE -- w.p.p.
+ *
+ *  SEE ALSO
+ *    GGAckFlush(), GGS_ACK_BATCH_MAX
+ *
+ *****/
+
+BOOL GGAcceptMessage(struct GGSession *gg_sess, ULONG seq)
+{
+	BOOL result = TRUE;
+	ENTER();
+
+	if(gg_sess->ggs_AckCount == GGS_ACK_BATCH_MAX)
+		result = GGAckFlush(gg_sess, TRUE);
+
+	if(result)
+	{
+		if(gg_sess->ggs_AckCount == 0)
+			gg_sess->ggs_AckTime = GGClock();
+
+		gg_sess->ggs_AckSeq[gg_sess->ggs_AckCount++] = seq;
+	}
+
+	LEAVE();
+	return result;
+}
+
+/****if* ggpackets.c/GGAckFlush()
+ *
+ *  NAME
+ *    GGAckFlush()
+ *
+ *  SYNOPSIS
+ *    BOOL GGAckFlush(struct GGSession *gg_sess, BOOL force)
+ *
+ *  FUNCTION
+ *    Funkcja tworzy pakiety potwierdze wiadomoci zapamitanych przez GGAcceptMessage().
+ *    Wszystkie trafiaj kolejno do jednego segmentu kolejki GGS_LANE_CONTROL, wic wysyane
+ *    s jednym zapisem. Bez force potwierdzenia tworzone s dopiero, gdy najstarsze z nich
+ *    czeka duej ni GGS_ACK_DEADLINE.
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajce za poczenie;
+ *    - force -- TRUE jeli potwierdzenia naley utworzy bez wzgldu na czas oczekiwania.
+ *
+ *  RESULT
+ *    - TRUE -- jeli nie zostay adne niewysane potwierdzenia;
+ *    - FALSE -- jeli potwierdzenia dalej czekaj (termin nie min lub zabrako pamici).
+ *
+ *****/
+
+BOOL GGAckFlush(struct GGSession *gg_sess, BOOL force)
+{
+	struct GGPacketBuilder pb;
+	struct GGPMsgAck *ack;
+	ULONG i;
+
+	if(gg_sess->ggs_AckCount == 0)
+		return TRUE;
+
+	if(!force && GGClock() - gg_sess->ggs_AckTime < GGS_ACK_DEADLINE)
+		return FALSE;
+
+	for(i = 0; i < gg_sess->ggs_AckCount; i++)
+	{
+		if(!(ack = GGPacketBeginFixed(gg_sess, &pb, GGP_TYPE_MSG_ACK, GGPMsgAck)))
+			break;
+
+		ack->ggpma_Seq = EndianFix32(gg_sess->ggs_AckSeq[i]);
+
+		if(!GGPacketCommit(&pb))
+			break;
+	}
+
+	/* jeli zabrako pamici, niewysane potwierdzenia zostaj na pniej */
+	if(i > 0 && i < gg_sess->ggs_AckCount)
+	{
+		ULONG j;
+
+		for(j = i; j < gg_sess->ggs_AckCount; j++)
+			gg_sess->ggs_AckSeq[j - i] = gg_sess->ggs_AckSeq[j];
+	}
+
+	gg_sess->ggs_AckCount -= i;
+
+	return (BOOL)(gg_sess->ggs_AckCount == 0);
+}
+
+/****if* ggpackets.c/GGReaderInit()
+ *
+ *  NAME
+ *    GGReaderInit()
+ *
+ *  SYNOPSIS
+ *    - static inline VOID GGReaderInit(struct GGPReader *r, struct GGPHeader *pac)
+ *    - static inline BOOL GGReaderNeed(struct GGPReader *r, ULONG len)
+ *    - static inline ULONG GGReaderULONG(struct GGPReader *r)
+ *    - static inline USHORT GGReaderUSHORT(struct GGPReader *r)
+ *    - static inline UBYTE GGReaderUBYTE(struct GGPReader *r)
+ *    - static inline UQUAD GGReaderUQUAD(struct GGPReader *r)
+ *    - static inline UBYTE *GGReaderBlock(struct GGPReader *r, ULONG len)
+ *    - static inline ULONG GGReaderLeft(struct GGPReader *r)
+ *    - struct name *GGReaderFixed(struct GGPReader *r, name)
+ *
+ *  FUNCTION
+ *    Funkcje odczytu odebranego pakietu. GGReaderInit() ustawia odczyt na pocztek danych
+ *    pakietu pac. GGReaderNeed() sprawdza czy w pakiecie zostao jeszcze len bajtw, po czym
+ *    pola rekordu mona pobra funkcjami GGReaderULONG(), GGReaderUSHORT(), GGReaderUBYTE()
+ *    i GGReaderUQUAD() (z konwersj z little endian, niezalenie od wyrwnania). GGReaderBlock()
+ *    sprawdza dugo i zwraca wskanik na blok len bajtw wewntrz pakietu (lub NULL).
+ *    GGReaderLeft() zwraca ilo nieodczytanych danych. Makro GGReaderFixed() pobiera blok
+ *    o dugoci struktury pakietu name, do zdekodowania przez GGPDecode#?().
+ *
+ *  NOTES
+ *    GGReaderULONG() i pokrewne nie sprawdzaj dugoci, musz by poprzedzone przez
+ *    GGReaderNeed() obejmujce cay odczytywany rekord.
+ *
+ *  SEE ALSO
+ *    GGPReader, LoadLE32()
+ *
+ *****/
+
+static inline VOID GGReaderInit(struct GGPReader *r, struct GGPHeader *pac)
+{
+	r->ggpr_Pos = (UBYTE*)(pac + 1);
+	r->ggpr_End = r->ggpr_Pos + pac->ggph_Length;
+	r->ggpr_Error = FALSE;
+}
+
+static inline BOOL GGReaderNeed(struct GGPReader *r, ULONG len)
+{
+	if(r->ggpr_Error || (ULONG)(r->ggpr_End - r->ggpr_Pos) < len)
+		r->ggpr_Error = TRUE;
+
+	return (BOOL)!r->ggpr_Error;
+}
+
+static inline ULONG GGReaderULONG(struct GGPReader *r)
+{
+	ULONG v = LoadLE32(r->ggpr_Pos);
+	r->ggpr_Pos += sizeof(ULONG);
+	return v;
+}
+
+static inline USHORT GGReaderUSHORT(struct GGPReader *r)
+{
+	USHORT v = LoadLE16(r->ggpr_Pos);
+	r->ggpr_Pos += sizeof(USHORT);
+	return v;
+}
+
+static inline UBYTE GGReaderUBYTE(struct GGPReader *r)
+{
+	return *r->ggpr_Pos++;
+}
+
+static inline UQUAD GGReaderUQUAD(struct GGPReader *r)
+{
+	UQUAD v = LoadLE64(r->ggpr_Pos);
+	r->ggpr_Pos += sizeof(UQUAD);
+	return v;
+}
+
+static inline UBYTE *GGReaderBlock(struct GGPReader *r, ULONG len)
+{
+	UBYTE *block = NULL;
+
+	if(GGReaderNeed(r, len))
+	{
+		block = r->ggpr_Pos;
+		r->ggpr_Pos += len;
+	}
+
+	return block;
+}
+
+static inline ULONG GGReaderLeft(struct GGPReader *r)
+{
+	return r->ggpr_Error ? 0 : (ULONG)(r->ggpr_End - r->ggpr_Pos);
+}
+
+#define GGReaderFixed(r, name)              ((struct name*)GGReaderBlock(r, sizeof(struct name)))
+
+/****if* ggpackets.c/GGPDecodeStatusChange()
+ *
+ *  NAME
+ *    GGPDecodeStatusChange()
+ *
+ *  SYNOPSIS
+ *    - static inline VOID GGPDecodeStatusChange(const UBYTE *src, struct GGPStatusChange *dst)
+ *    - static inline VOID GGPDecodeTypingNotify(const UBYTE *src, struct GGPTypingNotify *dst)
+ *    - static inline VOID GGPDecodeRecvMsg(const UBYTE *src, struct GGPRecvMsg *dst)
+ *
+ *  FUNCTION
+ *    Dekodery staej czci odebranych pakietw. Przepisuj pola rekordu src (wskanik
+ *    zwrcony przez GGReaderFixed()) do struktury dst w kolejnoci bajtw hosta. Pooenie
+ *    pl brane jest ze struktury pakietu, wic schemat (GGP_SIZE_#?), koder
+ *    (GGPacketBeginFixed()) i dekoder opisuje ta sama definicja.
+ *
+ *  NOTES
+ *    Dekodery nie sprawdzaj dugoci, rekord musi by pobrany przez GGReaderFixed().
+ *    Tablice o zmiennej dugoci (ggpsc_Description, ggprm_HtmlTxt) nie s kopiowane,
+ *    naley je czyta z rekordu src.
+ *
+ *  SEE ALSO
+ *    GGP_SIZE_#?, GGReaderInit(), LoadLE32()
+ *
+ *****/
+
+#define GGP_FIELD(src, name, field)         ((src) + offsetof(struct name, field))
+
+static inline VOID GGPDecodeStatusChange(const UBYTE *src, struct GGPStatusChange *dst)
+{
+	dst->ggpsc_Uin = LoadLE32(GGP_FIELD(src, GGPStatusChange, ggpsc_Uin));
+	dst->ggpsc_Status = LoadLE32(GGP_FIELD(src, GGPStatusChange, ggpsc_Status));
+	dst->ggpsc_Features = LoadLE32(GGP_FIELD(src, GGPStatusChange, ggpsc_Features));
+	dst->ggpsc_ImageSize = *GGP_FIELD(src, GGPStatusChange, ggpsc_ImageSize);
+	dst->ggpsc_Flags = LoadLE32(GGP_FIELD(src, GGPStatusChange, ggpsc_Flags));
+	dst->ggpsc_DescLen = LoadLE32(GGP_FIELD(src, GGPStatusChange, ggpsc_DescLen));
+}
+
+static inline VOID GGPDecodeTypingNotify(const UBYTE *src, struct GGPTypingNotify *dst)
+{
+	dst->ggptn_Type = LoadLE16(GGP_FIELD(src, GGPTypingNotify, ggptn_Type));
+	dst->ggptn_Uin = LoadLE32(GGP_FIELD(src, GGPTypingNotify, ggptn_Uin));
+}
+
+static inline VOID GGPDecodeRecvMsg(const UBYTE *src, struct GGPRecvMsg *dst)
+{
+	dst->ggprm_Uin = LoadLE32(GGP_FIELD(src, GGPRecvMsg, ggprm_Uin));
+	dst->ggprm_Seq = LoadLE32(GGP_FIELD(src, GGPRecvMsg, ggprm_Seq));
+	dst->ggprm_Time = LoadLE32(GGP_FIELD(src, GGPRecvMsg, ggprm_Time));
+	dst->ggprm_Class = LoadLE32(GGP_FIELD(src, GGPRecvMsg, ggprm_Class));
+	dst->ggprm_OffsetPlain = LoadLE32(GGP_FIELD(src, GGPRecvMsg, ggprm_OffsetPlain));
+	dst->ggprm_OffsetAttrs = LoadLE32(GGP_FIELD(src, GGPRecvMsg, ggprm_OffsetAttrs));
+}
+
+/****if* ggpackets.c/GGPacketHandlerWelcome()
+ *
+ *  NAME
+ *    GGPacketHandlerWelcome()
+ *
+ *  SYNOPSIS
+ *    static VOID GGPacketHandlerWelcome(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac)
+ *
+ *  FUNCTION
+ *    Funkcja obsuguje pakiet typu GGP_TYPE_WELCOME, odsya pakiet logowania i odpowiednio wypenia struktur zdarzenia.
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajce za poczenie;
+ *    - event -- wskanik na struktur zdarzenia, ktr handler ma wypeni;
+ *    - pac -- wskanik na struktur GGPHeader, po ktrej bezporednio w pamici znajduje si struct GGPWelcome.
+ *
+ *****/
+
+static VOID GGPacketHandlerWelcome(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac)
+{
+	ENTER();
+	if(pac->ggph_Length == sizeof(struct GGPWelcome))
+	{
+		struct GGPWelcome *gw = (struct GGPWelcome*)(pac + 1);
+		UBYTE hash[64];
+		LONG buffer_len; /* wielko bufora potrzebnego na przechowanie pakietu */
+		BYTE *login_packet = NULL;
+
+		MemSet(hash, 0, sizeof(hash));
+
+		GGSha1Hash(gg_sess->ggs_Pass, gw->ggpw_Key, hash);	/* obliczamy hash hasa */
+
+		login_packet = GGPacketCreateTags(GGP_TYPE_GGLOGIN, &buffer_len,
+			GGA_CreatePacket_ULONG, gg_sess->ggs_Uin,
+			GGA_CreatePacket_STRPTR, (ULONG)"pl",
+			GGA_CreatePacket_BYTE, 0x02, /* rodzaj hashu - sha1 */
+			GGA_CreatePacket_SHA1, (ULONG)hash,
+			GGA_CreatePacket_ULONG, gg_sess->ggs_Status,
+			GGA_CreatePacket_ULONG, GGLIB_STATUS_FLAGS,
+			GGA_CreatePacket_ULONG, GGLIB_FEATURES,
+			GGA_CreatePacket_ZEROIZE, 12,
+			GGA_CreatePacket_UBYTE, gg_sess->ggs_ImageSize,
+			GGA_CreatePacket_BYTE, 0x64,
+			GGA_CreatePacket_ULONG, StrLen(GGLIB_DEFAULT_CLIENT_NAME GGLIB_DEFAULT_CLIENT_VERSION),
+			GGA_CreatePacket_STRPTR, (ULONG)(GGLIB_DEFAULT_CLIENT_NAME GGLIB_DEFAULT_CLIENT_VERSION),
+			GGA_CreatePacket_ULONG, gg_sess->ggs_StatusDescription ? StrLen(gg_sess->ggs_StatusDescription) : 0,
+			GGA_CreatePacket_STRPTR, (ULONG)gg_sess->ggs_StatusDescription,
+		TAG_END);
+
+		if(login_packet)
+		{
+			if((GGAddToWriteBuffer(gg_sess, login_packet, buffer_len)))
+			{
+				event->gge_Type = GGE_TYPE_NOOP;
+			}
+			else
+			{
+				GG_SESSION_ERROR(gg_sess, GGS_ERRNO_MEM);
+			}
+		}
+	}
+	LEAVE();
+}
+
+/****if* ggpackets.c/GGPacketHandlerLogin()
+ *
+ *  NAME
+ *    GGPacketHandlerLogin()
+ *
+ *  SYNOPSIS
+ *    static VOID GGPacketHandlerLogin(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac)
+ *
+ *  FUNCTION
+ *    Funkcja obsuguje pakiety: GGP_TYPE_LOGINOK, GGP_TYPE_LOGINFAIL i GGP_TYPE_LOGINFAIL2 generujc odpowiednie zdarzenie
+ *    (GGE_TYPE_LOGIN_SUCCESS lub GGE_TYPE_LOGIN_FAIL).
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajce za poczenie;
+ *    - event -- wskanik na struktur zdarzenia, ktr handler ma wypeni;
+ *    - pac -- wskanik na struktur GGPHeader, po ktrej bezporednio w pamici znajduje si GGPWelcome.
+ *
+ *  SEE ALSO
+ *    GGE_TYPE_#?
+ *
+ *****/
+
+static VOID GGPacketHandlerLogin(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac)
+{
+	ENTER();
+
+	if(pac->ggph_Type == GGP_TYPE_LOGIN_OK)
+	{
+		event->gge_Type = GGE_TYPE_LOGIN_SUCCESS;
+	}
+	else if(pac->ggph_Type == GGP_TYPE_LOGIN_FAIL || pac->ggph_Type == GGP_TYPE_LOGIN_FAIL2)
+	{
+		event->gge_Type = GGE_TYPE_LOGIN_FAIL;
+	}
+
+	LEAVE();
+}
+
+/* sprawdza czy opisy zwracane przez GGPacketDescription() pochodz z puli ggs_Descriptions */
+static inline BOOL GGDescriptionInterned(struct GGSession *gg_sess)
+{
+	return (BOOL)(!gg_sess->ggs_ZeroCopy || gg_sess->ggs_RecvBlock == NULL);
+}
+
+/****if* ggpackets.c/GGPacketDescription()
+ *
+ *  NAME
+ *    GGPacketDescription()
+ *
+ *  SYNOPSIS
+ *    static STRPTR GGPacketDescription(struct GGSession *gg_sess, struct GGEvent *event, UBYTE *desc, ULONG desc_len)
+ *
+ *  FUNCTION
+ *    Funkcja zwraca opis statusu z pakietu. W trybie GGA_CreateSession_ZeroCopy opis nie jest
+ *    kopiowany - zostaje przesunity o bajt wstecz (na ju odczytane pole ggpsc_DescLen),
+ *    zakoczony zerem w miejscu pakietu, a zdarzenie zatrzymuje blok bufora odbiorczego.
+ *    W przeciwnym wypadku opis pobierany jest ze wsplnej puli opisw sesji (ggs_Descriptions),
+ *    tak e ten sam opis wielu kontaktw zajmuje pami tylko raz.
+ *
+ *  INPUTS
+ *    - gg_sess -- wskanik na struktur GGSession odpowiadajce za poczenie;
+ *    - event -- wskanik na struktur zdarzenia, do ktrego naley opis;
+ *    - desc -- wskanik na opis wewntrz pakietu (pobrany przez GGReaderBlock()), zaraz
+ *      za polem ggpsc_DescLen wpisu zmiany statusu;
+ *    - desc_len -- dugo opisu.
+ *
+ *  RESULT
+ *    Wskanik na opis lub NULL jeli opisu nie ma. Opis z puli zwalnia GGFreeEventData().
+ *
+ *****/
+
+static STRPTR GGPacketDescription(struct GGSession *gg_sess, struct GGEvent *event, UBYTE *desc, ULONG desc_len)
+{
+	STRPTR result;
+	ULONG i;
+
+	if(desc == NULL || desc_len == 0)
+		return NULL;
+
+	if(GGDescriptionInterned(gg_sess))
+		return InternStrLen(gg_sess->ggs_Descriptions, (STRPTR)desc, desc_len);
+
+	result = (STRPTR)desc - 1;
+
+	/* przesunicie o bajt w d, kopiowanie od pocztku jest bezpieczne */
+	for(i = 0; i < desc_len; i++)
+		result[i] = desc[i];
+
+	result[desc_len] = 0x00;
+
+	if(event->gge_Packet == NULL)
 	{
-		if(GGAddToWriteBuffer(gg_sess, pac, len))
-			result = TRUE;
-		else
-			FreeVec(pac);
+		event->gge_Packet = gg_sess->ggs_RecvBlock;
+		gg_sess->ggs_RecvBlock->ggrb_Refs++;
 	}
-	LEAVE();
+
 	return result;
 }
 
-/****if* ggpackets.c/GGPacketHandlerWelcome()
+/****if* ggpackets.c/GGRosterUpdate()
  *
  *  NAME
- *    GGPacketHandlerWelcome()
+ *    GGRosterUpdate()
  *
  *  SYNOPSIS
- *    static VOID GGPacketHandlerWelcome(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac)
+ *    static BOOL GGRosterUpdate(struct GGSession *gg_sess, ULONG uin, ULONG status, UBYTE image_size, STRPTR desc)
  *
  *  FUNCTION
- *    Funkcja obsuguje pakiet typu GGP_TYPE_WELCOME, odsya pakiet logowania i odpowiednio wypenia struktur zdarzenia.
+ *    Funkcja zapisuje w tablicy ggs_Roster nowy status kontaktu i sprawdza, czy rni si on
+ *    od poprzednio znanego. Opis przechowywany jest w puli ggs_Descriptions, wic jego
+ *    porwnanie sprowadza si do porwnania wskanikw.
  *
  *  INPUTS
- *    - gg_sess -- wskanik na struktur GGSession odpowiadajce za poczenie;
- *    - event -- wskanik na struktur zdarzenia, ktr handler ma wypeni;
- *    - pac -- wskanik na struktur GGPHeader, po ktrej bezporednio w pamici znajduje si struct GGPWelcome.
+ *    - gg_sess -- wskanik na struktur GGSession z wczon tablic statusw;
+ *    - uin -- numer GG kontaktu;
+ *    - status -- nowy status;
+ *    - image_size -- maksymalny rozmiar odbieranych przez kontakt obrazkw;
+ *    - desc -- opis zwrcony przez GGPacketDescription() lub NULL.
+ *
+ *  RESULT
+ *    - TRUE -- jeli status si zmieni (lub nie by znany);
+ *    - FALSE -- jeli serwer powtrzy poprzedni status.
  *
  *****/
 
-static VOID GGPacketHandlerWelcome(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac)
+static BOOL GGRosterUpdate(struct GGSession *gg_sess, ULONG uin, ULONG status, UBYTE image_size, STRPTR desc)
 {
-	ENTER();
-	if(pac->ggph_Length == sizeof(struct GGPWelcome))
-	{
-		struct GGPWelcome *gw = (struct GGPWelcome*)(pac + 1);
-		UBYTE hash[64];
-		LONG buffer_len; /* wielko bufora potrzebnego na przechowanie pakietu */
-		BYTE *login_packet = NULL;
+	struct GGPresence **list = &gg_sess->ggs_Roster[GGS_ROSTER_HASH(uin)];
+	struct GGPresence *p;
+	STRPTR interned = NULL;
 
-		MemSet(hash, 0, sizeof(hash));
+	if(desc)
+	{
+		if(GGDescriptionInterned(gg_sess))
+			interned = InternRetain(desc);
+		else if(!(interned = InternStrLen(gg_sess->ggs_Descriptions, desc, StrLen(desc))))
+			return TRUE;
+	}
 
-		GGSha1Hash(gg_sess->ggs_Pass, gw->ggpw_Key, hash);	/* obliczamy hash hasa */
+	for(p = *list; p; p = p->ggpe_Next)
+	{
+		if(p->ggpe_Uin == uin)
+			break;
+	}
 
-		login_packet = GGPacketCreateTags(GGP_TYPE_GGLOGIN, &buffer_len,
-			GGA_CreatePacket_ULONG, gg_sess->ggs_Uin,
-			GGA_CreatePacket_STRPTR, (ULONG)"pl",
-			GGA_CreatePacket_BYTE, 0x02, /* rodzaj hashu - sha1 */
-			GGA_CreatePacket_SHA1, (ULONG)hash,
-			GGA_CreatePacket_ULONG, gg_sess->ggs_Status,
-			GGA_CreatePacket_ULONG, GGLIB_STATUS_FLAGS,
-			GGA_CreatePacket_ULONG, GGLIB_FEATURES,
-			GGA_CreatePacket_ZEROIZE, 12,
-			GGA_CreatePacket_UBYTE, gg_sess->ggs_ImageSize,
-			GGA_CreatePacket_BYTE, 0x64,
-			GGA_CreatePacket_ULONG, StrLen(GGLIB_DEFAULT_CLIENT_NAME GGLIB_DEFAULT_CLIENT_VERSION),
-			GGA_CreatePacket_STRPTR, (ULONG)(GGLIB_DEFAULT_CLIENT_NAME GGLIB_DEFAULT_CLIENT_VERSION),
-			GGA_CreatePacket_ULONG, gg_sess->ggs_StatusDescription ? StrLen(gg_sess->ggs_StatusDescription) : 0,
-			GGA_CreatePacket_STRPTR, (ULONG)gg_sess->ggs_StatusDescription,
-		TAG_END);
+	if(p)
+	{
+		if(p->ggpe_Status == status && p->ggpe_ImageSize == image_size && p->ggpe_Description == interned)
+		{
+			InternRelease(interned);
+			return FALSE;
+		}
 
-		if(login_packet)
+		InternRelease(p->ggpe_Description);
+	}
+	else
+	{
+		/* bez pamici na wpis zmiana jest po prostu przekazywana dalej */
+		if(!(p = AllocVec(sizeof(struct GGPresence), MEMF_ANY)))
 		{
-			if((GGAddToWriteBuffer(gg_sess, login_packet, buffer_len)))
-			{
-				event->gge_Type = GGE_TYPE_NOOP;
-			}
-			else
-			{
-				GG_SESSION_ERROR(gg_sess, GGS_ERRNO_MEM);
-			}
+			InternRelease(interned);
+			return TRUE;
 		}
+
+		p->ggpe_Uin = uin;
+		p->ggpe_Next = *list;
+		*list = p;
 	}
-	LEAVE();
+
+	p->ggpe_Status = status;
+	p->ggpe_ImageSize = image_size;
+	p->ggpe_Description = interned;
+
+	return TRUE;
 }
 
-/****if* ggpackets.c/GGPacketHandlerLogin()
+/****if* ggpackets.c/GGRosterRemove()
  *
  *  NAME
- *    GGPacketHandlerLogin()
+ *    GGRosterRemove()
  *
  *  SYNOPSIS
- *    static VOID GGPacketHandlerLogin(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac)
+ *    VOID GGRosterRemove(struct GGSession *gg_sess, ULONG uin)
  *
  *  FUNCTION
- *    Funkcja obsuguje pakiety: GGP_TYPE_LOGINOK, GGP_TYPE_LOGINFAIL i GGP_TYPE_LOGINFAIL2 generujc odpowiednie zdarzenie
- *    (GGE_TYPE_LOGIN_SUCCESS lub GGE_TYPE_LOGIN_FAIL).
+ *    Funkcja usuwa kontakt z tablicy statusw sesji (ggs_Roster), jeli w niej jest.
  *
  *  INPUTS
- *    - gg_sess -- wskanik na struktur GGSession odpowiadajce za poczenie;
- *    - event -- wskanik na struktur zdarzenia, ktr handler ma wypeni;
- *    - pac -- wskanik na struktur GGPHeader, po ktrej bezporednio w pamici znajduje si GGPWelcome.
- *
- *  SEE ALSO
- *    GGE_TYPE_#?
+ *    - gg_sess -- wskanik na struktur GGSession z wczon tablic statusw;
+ *    - uin -- numer GG kontaktu.
  *
  *****/
 
-static VOID GGPacketHandlerLogin(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac)
+VOID GGRosterRemove(struct GGSession *gg_sess, ULONG uin)
 {
-	ENTER();
+	struct GGPresence **link = &gg_sess->ggs_Roster[GGS_ROSTER_HASH(uin)];
 
-	if(pac->ggph_Type == GGP_TYPE_LOGIN_OK)
-	{
-		event->gge_Type = GGE_TYPE_LOGIN_SUCCESS;
-	}
-	else if(pac->ggph_Type == GGP_TYPE_LOGIN_FAIL || pac->ggph_Type == GGP_TYPE_LOGIN_FAIL2)
+	while(*link)
 	{
-		event->gge_Type = GGE_TYPE_LOGIN_FAIL;
-	}
+		struct GGPresence *p = *link;
 
-	LEAVE();
+		if(p->ggpe_Uin == uin)
+		{
+			*link = p->ggpe_Next;
+			InternRelease(p->ggpe_Description);
+			FreeVec(p);
+			break;
+		}
+
+		link = &p->ggpe_Next;
+	}
 }
 
 /****if* ggpackets.c/GGPacketHandlerStatusChange()
@@ -652,6 +1961,7 @@ static VOID GGPacketHandlerLogin(struct GGSession *gg_sess, struct GGEvent *even
  *
  *  FUNCTION
  *    Funkcja obsuguje pakiet GGP_TYPE_STATUS_CHANGE generujc odpowiednie zdarzenie (GGE_TYPE_STATUS_CHANGE).
+ *    Jeli sesja przechowuje statusy kontaktw, a status si nie zmieni, zdarzenie jest puste.
  *
  *  INPUTS
  *    - gg_sess -- wskanik na struktur GGSession odpowiadajce za poczenie;
@@ -665,19 +1975,33 @@ static VOID GGPacketHandlerLogin(struct GGSession *gg_sess, struct GGEvent *even
 
 static VOID GGPacketHandlerStatusChange(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac)
 {
-	struct GGPStatusChange *sch = (struct GGPStatusChange*)(pac + 1);
-	ULONG desc_len = EndianFix32(sch->ggpsc_DescLen);
+	struct GGPReader r;
+	struct GGPStatusChange *sch, dec;
 	ENTER();
 
-	event->gge_Type = GGE_TYPE_STATUS_CHANGE;
-	event->gge_Event.gge_StatusChange.ggesc_Uin = EndianFix32(sch->ggpsc_Uin);
-	event->gge_Event.gge_StatusChange.ggesc_Status = EndianFix32(sch->ggpsc_Status);
-	event->gge_Event.gge_StatusChange.ggesc_ImageSize = sch->ggpsc_ImageSize;
+	GGReaderInit(&r, pac);
 
-	if(desc_len > 0)
-		event->gge_Event.gge_StatusChange.ggesc_Description = StrNewLen(&sch->ggpsc_Description[0], desc_len);
-	else
-		event->gge_Event.gge_StatusChange.ggesc_Description = NULL;
+	if((sch = GGReaderFixed(&r, GGPStatusChange)))
+	{
+		struct GGEventStatusChange *sc = &event->gge_Event.gge_StatusChange;
+
+		GGPDecodeStatusChange((UBYTE*)sch, &dec);
+
+		sc->ggesc_Uin = dec.ggpsc_Uin;
+		sc->ggesc_Status = dec.ggpsc_Status;
+		sc->ggesc_ImageSize = dec.ggpsc_ImageSize;
+		sc->ggesc_Description = GGPacketDescription(gg_sess, event, GGReaderBlock(&r, dec.ggpsc_DescLen), dec.ggpsc_DescLen);
+
+		if(gg_sess->ggs_Roster && !GGRosterUpdate(gg_sess, sc->ggesc_Uin, sc->ggesc_Status, sc->ggesc_ImageSize, sc->ggesc_Description))
+		{
+			if(GGDescriptionInterned(gg_sess))
+				InternRelease(sc->ggesc_Description);
+			sc->ggesc_Description = NULL;
+			event->gge_Type = GGE_TYPE_NOOP;
+		}
+		else
+			event->gge_Type = GGE_TYPE_STATUS_CHANGE;
+	}
 
 	LEAVE();
 }
@@ -692,6 +2016,9 @@ static VOID GGPacketHandlerStatusChange(struct GGSession *gg_sess, struct GGEven
  *
  *  FUNCTION
  *    Funkcja obsuguje pakiet GGP_TYPE_LIST_STATUS generujc odpowiednie zdarzenie (GGE_TYPE_LIST_STATUS).
+ *    Pakiet dekodowany jest w jednym przejciu do rwnolegych tablic GGEventListStatus, ktre
+ *    zajmuj jedn alokacj w arenie zdarzenia. Opisy pobierane s przez GGPacketDescription().
+ *    Jeli sesja przechowuje statusy kontaktw, do zdarzenia trafiaj tylko rzeczywiste zmiany.
  *
  *  INPUTS
  *    - gg_sess -- wskanik na struktur GGSession odpowiadajce za poczenie;
@@ -705,68 +2032,67 @@ static VOID GGPacketHandlerStatusChange(struct GGSession *gg_sess, struct GGEven
 
 static VOID GGPacketHandlerListStatus(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac)
 {
+	struct GGEventListStatus *ls = &event->gge_Event.gge_ListStatus;
+	ULONG max_no = pac->ggph_Length / sizeof(struct GGPStatusChange);
+	struct GGPReader r;
+	struct GGPStatusChange *sc, dec;
+	UBYTE *block;
+	LONG no = 0;
 	ENTER();
-	struct GGPStatusChange *sc = (struct GGPStatusChange*)(pac+1);
-	struct GGPStatusChange *temp = sc;
-	LONG act_len = pac->ggph_Length;
-	LONG entries_no = 0;
 
-	while(act_len >= sizeof(struct GGPStatusChange))
+	if(max_no == 0)
 	{
-		ULONG desc_len = EndianFix32(temp->ggpsc_DescLen);
-
-		entries_no++;
-
-		temp++;
-		act_len -= sizeof(struct GGPStatusChange);
-		temp = (struct GGPStatusChange*)(((UBYTE*)temp) + desc_len);
-		act_len -= desc_len;
+		event->gge_Type = GGE_TYPE_NOOP;
+		LEAVE();
+		return;
 	}
 
-	if(entries_no > 0)
+	/* jedna alokacja na tablice dla maksymalnej iloci wpisw, jakie mog zmieci si w pakiecie */
+	if(!(block = ArenaAlloc(&event->gge_Arena, max_no * (sizeof(STRPTR) + 2 * sizeof(ULONG) + sizeof(UBYTE)))))
 	{
-		if((event->gge_Event.gge_ListStatus.ggels_StatusChanges = AllocVec(sizeof(struct GGEventStatusChange) * entries_no, MEMF_ANY | MEMF_CLEAR)))
-		{
-			event->gge_Type = GGE_TYPE_LIST_STATUS;
-			event->gge_Event.gge_ListStatus.ggels_ChangesNo = entries_no;
+		GG_SESSION_ERROR(gg_sess, GGS_ERRNO_MEM);
+		LEAVE();
+		return;
+	}
 
-			entries_no = 0;
-			act_len = pac->ggph_Length;
-			temp = sc;
+	ls->ggels_Descriptions = (STRPTR*)block;
+	ls->ggels_Uins = (ULONG*)(ls->ggels_Descriptions + max_no);
+	ls->ggels_Statuses = ls->ggels_Uins + max_no;
+	ls->ggels_ImageSizes = (UBYTE*)(ls->ggels_Statuses + max_no);
 
-			while(act_len >= sizeof(struct GGPStatusChange))
-			{
-				ULONG desc_len = EndianFix32(temp->ggpsc_DescLen);
+	/* jedno przejcie po pakiecie, koczymy na pierwszym wpisie wychodzcym poza pakiet */
+	GGReaderInit(&r, pac);
 
-				event->gge_Event.gge_ListStatus.ggels_StatusChanges[entries_no].ggesc_Uin = EndianFix32(temp->ggpsc_Uin);
-				event->gge_Event.gge_ListStatus.ggels_StatusChanges[entries_no].ggesc_Status = EndianFix32(temp->ggpsc_Status);
-				event->gge_Event.gge_ListStatus.ggels_StatusChanges[entries_no].ggesc_ImageSize = temp->ggpsc_ImageSize;
+	while((sc = GGReaderFixed(&r, GGPStatusChange)))
+	{
+		STRPTR desc;
+		UBYTE *data;
 
-				if(desc_len > 0)
-				{
-					event->gge_Event.gge_ListStatus.ggels_StatusChanges[entries_no].ggesc_Description = StrNewLen(temp->ggpsc_Description, desc_len);
-				}
-				else
-				{
-					event->gge_Event.gge_ListStatus.ggels_StatusChanges[entries_no].ggesc_Description = NULL;
-				}
+		GGPDecodeStatusChange((UBYTE*)sc, &dec);
 
-				entries_no++;
-				temp++;
-				act_len -= sizeof(struct GGPStatusChange);
-				temp = (struct GGPStatusChange*) (((UBYTE*)temp) + desc_len);
-				act_len -= desc_len;
-			}
-		}
-		else
+		if(!(data = GGReaderBlock(&r, dec.ggpsc_DescLen)))
+			break;
+
+		desc = GGPacketDescription(gg_sess, event, data, dec.ggpsc_DescLen);
+
+		/* status powtrzony przez serwer (np. po ponownym poczeniu) pomijamy */
+		if(gg_sess->ggs_Roster && !GGRosterUpdate(gg_sess, dec.ggpsc_Uin, dec.ggpsc_Status, dec.ggpsc_ImageSize, desc))
 		{
-			GG_SESSION_ERROR(gg_sess, GGS_ERRNO_MEM);
+			if(GGDescriptionInterned(gg_sess))
+				InternRelease(desc);
+			continue;
 		}
+
+		ls->ggels_Uins[no] = dec.ggpsc_Uin;
+		ls->ggels_Statuses[no] = dec.ggpsc_Status;
+		ls->ggels_ImageSizes[no] = dec.ggpsc_ImageSize;
+		ls->ggels_Descriptions[no] = desc;
+
+		no++;
 	}
-	else
-	{
-		event->gge_Type = GGE_TYPE_NOOP;
-	}
+
+	ls->ggels_ChangesNo = no;
+	event->gge_Type = no > 0 ? GGE_TYPE_LIST_STATUS : GGE_TYPE_NOOP;
 
 	LEAVE();
 }
@@ -794,12 +2120,20 @@ static VOID GGPacketHandlerListStatus(struct GGSession *gg_sess, struct GGEvent
 
 static VOID GGPacketHandlerTypingNotify(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac)
 {
-	struct GGPTypingNotify *n = (struct GGPTypingNotify*)(pac+1);
+	struct GGPReader r;
+	struct GGPTypingNotify *tn, dec;
 	ENTER();
 
-	event->gge_Type = GGE_TYPE_TYPING_NOTIFY;
-	event->gge_Event.gge_TypingNotify.ggetn_Uin = EndianFix32(n->ggptn_Uin);
-	event->gge_Event.gge_TypingNotify.ggetn_Length = EndianFix16(n->ggptn_Type);
+	GGReaderInit(&r, pac);
+
+	if((tn = GGReaderFixed(&r, GGPTypingNotify)))
+	{
+		GGPDecodeTypingNotify((UBYTE*)tn, &dec);
+
+		event->gge_Type = GGE_TYPE_TYPING_NOTIFY;
+		event->gge_Event.gge_TypingNotify.ggetn_Length = dec.ggptn_Type;
+		event->gge_Event.gge_TypingNotify.ggetn_Uin = dec.ggptn_Uin;
+	}
 	LEAVE();
 }
 
@@ -813,6 +2147,9 @@ static VOID GGPacketHandlerTypingNotify(struct GGSession *gg_sess, struct GGEven
  *
  *  FUNCTION
  *    Funkcja obsuguje pakiet GGP_TYPE_RECV_MSG generujc odpowiednie zdarzenie (GGE_TYPE_RECV_MSG).
+ *    Tre wiadomoci nie jest konwertowana - zdarzenie pokazuje na HTML i blok atrybutw
+ *    wewntrz pakietu i zatrzymuje blok bufora odbiorczego. Czysty tekst i identyfikatory
+ *    obrazkw tworzone s dopiero przez GGGetMessageText() i GGGetMessageImages().
  *
  *  INPUTS
  *    - gg_sess -- wskanik na struktur GGSession odpowiadajce za poczenie;
@@ -820,77 +2157,128 @@ static VOID GGPacketHandlerTypingNotify(struct GGSession *gg_sess, struct GGEven
  *    - pac -- wskanik na struktur GGPHeader, po ktrej bezporednio w pamici znajduje si tablica GGPStatusChange.
  *
  *  SEE ALSO
- *    GGE_TYPE_#?, GGEventRecvMsg, GGEventImageData, GGPRecvMsg
+ *    GGE_TYPE_#?, GGEventRecvMsg, GGEventImageData, GGPRecvMsg, GGGetMessageText()
  *
  *****/
 
 static VOID GGPacketHandlerRecvMsg(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac)
 {
-	struct GGPRecvMsg *ms = (struct GGPRecvMsg*)(pac + 1);
+	struct GGPReader r;
+	struct GGPRecvMsg *ms, dec;
 	ENTER();
 
-	if(GGAcceptMessage(gg_sess, EndianFix32(ms->ggprm_Seq)))
+	GGReaderInit(&r, pac);
+
+	if(!(ms = GGReaderFixed(&r, GGPRecvMsg)))
 	{
-		STRPTR image;
+		LEAVE();
+		return;
+	}
+
+	GGPDecodeRecvMsg((UBYTE*)ms, &dec);
 
-		if((event->gge_Event.gge_RecvMsg.ggerm_Txt = GGMessageHTMLtoText(ms->ggprm_HtmlTxt, &image)) || image)
+	if(GGAcceptMessage(gg_sess, dec.ggprm_Seq))
+	{
+		if(ms->ggprm_HtmlTxt[0] != 0x00)
 		{
+			struct GGEventRecvMsg *rm = &event->gge_Event.gge_RecvMsg;
+			ULONG left = GGReaderLeft(&r), html_len, attrs;
+
+			/* HTML musi koczy si zerem wewntrz pakietu, bo zero dopisane przez
+			 * GGReceivePacket() zostanie nadpisane przy odbiorze nastpnego pakietu */
+			for(html_len = 0; html_len < left && ms->ggprm_HtmlTxt[html_len] != 0x00; html_len++);
+
+			if(html_len == left)
+			{
+				tprintf("Message from %lu without terminated HTML, ignoring!\n", dec.ggprm_Uin);
+				LEAVE();
+				return;
+			}
+
+			attrs = dec.ggprm_OffsetAttrs;
+
 			event->gge_Type = GGE_TYPE_RECV_MSG;
-			event->gge_Event.gge_RecvMsg.ggerm_Uin = EndianFix32(ms->ggprm_Uin);
-			event->gge_Event.gge_RecvMsg.ggerm_Time = EndianFix32(ms->ggprm_Time);
-			event->gge_Event.gge_RecvMsg.ggerm_ImagesIds = image;
-			event->gge_Event.gge_RecvMsg.ggerm_Flags = pac->ggph_Type == GGP_TYPE_RECV_OWN_MSG ? GG_MSG_OWN : GG_MSG_NORMAL;
+			rm->ggerm_Uin = dec.ggprm_Uin;
+			rm->ggerm_Time = dec.ggprm_Time;
+			rm->ggerm_Flags = pac->ggph_Type == GGP_TYPE_RECV_OWN_MSG ? GG_MSG_OWN : GG_MSG_NORMAL;
+			rm->ggerm_Html = (STRPTR)ms->ggprm_HtmlTxt;
+			rm->ggerm_HtmlLength = html_len;
+
+			/* atrybuty le za HTML-em i czystym tekstem, a do koca pakietu */
+			if(attrs > html_len + sizeof(struct GGPRecvMsg) && attrs < pac->ggph_Length)
+			{
+				rm->ggerm_Attrs = (UBYTE*)(pac + 1) + attrs;
+				rm->ggerm_AttrsLength = pac->ggph_Length - attrs;
+			}
+			else
+			{
+				rm->ggerm_Attrs = NULL;
+				rm->ggerm_AttrsLength = 0;
+			}
+
+			rm->ggerm_Txt = NULL;
+			rm->ggerm_ImagesIds = NULL;
+			rm->ggerm_Converted = FALSE;
+
+			if(event->gge_Packet == NULL)
+			{
+				event->gge_Packet = gg_sess->ggs_RecvBlock;
+				gg_sess->ggs_RecvBlock->ggrb_Refs++;
+			}
 		}
-		else if(pac->ggph_Length > sizeof(struct GGPRecvMsg) + 1) /* mamy do czynienia z wiadomoci zawierajc dane obrazka */
+		else if(GGReaderNeed(&r, 2 + 2 * sizeof(ULONG))) /* mamy do czynienia z wiadomoci zawierajc dane obrazka */
 		{
-			BYTE *image_data = ((BYTE*)(ms + 1)) + 1; /* omijamy ca struktur GGPRecvMsg oraz bajt 0x00 oznaczajcy pust wiadomo */
-			BYTE flag = *image_data;
+			UBYTE flag;
 
-			image_data++;
+			r.ggpr_Pos++; /* omijamy bajt 0x00 oznaczajcy pust wiadomo */
+			flag = GGReaderUBYTE(&r);
 
 			if(flag == 0x04) /* kto da od nas obrazka */
 			{
 				event->gge_Type = GGE_TYPE_IMAGE_REQUEST;
 
-				event->gge_Event.gge_ImageRequest.ggeir_Uin = EndianFix32(ms->ggprm_Uin);
-
-				event->gge_Event.gge_ImageRequest.ggeir_ImageSize = EndianFix32(*((ULONG*)image_data));
-				image_data += sizeof(ULONG);
-
-				event->gge_Event.gge_ImageRequest.ggeir_Crc32 = EndianFix32(*((ULONG*)image_data));
+				event->gge_Event.gge_ImageRequest.ggeir_Uin = dec.ggprm_Uin;
+				event->gge_Event.gge_ImageRequest.ggeir_ImageSize = GGReaderULONG(&r);
+				event->gge_Event.gge_ImageRequest.ggeir_Crc32 = GGReaderULONG(&r);
 			}
 			else /* otrzymalimy dany obrazek */
 			{
 				event->gge_Type = GGE_TYPE_IMAGE_DATA;
 
-				event->gge_Event.gge_ImageData.ggeid_Uin = EndianFix32(ms->ggprm_Uin);
-
-				event->gge_Event.gge_ImageData.ggeid_ImageSize = EndianFix32(*((ULONG*)image_data));
-				image_data += sizeof(ULONG);
-
-				event->gge_Event.gge_ImageData.ggeid_Crc32 = EndianFix32(*((ULONG*)image_data));
-				image_data += sizeof(ULONG);
+				event->gge_Event.gge_ImageData.ggeid_Uin = dec.ggprm_Uin;
+				event->gge_Event.gge_ImageData.ggeid_ImageSize = GGReaderULONG(&r);
+				event->gge_Event.gge_ImageData.ggeid_Crc32 = GGReaderULONG(&r);
 
 				if(flag == 0x05) /* pierwsza porcja danych obrazka */
 				{
-					ULONG name_len = StrLen(image_data);
+					/* pakiet jest zakoczony zerem przez GGReceivePacket(), wic StrLen() nie wyjdzie poza bufor */
+					ULONG name_len = StrLen((STRPTR)r.ggpr_Pos);
 
 					event->gge_Event.gge_ImageData.ggeid_Type = GG_IMAGE_START_DATA;
 
-					event->gge_Event.gge_ImageData.ggeid_FileName = StrNewLen(image_data, name_len);
+					event->gge_Event.gge_ImageData.ggeid_FileName = StrNewLen((STRPTR)r.ggpr_Pos, name_len);
 
-					image_data += name_len + 1;
+					GGReaderBlock(&r, name_len + 1);
 				}
 				else if(flag == 0x06) /* dalsza cz obrazka, brak nazwy pliku */
 				{
 					event->gge_Event.gge_ImageData.ggeid_Type = GG_IMAGE_NEXT_DATA;
 				}
 
-				event->gge_Event.gge_ImageData.ggeid_DataSize = ((BYTE*)pac) + pac->ggph_Length - image_data + sizeof(struct GGPHeader);
+				event->gge_Event.gge_ImageData.ggeid_DataSize = GGReaderLeft(&r);
+
+				if(r.ggpr_Error)
+				{
+					/* nazwa pliku wychodzi poza pakiet, ignorujemy uszkodzony pakiet */
+					if(event->gge_Event.gge_ImageData.ggeid_FileName)
+						StrFree(event->gge_Event.gge_ImageData.ggeid_FileName);
 
-				if((event->gge_Event.gge_ImageData.ggeid_Data = AllocMem(event->gge_Event.gge_ImageData.ggeid_DataSize, MEMF_ANY)))
+					event->gge_Event.gge_ImageData.ggeid_FileName = NULL;
+					event->gge_Type = GGE_TYPE_NOOP;
+				}
+				else if((event->gge_Event.gge_ImageData.ggeid_Data = AllocMem(event->gge_Event.gge_ImageData.ggeid_DataSize, MEMF_ANY)))
 				{
-					CopyMem(image_data, event->gge_Event.gge_ImageData.ggeid_Data, event->gge_Event.gge_ImageData.ggeid_DataSize);
+					CopyMem(r.ggpr_Pos, event->gge_Event.gge_ImageData.ggeid_Data, event->gge_Event.gge_ImageData.ggeid_DataSize);
 				}
 				else
 				{
@@ -935,37 +2323,46 @@ static VOID GGPacketHandlerRecvMsg(struct GGSession *gg_sess, struct GGEvent *ev
 
 static VOID GGPacketHandlerUserData(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac)
 {
-	struct GGPUsersData *ud = (struct GGPUsersData*)(pac + 1);
-	UBYTE *data = (UBYTE*)ud->ggpud_Data;
+	struct GGPReader r;
+	ULONG type, users_no;
 	ENTER();
 
-	ud->ggpud_Type = EndianFix32(ud->ggpud_Type);
-	ud->ggpud_UsersNo = EndianFix32(ud->ggpud_UsersNo);
+	GGReaderInit(&r, pac);
+
+	if(!GGReaderNeed(&r, sizeof(struct GGPUsersData)))
+		goto error;
+
+	type = GGReaderULONG(&r);
+	users_no = GGReaderULONG(&r);
+
+	/* kady uytkownik zajmuje w pakiecie co najmniej dwa pola ULONG */
+	if(users_no > GGReaderLeft(&r) / (2 * sizeof(ULONG)))
+		goto error;
 
-	if((event->gge_Event.gge_UsersData.ggeud_Data = AllocMem(sizeof(struct GGUserData) * ud->ggpud_UsersNo, MEMF_ANY)))
+	/* dane zdarzenia nie s wiksze ni dwukrotno pakietu, wic zwykle wystarcza jeden blok areny */
+	if(ArenaReserve(&event->gge_Arena, ARENA_ALIGN(sizeof(struct GGUserData) * users_no) + 2 * pac->ggph_Length) &&
+	 (event->gge_Event.gge_UsersData.ggeud_Data = ArenaAlloc(&event->gge_Arena, sizeof(struct GGUserData) * users_no)))
 	{
 		struct GGUserData *edata = event->gge_Event.gge_UsersData.ggeud_Data;
 		LONG i;
 
 		event->gge_Type = GGE_TYPE_USER_DATA;
-		event->gge_Event.gge_UsersData.ggeud_Type = ud->ggpud_Type;
-		event->gge_Event.gge_UsersData.ggeud_UsersNo = ud->ggpud_UsersNo;
+		event->gge_Event.gge_UsersData.ggeud_Type = type;
+		event->gge_Event.gge_UsersData.ggeud_UsersNo = users_no;
 
-		for(i = 0; i < ud->ggpud_UsersNo; i++)
+		for(i = 0; i < users_no; i++)
 		{
-			edata[i].ggud_Uin = EndianFix32(*((ULONG*)data));
-			data += sizeof(ULONG);
-
-			if(data > ud->ggpud_Data + pac->ggph_Length)
+			if(!GGReaderNeed(&r, 2 * sizeof(ULONG)))
 				goto error;
 
-			edata[i].ggud_AttrsNo = EndianFix32(*((ULONG*)data));
-			data += sizeof(ULONG);
+			edata[i].ggud_Uin = GGReaderULONG(&r);
+			edata[i].ggud_AttrsNo = GGReaderULONG(&r);
 
-			if(data > ud->ggpud_Data + pac->ggph_Length)
+			/* kady atrybut zajmuje w pakiecie co najmniej trzy pola ULONG */
+			if(edata[i].ggud_AttrsNo > GGReaderLeft(&r) / (3 * sizeof(ULONG)))
 				goto error;
 
-			if((edata[i].ggud_Attrs = AllocMem(sizeof(struct GGUserDataAttr) * edata[i].ggud_AttrsNo, MEMF_ANY)))
+			if((edata[i].ggud_Attrs = ArenaAlloc(&event->gge_Arena, sizeof(struct GGUserDataAttr) * edata[i].ggud_AttrsNo)))
 			{
 				LONG j;
 				struct GGUserDataAttr *attrs = edata[i].ggud_Attrs;
@@ -973,38 +2370,28 @@ static VOID GGPacketHandlerUserData(struct GGSession *gg_sess, struct GGEvent *e
 				for(j = 0; j < edata[i].ggud_AttrsNo; j++)
 				{
 					ULONG key_size, value_size;
+					UBYTE *key, *value;
 
-					key_size = EndianFix32(*((ULONG*)data));
-					data += sizeof(ULONG);
-
-					if(data > ud->ggpud_Data + pac->ggph_Length)
-						goto error;
-
-					attrs[j].gguda_Key = StrNewLen(data, key_size);
-					data += key_size;
-
-					if(data > ud->ggpud_Data + pac->ggph_Length)
+					if(!GGReaderNeed(&r, sizeof(ULONG)))
 						goto error;
 
-					attrs[j].gguda_Type = EndianFix32(*((ULONG*)data));
-					data += sizeof(ULONG);
+					key_size = GGReaderULONG(&r);
 
-					if(data > ud->ggpud_Data + pac->ggph_Length)
+					if(!(key = GGReaderBlock(&r, key_size)) || !GGReaderNeed(&r, 2 * sizeof(ULONG)))
 						goto error;
 
-					value_size = EndianFix32(*((ULONG*)data));
-					data += sizeof(ULONG);
+					attrs[j].gguda_Type = GGReaderULONG(&r);
+					value_size = GGReaderULONG(&r);
 
-					if(data > ud->ggpud_Data + pac->ggph_Length)
+					if(!(value = GGReaderBlock(&r, value_size)))
 						goto error;
 
-					attrs[j].gguda_Value = StrNewLen(data, value_size);
-					data += value_size;
-
-					if(data > ud->ggpud_Data + pac->ggph_Length)
-						goto error;
+					attrs[j].gguda_Key = ArenaStrNewLen(&event->gge_Arena, (STRPTR)key, key_size);
+					attrs[j].gguda_Value = ArenaStrNewLen(&event->gge_Arena, (STRPTR)value, value_size);
 				}
 			}
+			else
+				edata[i].ggud_AttrsNo = 0;
 		}
 	}
 
@@ -1012,31 +2399,13 @@ static VOID GGPacketHandlerUserData(struct GGSession *gg_sess, struct GGEvent *e
 	return;
 
 error:
-	if(event->gge_Event.gge_UsersData.ggeud_Data)
-	{
-		LONG i;
-
-		for(i = 0; i < event->gge_Event.gge_UsersData.ggeud_UsersNo; i++)
-		{
-			if(event->gge_Event.gge_UsersData.ggeud_Data[i].ggud_Attrs)
-			{
-				LONG j;
-
-				for(j = 0; j < event->gge_Event.gge_UsersData.ggeud_Data[i].ggud_AttrsNo; j++)
-				{
-					if(event->gge_Event.gge_UsersData.ggeud_Data[i].ggud_Attrs[j].gguda_Key)
-						StrFree(event->gge_Event.gge_UsersData.ggeud_Data[i].ggud_Attrs[j].gguda_Key);
-
-					if(event->gge_Event.gge_UsersData.ggeud_Data[i].ggud_Attrs[j].gguda_Value)
-						StrFree(event->gge_Event.gge_UsersData.ggeud_Data[i].ggud_Attrs[j].gguda_Value);
-				}
-				FreeMem(event->gge_Event.gge_UsersData.ggeud_Data[i].ggud_Attrs, sizeof(struct GGUserDataAttr) * event->gge_Event.gge_UsersData.ggeud_Data[i].ggud_AttrsNo);
-			}
-		}
-		FreeMem(event->gge_Event.gge_UsersData.ggeud_Data, sizeof(struct GGUserData) * event->gge_Event.gge_UsersData.ggeud_UsersNo);
-		event->gge_Event.gge_UsersData.ggeud_Data = NULL;
-		event->gge_Type = GGE_TYPE_NOOP;
-	}
+	/* wszystko, co zdylimy zbudowa, ley w arenie */
+	ArenaFree(event->gge_Arena);
+	event->gge_Arena = NULL;
+	event->gge_Event.gge_UsersData.ggeud_Data = NULL;
+	event->gge_Event.gge_UsersData.ggeud_UsersNo = 0;
+	event->gge_Type = GGE_TYPE_NOOP;
+	LEAVE();
 }
 
 
@@ -1133,50 +2502,70 @@ static VOID GGPacketHandlerUserListReply(struct GGSession *gg_sess, struct GGEve
 
 static VOID GGPacketHandlerMultilogonInfo(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac)
 {
-	struct GGPMultilogonInfo *ul = (struct GGPMultilogonInfo*)(pac + 1);
-	UBYTE *data = (UBYTE*)&ul->ggpmi_Data;
+	struct GGPReader r;
+	ULONG clients_no;
 	ENTER();
 
-	ul->ggpmi_ClientsNo = EndianFix32(ul->ggpmi_ClientsNo);
+	GGReaderInit(&r, pac);
+
+	if(!GGReaderNeed(&r, sizeof(struct GGPMultilogonInfo)))
+		goto error;
+
+	clients_no = GGReaderULONG(&r);
+
+	/* kady klient zajmuje w pakiecie co najmniej GGP_MULTILOGON_RECORD_SIZE bajtw */
+	if(clients_no > GGReaderLeft(&r) / GGP_MULTILOGON_RECORD_SIZE)
+		goto error;
 
 	event->gge_Type = GGE_TYPE_MULTILOGON_INFO;
-	event->gge_Event.gge_MultilogonInfo.ggemi_No = ul->ggpmi_ClientsNo;
+	event->gge_Event.gge_MultilogonInfo.ggemi_No = clients_no;
 
-	if((event->gge_Event.gge_MultilogonInfo.ggemi_Data = AllocMem(sizeof(struct GGMultilogonInfo) * ul->ggpmi_ClientsNo, MEMF_ANY)))
+	if(ArenaReserve(&event->gge_Arena, ARENA_ALIGN(sizeof(struct GGMultilogonInfo) * clients_no) + 2 * pac->ggph_Length) &&
+	 (event->gge_Event.gge_MultilogonInfo.ggemi_Data = ArenaAlloc(&event->gge_Arena, sizeof(struct GGMultilogonInfo) * clients_no)))
 	{
+		struct GGMultilogonInfo *mi = event->gge_Event.gge_MultilogonInfo.ggemi_Data;
 		LONG i;
 
-		for(i = 0; i < ul->ggpmi_ClientsNo; i++)
+		for(i = 0; i < clients_no; i++)
 		{
-			LONG name_len;
-
-			event->gge_Event.gge_MultilogonInfo.ggemi_Data[i].ggmi_Ip = *((ULONG*)data);
-			data += sizeof(ULONG);
-
-			event->gge_Event.gge_MultilogonInfo.ggemi_Data[i].ggmi_Flags = EndianFix32(*((ULONG*)data));
-			data += sizeof(ULONG);
+			ULONG name_len;
+			UBYTE *name;
 
-			event->gge_Event.gge_MultilogonInfo.ggemi_Data[i].ggmi_Features = EndianFix32(*((ULONG*)data));
-			data += sizeof(ULONG);
+			/* jedno sprawdzenie na ca sta cz rekordu */
+			if(!GGReaderNeed(&r, GGP_MULTILOGON_RECORD_SIZE))
+				goto error;
 
-			event->gge_Event.gge_MultilogonInfo.ggemi_Data[i].ggmi_Timestamp = EndianFix32(*((ULONG*)data));
-			data += sizeof(ULONG);
+			/* adres IP zostaje w kolejnoci sieciowej */
+			__builtin_memcpy(&mi[i].ggmi_Ip, r.ggpr_Pos, sizeof(ULONG));
+			r.ggpr_Pos += sizeof(ULONG);
 
-			event->gge_Event.gge_MultilogonInfo.ggemi_Data[i].ggmi_Id = EndianFix64(*((UQUAD*)data));
-			data += sizeof(UQUAD);
+			mi[i].ggmi_Flags = GGReaderULONG(&r);
+			mi[i].ggmi_Features = GGReaderULONG(&r);
+			mi[i].ggmi_Timestamp = GGReaderULONG(&r);
+			mi[i].ggmi_Id = GGReaderUQUAD(&r);
 
 			/* ominicie pola o nieznanym przeznaczeniu (zawsze rwnego 0) */
-			data += sizeof(ULONG);
+			r.ggpr_Pos += sizeof(ULONG);
+
+			name_len = GGReaderULONG(&r);
 
-			name_len = EndianFix32(*((ULONG*)data));
-			data += sizeof(ULONG);
+			if(!(name = GGReaderBlock(&r, name_len)))
+				goto error;
 
-			event->gge_Event.gge_MultilogonInfo.ggemi_Data[i].ggmi_Name = StrNewLen((STRPTR)data, name_len);
-			data += name_len;
+			mi[i].ggmi_Name = ArenaStrNewLen(&event->gge_Arena, (STRPTR)name, name_len);
 		}
 	}
 
 	LEAVE();
+	return;
+
+error:
+	ArenaFree(event->gge_Arena);
+	event->gge_Arena = NULL;
+	event->gge_Event.gge_MultilogonInfo.ggemi_Data = NULL;
+	event->gge_Event.gge_MultilogonInfo.ggemi_No = 0;
+	event->gge_Type = GGE_TYPE_NOOP;
+	LEAVE();
 }
 
 /****if* ggpackets.c/GGPacketHandlerPubDirInfo()
@@ -1225,31 +2614,31 @@ static VOID GGPacketHandlerPubDirInfo(struct GGSession *gg_sess, struct GGEvent
 			else if(StrEqu(t, "firstname"))
 			{
 				t += 10;
-				p->ggepdi_FirstName = StrNew(t);
+				p->ggepdi_FirstName = ArenaStrNew(&event->gge_Arena, t);
 				t += StrLen(t) + 1;
 			}
 			else if(StrEqu(t, "lastname"))
 			{
 				t += 9;
-				p->ggepdi_LastName = StrNew(t);
+				p->ggepdi_LastName = ArenaStrNew(&event->gge_Arena, t);
 				t += StrLen(t) + 1;
 			}
 			else if(StrEqu(t, "nickname"))
 			{
 				t += 9;
-				p->ggepdi_NickName = StrNew(t);
+				p->ggepdi_NickName = ArenaStrNew(&event->gge_Arena, t);
 				t += StrLen(t) + 1;
 			}
 			else if(StrEqu(t, "birthyear"))
 			{
 				t += 10;
-				p->ggepdi_BirthYear = StrNew(t);
+				p->ggepdi_BirthYear = ArenaStrNew(&event->gge_Arena, t);
 				t += StrLen(t) + 1;
 			}
 			else if(StrEqu(t, "city"))
 			{
 				t += 5;
-				p->ggepdi_City = StrNew(t);
+				p->ggepdi_City = ArenaStrNew(&event->gge_Arena, t);
 				t += StrLen(t) + 1;
 			}
 			else if(StrEqu(t, "gender"))
@@ -1318,16 +2707,51 @@ static VOID GGPacketHandlerUnknownPacket(struct GGSession *gg_sess, struct GGPHe
 }
 #endif /* __DEBUG__ */
 
+/****iv* ggpackets.c/GGPacketDispatchDefault
+ *
+ *  NAME
+ *    GGPacketDispatchDefault
+ *
+ *  FUNCTION
+ *    Domylna tablica handlerw odebranych pakietw, indeksowana typem pakietu. Sesja uywa
+ *    jej dopki GGSetPacketHandler() nie utworzy kopii w ggs_Dispatch.
+ *
+ *  SEE ALSO
+ *    GGPacketDispatch, GGP_SIZE_#?
+ *
+ *****/
+
+const struct GGPacketDispatch GGPacketDispatchDefault[GGP_DISPATCH_SIZE] =
+{
+	/* powitanie (wysya pakiet logowania) i wiadomoci (wysyaj potwierdzenie) nie mog by maskowane */
+	[GGP_TYPE_WELCOME]          = {GGPacketHandlerWelcome,        GGP_SIZE_WELCOME,          0, GGE_TYPE_NOOP},
+	[GGP_TYPE_LOGIN_OK]         = {GGPacketHandlerLogin,          GGP_SIZE_LOGIN_OK,         0, GGE_TYPE_LOGIN_SUCCESS},
+	[GGP_TYPE_LOGIN_FAIL]       = {GGPacketHandlerLogin,          GGP_SIZE_LOGIN_FAIL,       0, GGE_TYPE_LOGIN_FAIL},
+	[GGP_TYPE_LOGIN_FAIL2]      = {GGPacketHandlerLogin,          GGP_SIZE_LOGIN_FAIL,       0, GGE_TYPE_LOGIN_FAIL},
+	[GGP_TYPE_STATUS_CHANGE]    = {GGPacketHandlerStatusChange,   GGP_SIZE_STATUS_CHANGE,    0, GGE_TYPE_STATUS_CHANGE},
+	[GGP_TYPE_LIST_STATUS]      = {GGPacketHandlerListStatus,     GGP_SIZE_LIST_STATUS,      0, GGE_TYPE_LIST_STATUS},
+	[GGP_TYPE_TYPING_NOTIFY]    = {GGPacketHandlerTypingNotify,   GGP_SIZE_TYPING_NOTIFY,    0, GGE_TYPE_TYPING_NOTIFY},
+	[GGP_TYPE_RECV_MSG]         = {GGPacketHandlerRecvMsg,        GGP_SIZE_RECV_MSG,         0, GGE_TYPE_NOOP},
+	[GGP_TYPE_RECV_OWN_MSG]     = {GGPacketHandlerRecvMsg,        GGP_SIZE_RECV_MSG,         0, GGE_TYPE_NOOP},
+	[GGP_TYPE_USER_DATA]        = {GGPacketHandlerUserData,       GGP_SIZE_USER_DATA,        0, GGE_TYPE_USER_DATA},
+	[GGP_TYPE_USER_LIST_REPLY]  = {GGPacketHandlerUserListReply,  GGP_SIZE_USER_LIST_REPLY,  0, GGE_TYPE_LIST_IMPORT},
+	[GGP_TYPE_MULTILOGON_INFO]  = {GGPacketHandlerMultilogonInfo, GGP_SIZE_MULTILOGON_INFO,  0, GGE_TYPE_MULTILOGON_INFO},
+	[GGP_TYPE_PUBDIR_RESPONSE]  = {GGPacketHandlerPubDirInfo,     GGP_SIZE_PUBDIR_RESPONSE,  0, GGE_TYPE_PUBDIR_INFO},
+};
+
 /****if* ggpackets.c/GGHandlePacket()
  *
  *  NAME
  *    GGHandlePacket()
  *
  *  SYNOPSIS
- *    BOOL GGHandlePacket(struct GGSession *gg_sess, struct GGPHeader *pac)
+ *    LONG GGHandlePacket(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac)
  *
  *  FUNCTION
- *    Funkcja uruchamia odpowiedni handler dla danego typu pakietu.
+ *    Funkcja uruchamia handler dla danego typu pakietu, pobrany bezporednio z tablicy
+ *    handlerw sesji (lub domylnej). Pakiety nieznane, oznaczone flag GG_PACKET_IGNORE,
+ *    generujce zdarzenia spoza maski ggs_EventMask oraz krtsze ni ich schemat s porzucane
+ *    bez wypeniania zdarzenia.
  *
  *  INPUTS
  *    - gg_sess -- wskanik na struktur GGSession odpowiadajce za poczenie;
@@ -1335,77 +2759,46 @@ static VOID GGPacketHandlerUnknownPacket(struct GGSession *gg_sess, struct GGPHe
  *    - pac -- wskanik na struktur GGPHeader danego pakietu.
  *
  *  RESULT
- *    - TRUE -- jeli odpowiedni handler zosta znaleziony
- *    - FALSE -- handler dla danego typu pakietu nie istnieje
+ *    - GGH_RETURN_WAIT -- handler wypeni zdarzenie;
+ *    - GGH_RETURN_NEXT -- pakiet zosta porzucony, zdarzenie mona wykorzysta dla nastpnego pakietu.
+ *
+ *  SEE ALSO
+ *    GGPacketDispatch, GGSetPacketHandler()
  *
  *****/
 
-BOOL GGHandlePacket(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac)
+LONG GGHandlePacket(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac)
 {
-	BOOL result = FALSE;
+	const struct GGPacketDispatch *d = NULL;
+	LONG result = GGH_RETURN_NEXT;
 	ENTER();
 
-	switch(pac->ggph_Type)
-	{
-		case GGP_TYPE_WELCOME:
-			GGPacketHandlerWelcome(gg_sess, event, pac);
-			result = TRUE;
-		break;
-
-		case GGP_TYPE_LOGIN_OK:
-		case GGP_TYPE_LOGIN_FAIL:
-		case GGP_TYPE_LOGIN_FAIL2:
-			GGPacketHandlerLogin(gg_sess, event, pac);
-			result = TRUE;
-		break;
-
-		case GGP_TYPE_STATUS_CHANGE:
-			GGPacketHandlerStatusChange(gg_sess, event, pac);
-			result = TRUE;
-		break;
-
-		case GGP_TYPE_LIST_STATUS:
-			GGPacketHandlerListStatus(gg_sess, event, pac);
-			result = TRUE;
-		break;
-
-		case GGP_TYPE_TYPING_NOTIFY:
-			GGPacketHandlerTypingNotify(gg_sess, event, pac);
-			result = TRUE;
-		break;
-
-		case GGP_TYPE_RECV_OWN_MSG:
-		case GGP_TYPE_RECV_MSG:
-			GGPacketHandlerRecvMsg(gg_sess, event, pac);
-			result = TRUE;
-		break;
-
-		case GGP_TYPE_USER_DATA:
-			GGPacketHandlerUserData(gg_sess, event, pac);
-			result = TRUE;
-		break;
-
-		case GGP_TYPE_USER_LIST_REPLY:
-			GGPacketHandlerUserListReply(gg_sess, event, pac);
-			result = TRUE;
-		break;
-
-		case GGP_TYPE_MULTILOGON_INFO:
-			GGPacketHandlerMultilogonInfo(gg_sess, event, pac);
-			result = TRUE;
-		break;
-
-		case GGP_TYPE_PUBDIR_RESPONSE:
-			GGPacketHandlerPubDirInfo(gg_sess, event, pac);
-			result = TRUE;
-		break;
+	if(pac->ggph_Type < GGP_DISPATCH_SIZE)
+		d = gg_sess->ggs_Dispatch ? &gg_sess->ggs_Dispatch[pac->ggph_Type] : &GGPacketDispatchDefault[pac->ggph_Type];
 
-		default:
+	if(d && ((d->ggpd_Flags & GG_PACKET_IGNORE) ||
+	 (d->ggpd_Event != GGE_TYPE_NOOP && !(gg_sess->ggs_EventMask & GGE_MASK(d->ggpd_Event)))))
+	{
+		/* pakiet, ktrym aplikacja nie jest zainteresowana, porzucamy bez dekodowania */
+	}
+	else if(d && d->ggpd_Handler)
+	{
+		if(pac->ggph_Length >= d->ggpd_MinLength)
+		{
+			d->ggpd_Handler(gg_sess, event, pac);
+			result = GGH_RETURN_WAIT;
+		}
+		else
+		{
+			/* pakiet krtszy ni jego staa cz, nie przekazujemy go do handlera */
+			tprintf("Packet 0x%08lx too short (%lu bytes)!\n", pac->ggph_Type, pac->ggph_Length);
+		}
+	}
+	else
+	{
 #ifdef __DEBUG__
-			GGPacketHandlerUnknownPacket(gg_sess, pac);
+		GGPacketHandlerUnknownPacket(gg_sess, pac);
 #endif /* __DEBUG__ */
-			event->gge_Type = GGE_TYPE_NOOP;
-			result = TRUE; /* zakomentowanie spowoduje zamykanie poczenia po odebraniu nieznanego pakietu */
 	}
 
 	LEAVE();
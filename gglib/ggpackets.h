@@ -45,6 +45,232 @@
 #define GGA_CreatePacket_QUAD           (TAG_USER + 11)
 #define GGA_CreatePacket_UQUAD          (TAG_USER + 12)
 
+/* bufor odbiorczy sesji */
+#define GGP_RECV_BUFFER_SIZE            (16384)  /* pocztkowy rozmiar, mieci peny rekord TLS */
+#define GGP_MAX_PACKET_LENGTH           (65535)  /* maksymalna dugo danych pakietu */
+
+/* kolejka wysyania sesji */
+#define GGP_WRITE_RECORD_SIZE           (16384)  /* rozmiar segmentu czcego mae pakiety (peny rekord TLS) */
+#define GGP_WRITE_COALESCE_MAX          (2048)   /* pakiety do tej dugoci s doklejane do segmentu czcego */
+
+/* wysyanie obrazkw */
+#define GGP_IMAGE_SINGLE_MAX            (1873)   /* obrazki do tego rozmiaru wysyane s jednym pakietem */
+#define GGP_IMAGE_CHUNK_SIZE            (1843)   /* rozmiar porcji danych wikszych obrazkw */
+#define GGP_IMAGE_UPLOAD_WATERMARK      (GGP_WRITE_RECORD_SIZE) /* kolejne porcje dopisywane s poniej tej iloci danych w kolejce */
+#define GGP_IMAGE_UPLOAD_PROGRESS_STEP  (8 * GGP_IMAGE_CHUNK_SIZE) /* co tyle bajtw zgaszany jest postp wysyania */
+
+/****is* ggpackets.h/GGRecvBlock
+ *
+ *  NAME
+ *    GGRecvBlock
+ *
+ *  FUNCTION
+ *    Blok pamici bufora odbiorczego sesji. Zdarzenia, ktrych dane pokazuj bezporednio
+ *    na odebrany pakiet, zwikszaj licznik odwoa, dziki czemu blok nie zostanie
+ *    nadpisany ani zwolniony przed zwolnieniem tych zdarze.
+ *
+ *  ATTRIBUTES
+ *    - ggrb_Refs -- ilo odwoa (sesja oraz zdarzenia);
+ *    - ggrb_Data -- dane bufora.
+ *
+ *  SEE ALSO
+ *    GGReceivePacket(), GGRecvBlockRelease()
+ *
+ *  SOURCE
+ */
+
+struct GGRecvBlock
+{
+	ULONG ggrb_Refs;
+	BYTE ggrb_Data[];
+};
+
+/******GGRecvBlock******/
+
+/****is* ggpackets.h/GGWriteSegment
+ *
+ *  NAME
+ *    GGWriteSegment
+ *
+ *  FUNCTION
+ *    Segment kolejki danych wysyanych. Due pakiety trafiaj do kolejki bez kopiowania,
+ *    jako osobne segmenty, mae s doklejane do segmentu czcego o rozmiarze
+ *    GGP_WRITE_RECORD_SIZE, dziki czemu wysyane s jednym wywoaniem SSL_write().
+ *
+ *  ATTRIBUTES
+ *    - ggws_Next -- nastpny segment kolejki lub NULL;
+ *    - ggws_Data -- wskanik na dane segmentu;
+ *    - ggws_Len -- ilo danych w segmencie;
+ *    - ggws_Size -- pojemno segmentu czcego (dane le zaraz za struktur)
+ *      lub 0 jeli segment zawiera pojedynczy pakiet zaalokowany przez AllocVec();
+ *    - ggws_Written -- ilo danych segmentu, ktra zostaa ju wysana.
+ *
+ *  SEE ALSO
+ *    GGAddToWriteBuffer(), GGWriteData()
+ *
+ *  SOURCE
+ */
+
+struct GGWriteSegment
+{
+	struct GGWriteSegment *ggws_Next;
+	BYTE *ggws_Data;
+	LONG ggws_Len;
+	LONG ggws_Size;
+	LONG ggws_Written;
+};
+
+/******GGWriteSegment******/
+
+/****is* ggpackets.h/GGImageUpload
+ *
+ *  NAME
+ *    GGImageUpload
+ *
+ *  FUNCTION
+ *    Struktura opisuje obrazek wysyany przez GGSendImageData(). Wysyane obrazki tworz
+ *    list sesji (ggs_UploadHead), z ktrej GGImageUploadPump() pobiera kolejne porcje danych
+ *    dopiero gdy kolejka wysyania klasy GGS_LANE_BULK oprni si poniej
+ *    GGP_IMAGE_UPLOAD_WATERMARK. Zakoczone wysyki czekaj na licie ggs_UploadDone, a
+ *    GGImageUploadReport() zgosi je zdarzeniem.
+ *
+ *  ATTRIBUTES
+ *    - ggiu_Next -- nastpny wysyany obrazek lub NULL;
+ *    - ggiu_Uin -- numer, ktry da obrazka;
+ *    - ggiu_File -- uchwyt do pliku z obrazkiem, zamykany po wysaniu;
+ *    - ggiu_Size -- rozmiar obrazka;
+ *    - ggiu_Crc32 -- suma kontrolna obrazka (CRC32);
+ *    - ggiu_Sent -- ilo danych obrazka dopisanych ju do kolejki wysyania;
+ *    - ggiu_Seq -- numer sekwencyjny nastpnego pakietu;
+ *    - ggiu_Reported -- warto ggiu_Sent przy ostatnim zgoszeniu postpu;
+ *    - ggiu_State -- stan zakoczonej wysyki (GG_IMAGE_UPLOAD_DONE lub GG_IMAGE_UPLOAD_FAILED);
+ *    - ggiu_FileName -- nazwa pliku przesyana w pierwszym pakiecie.
+ *
+ *  SEE ALSO
+ *    GGSendImageData(), GGImageUploadPump(), GGImageUploadReport(), GGEventImageUpload
+ *
+ *  SOURCE
+ */
+
+struct GGImageUpload
+{
+	struct GGImageUpload *ggiu_Next;
+	ULONG ggiu_Uin;
+	BPTR ggiu_File;
+	ULONG ggiu_Size;
+	ULONG ggiu_Crc32;
+	ULONG ggiu_Sent;
+	ULONG ggiu_Seq;
+	ULONG ggiu_Reported;
+	ULONG ggiu_State;
+	UBYTE ggiu_FileName[17];
+};
+
+/******GGImageUpload******/
+
+/****is* ggpackets.h/GGPacketBuilder
+ *
+ *  NAME
+ *    GGPacketBuilder
+ *
+ *  FUNCTION
+ *    Struktura opisuje pakiet budowany bezporednio w segmencie kolejki wysyania.
+ *    Wypeniana przez GGPacketBegin(), pola pakietu dopisywane s funkcjami
+ *    GGPacketPut#?(), a dugo w nagwku uzupenia GGPacketCommit().
+ *
+ *  ATTRIBUTES
+ *    - ggpb_Session -- sesja, do ktrej kolejki trafi pakiet;
+ *    - ggpb_Lane -- kolejka sesji (klasa priorytetu), do ktrej trafi pakiet;
+ *    - ggpb_Segment -- segment, w ktrym zarezerwowano miejsce na pakiet;
+ *    - ggpb_Start -- pocztek pakietu (nagwek GGPHeader);
+ *    - ggpb_Pos -- miejsce zapisu nastpnego pola;
+ *    - ggpb_End -- koniec zarezerwowanego miejsca;
+ *    - ggpb_Overflow -- TRUE jeli pola nie zmieciy si w zarezerwowanym miejscu.
+ *
+ *  SEE ALSO
+ *    GGPacketBegin(), GGPacketCommit(), GGWriteSegment
+ *
+ *  SOURCE
+ */
+
+struct GGPacketBuilder
+{
+	struct GGSession *ggpb_Session;
+	struct GGWriteLane *ggpb_Lane;
+	struct GGWriteSegment *ggpb_Segment;
+	BYTE *ggpb_Start;
+	BYTE *ggpb_Pos;
+	BYTE *ggpb_End;
+	BOOL ggpb_Overflow;
+};
+
+/******GGPacketBuilder******/
+
+/****is* ggpackets.h/GGPReader
+ *
+ *  NAME
+ *    GGPReader
+ *
+ *  FUNCTION
+ *    Struktura opisuje odczyt danych odebranego pakietu bezporednio z bufora
+ *    odbiorczego. Dugo sprawdzana jest raz dla caego rekordu o staej dugoci
+ *    (GGReaderNeed()), po czym jego pola odczytywane s bez dalszych sprawdze.
+ *    Wyjcie poza pakiet ustawia ggpr_Error, a kolejne odczyty nic nie zwracaj.
+ *
+ *  ATTRIBUTES
+ *    - ggpr_Pos -- miejsce nastpnego odczytu;
+ *    - ggpr_End -- koniec danych pakietu;
+ *    - ggpr_Error -- TRUE jeli ktrykolwiek odczyt wyszedby poza pakiet.
+ *
+ *  SEE ALSO
+ *    GGReaderInit(), GGReaderNeed(), GGReaderBlock()
+ *
+ *  SOURCE
+ */
+
+struct GGPReader
+{
+	UBYTE *ggpr_Pos;
+	UBYTE *ggpr_End;
+	BOOL ggpr_Error;
+};
+
+/******GGPReader******/
+
+/****is* ggpackets.h/GGPacketDispatch
+ *
+ *  NAME
+ *    GGPacketDispatch
+ *
+ *  FUNCTION
+ *    Wpis tablicy handlerw odebranych pakietw, indeksowanej typem pakietu
+ *    (od 0 do GGP_DISPATCH_SIZE - 1).
+ *
+ *  ATTRIBUTES
+ *    - ggpd_Handler -- funkcja obsugujca pakiet lub NULL jeli typ jest nieznany;
+ *    - ggpd_MinLength -- minimalna dugo danych pakietu (GGP_SIZE_#?), krtsze pakiety s porzucane;
+ *    - ggpd_Flags -- flagi GG_PACKET_#?;
+ *    - ggpd_Event -- typ zdarzenia generowanego przez handler, wedug ktrego pakiet jest filtrowany
+ *      mask ggs_EventMask, GGE_TYPE_NOOP jeli pakiet musi by zawsze obsuony.
+ *
+ *  SEE ALSO
+ *    GGHandlePacket(), GGSetPacketHandler()
+ *
+ *  SOURCE
+ */
+
+#define GGP_DISPATCH_SIZE               (0x100)
+
+struct GGPacketDispatch
+{
+	GGPacketHandlerFunc ggpd_Handler;
+	ULONG ggpd_MinLength;
+	ULONG ggpd_Flags;
+	LONG ggpd_Event;
+};
+
+/******GGPacketDispatch******/
+
 /****id* ggpackets.h/GGP_TYPE_#?
  *
  *  NAME
@@ -361,6 +587,9 @@ struct GGPMultilogonInfo
 
 /******GGPMultilogonInfo******/
 
+/* staa cz opisu klienta w GGPMultilogonInfo: ip, flagi, opcje, czas, id, pole nieznane, dugo nazwy */
+#define GGP_MULTILOGON_RECORD_SIZE      (4 * sizeof(ULONG) + sizeof(UQUAD) + 2 * sizeof(ULONG))
+
 /****is* ggpackets.h/GGPPubDirInfo
  *
  *  NAME
@@ -390,14 +619,187 @@ struct GGPPubDirInfo
 
 /******GGPPubDirInfo******/
 
+/* struktury opisujce pakiety wysyane o staej dugoci */
+
+/****is* ggpackets.h/GGPMsgAck
+ *
+ *  NAME
+ *    GGPMsgAck
+ *
+ *  FUNCTION
+ *    Struktura opisuje pakiet potwierdzenia otrzymania wiadomoci.
+ *
+ *  ATTRIBUTES
+ *    - ggpma_Seq -- numer sekwencyjny potwierdzanej wiadomoci.
+ *
+ *  SEE ALSO
+ *    GGP_TYPE_#?, GGAcceptMessage()
+ *
+ *  SOURCE
+ */
+
+struct GGPMsgAck
+{
+	ULONG ggpma_Seq;
+}GG_PACKED;
+
+/******GGPMsgAck******/
+
+/****is* ggpackets.h/GGPNotify
+ *
+ *  NAME
+ *    GGPNotify
+ *
+ *  FUNCTION
+ *    Struktura opisuje pakiet dodania (GGP_TYPE_ADD_NOTIFY) lub usunicia
+ *    (GGP_TYPE_REMOVE_NOTIFY) kontaktu z listy obserwowanych statusw.
+ *
+ *  ATTRIBUTES
+ *    - ggpn_Uin -- numer kontaktu;
+ *    - ggpn_Type -- typ kontaktu.
+ *
+ *  SEE ALSO
+ *    GGP_TYPE_#?, GGAddNotify(), GGRemoveNotify()
+ *
+ *  SOURCE
+ */
+
+struct GGPNotify
+{
+	ULONG ggpn_Uin;
+	UBYTE ggpn_Type;
+}GG_PACKED;
+
+/******GGPNotify******/
+
+/****is* ggpackets.h/GGPUserListRequest
+ *
+ *  NAME
+ *    GGPUserListRequest
+ *
+ *  FUNCTION
+ *    Struktura opisuje pakiet zapytania o list kontaktw. Przy eksporcie listy
+ *    za struktur znajduje si skompresowana lista kontaktw.
+ *
+ *  ATTRIBUTES
+ *    - ggpulr_Type -- typ zapytania (0x02 import, 0x00 eksport);
+ *    - ggpulr_Version -- wersja listy kontaktw;
+ *    - ggpulr_Format -- jedna ze staych GG_LIST_FORMAT_#?;
+ *    - ggpulr_Unknown -- pole o nieznanym przeznaczeniu, zawsze rwne 0x01.
+ *
+ *  SEE ALSO
+ *    GGP_TYPE_#?, GGRequestContactList(), GGExportContactList()
+ *
+ *  SOURCE
+ */
+
+struct GGPUserListRequest
+{
+	UBYTE ggpulr_Type;
+	ULONG ggpulr_Version;
+	UBYTE ggpulr_Format;
+	UBYTE ggpulr_Unknown;
+}GG_PACKED;
+
+/******GGPUserListRequest******/
+
+/****is* ggpackets.h/GGPMultilogonDisconnect
+ *
+ *  NAME
+ *    GGPMultilogonDisconnect
+ *
+ *  FUNCTION
+ *    Struktura opisuje pakiet rozczenia rwnolegle zalogowanego klienta.
+ *
+ *  ATTRIBUTES
+ *    - ggpmd_Id -- identyfikator poczenia do rozczenia.
+ *
+ *  SEE ALSO
+ *    GGP_TYPE_#?, GGDisconnectMultilogon()
+ *
+ *  SOURCE
+ */
+
+struct GGPMultilogonDisconnect
+{
+	UQUAD ggpmd_Id;
+}GG_PACKED;
+
+/******GGPMultilogonDisconnect******/
+
+/****id* ggpackets.h/GGP_SIZE_#?
+ *
+ *  NAME
+ *    GGP_SIZE_#?
+ *
+ *  FUNCTION
+ *    Schematy pakietw: dugo danych pakietw o staej dugoci oraz minimalna dugo
+ *    (staa cz) pakietw o zmiennej dugoci, znane w czasie kompilacji. Pakiety o staej
+ *    dugoci budowane s przez GGPacketBeginFixed() bez interpretera tagw, odbierane
+ *    pakiety krtsze ni ich schemat s odrzucane przed uruchomieniem handlera, a ich staa
+ *    cz dekodowana jest przez GGPDecode#?().
+ *
+ *  SEE ALSO
+ *    GGP_TYPE_#?, GGPacketBeginFixed(), GGPacketCreateTagList()
+ *
+ *  SOURCE
+ */
+
+/* pakiety wysyane */
+#define GGP_SIZE_PING                   (0)
+#define GGP_SIZE_LIST_EMPTY             (0)
+#define GGP_NOTIFY_LIST_MAX             (400)   /* kontaktw w jednym pakiecie GGP_TYPE_NOTIFY_NORMAL/LAST */
+#define GGP_SIZE_MSG_ACK                (sizeof(struct GGPMsgAck))
+#define GGP_SIZE_TYPING_NOTIFY          (sizeof(struct GGPTypingNotify))
+#define GGP_SIZE_ADD_NOTIFY             (sizeof(struct GGPNotify))
+#define GGP_SIZE_REMOVE_NOTIFY          (sizeof(struct GGPNotify))
+#define GGP_SIZE_USER_LIST_REQ          (sizeof(struct GGPUserListRequest))
+#define GGP_SIZE_MULTILOGON_DISCONNECT  (sizeof(struct GGPMultilogonDisconnect))
+
+/* pakiety odbierane */
+#define GGP_SIZE_WELCOME                (sizeof(struct GGPWelcome))
+#define GGP_SIZE_LOGIN_OK               (0)     /* starsze serwery nie wysyaj GGPLoginOK */
+#define GGP_SIZE_LOGIN_FAIL             (0)
+#define GGP_SIZE_LIST_STATUS            (0)     /* tablica GGPStatusChange, moe by pusta */
+#define GGP_SIZE_STATUS_CHANGE          (sizeof(struct GGPStatusChange))
+#define GGP_SIZE_RECV_MSG               (sizeof(struct GGPRecvMsg))
+#define GGP_SIZE_USER_DATA              (sizeof(struct GGPUsersData))
+#define GGP_SIZE_USER_LIST_REPLY        (sizeof(struct GGPUserList))
+#define GGP_SIZE_MULTILOGON_INFO        (sizeof(struct GGPMultilogonInfo))
+#define GGP_SIZE_PUBDIR_RESPONSE        (sizeof(struct GGPPubDirInfo))
+
+/******GGP_SIZE_#?******/
+
 struct GGPHeader *GGReceivePacket(struct GGSession *gg_sess);
+VOID GGRecvBlockRelease(struct GGRecvBlock *block);
+VOID GGRosterRemove(struct GGSession *gg_sess, ULONG uin);
+BOOL GGPacketPending(struct GGSession *gg_sess);
 LONG GGWriteData(struct GGSession *gg_sess);
+BOOL GGWriteCorked(struct GGSession *gg_sess);
+VOID GGCorkBegin(struct GGSession *gg_sess);
 BYTE *GGPacketCreateTagList(ULONG type, ULONG *len, struct TagItem *taglist);
 #ifdef USE_INLINE_STDARG
 #define GGPacketCreateTags(type, len, ...)	({ULONG _tags[] = {__VA_ARGS__}; GGPacketCreateTagList(type, len, (struct TagItem*)_tags);})
 #endif /* USE_INLINE_STDARG */
-BOOL GGHandlePacket(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac);
+LONG GGHandlePacket(struct GGSession *gg_sess, struct GGEvent *event, struct GGPHeader *pac);
+extern const struct GGPacketDispatch GGPacketDispatchDefault[GGP_DISPATCH_SIZE];
 BOOL GGAddToWriteBuffer(struct GGSession *gg_sess, BYTE *add, LONG len);
+VOID GGFreeWriteBuffer(struct GGSession *gg_sess);
 BOOL GGAcceptMessage(struct GGSession *gg_sess, ULONG seq);
+BOOL GGAckFlush(struct GGSession *gg_sess, BOOL force);
+BOOL GGPacketBegin(struct GGSession *gg_sess, struct GGPacketBuilder *pb, ULONG type, LONG max_len);
+VOID GGPacketPutULONG(struct GGPacketBuilder *pb, ULONG val);
+VOID GGPacketPutUSHORT(struct GGPacketBuilder *pb, USHORT val);
+VOID GGPacketPutUBYTE(struct GGPacketBuilder *pb, UBYTE val);
+VOID GGPacketPutBlock(struct GGPacketBuilder *pb, APTR data, LONG len);
+VOID GGPacketPutString(struct GGPacketBuilder *pb, STRPTR str);
+VOID GGPacketPutZero(struct GGPacketBuilder *pb, LONG len);
+VOID GGPacketPutHTML(struct GGPacketBuilder *pb, STRPTR txt, STRPTR images);
+APTR GGPacketBeginRecord(struct GGSession *gg_sess, struct GGPacketBuilder *pb, ULONG type, LONG size);
+#define GGPacketBeginFixed(gg_sess, pb, type, name) ((struct name*)GGPacketBeginRecord(gg_sess, pb, type, sizeof(struct name)))
+BOOL GGPacketCommit(struct GGPacketBuilder *pb);
+VOID GGImageUploadPump(struct GGSession *gg_sess);
+BOOL GGImageUploadReport(struct GGSession *gg_sess, struct GGEvent *event);
+VOID GGImageUploadFree(struct GGSession *gg_sess);
 
 #endif /* __GGPACKETS_H__ */
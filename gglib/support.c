@@ -272,6 +272,451 @@ STRPTR StrNewLen(STRPTR s, LONG len)
 	return result;
 }
 
+/****if* support.c/ArenaReserve()
+ *
+ *  NAME
+ *    ArenaReserve()
+ *
+ *  SYNOPSIS
+ *    BOOL ArenaReserve(APTR *arena, ULONG size)
+ *
+ *  FUNCTION
+ *    Funkcja upewnia si, e w aktualnym bloku areny jest co najmniej size wolnych bajtw.
+ *    Jeli nie ma, alokuje nowy blok (nie mniejszy ni ARENA_CHUNK_SIZE). Pozwala to
+ *    zbudowa cae zdarzenie z jednej alokacji, jeli jego rozmiar jest znany z gry.
+ *
+ *  INPUTS
+ *    - arena -- wskanik na uchwyt areny (NULL w uchwycie oznacza pust aren);
+ *    - size -- ilo potrzebnych bajtw, z uwzgldnieniem ARENA_ALIGN() kadej alokacji.
+ *
+ *  RESULT
+ *    - TRUE -- jeli si udao;
+ *    - FALSE -- w przypadku braku pamici.
+ *
+ *****/
+
+BOOL ArenaReserve(APTR *arena, ULONG size)
+{
+	struct ArenaChunk *chunk = (struct ArenaChunk*)*arena;
+
+	if(chunk == NULL || chunk->ac_Size - chunk->ac_Used < size)
+	{
+		ULONG chunk_size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+
+		if((chunk = AllocVec(ARENA_ALIGN(sizeof(struct ArenaChunk)) + chunk_size, MEMF_ANY | MEMF_CLEAR)) == NULL)
+			return FALSE;
+
+		chunk->ac_Next = (struct ArenaChunk*)*arena;
+		chunk->ac_Size = chunk_size;
+		chunk->ac_Used = 0;
+		*arena = chunk;
+	}
+
+	return TRUE;
+}
+
+/****if* support.c/ArenaAlloc()
+ *
+ *  NAME
+ *    ArenaAlloc()
+ *
+ *  SYNOPSIS
+ *    APTR ArenaAlloc(APTR *arena, ULONG size)
+ *
+ *  FUNCTION
+ *    Funkcja wydziela z areny wyzerowany blok pamici podanej wielkoci. Pamici nie
+ *    zwalnia si pojedynczo, caa arena zwalniana jest przez ArenaFree().
+ *
+ *  INPUTS
+ *    - arena -- wskanik na uchwyt areny;
+ *    - size -- wielko bloku w bajtach.
+ *
+ *  RESULT
+ *    Wskanik na blok pamici wyrwnany do ARENA_ALIGN() lub NULL w przypadku braku pamici.
+ *
+ *****/
+
+APTR ArenaAlloc(APTR *arena, ULONG size)
+{
+	struct ArenaChunk *chunk;
+	APTR result;
+
+	size = ARENA_ALIGN(size);
+
+	if(!ArenaReserve(arena, size))
+		return NULL;
+
+	chunk = (struct ArenaChunk*)*arena;
+	result = (UBYTE*)chunk + ARENA_ALIGN(sizeof(struct ArenaChunk)) + chunk->ac_Used;
+	chunk->ac_Used += size;
+
+	return result;
+}
+
+/****if* support.c/ArenaStrNewLen()
+ *
+ *  NAME
+ *    ArenaStrNewLen()
+ *
+ *  SYNOPSIS
+ *    STRPTR ArenaStrNewLen(APTR *arena, STRPTR s, LONG len)
+ *
+ *  FUNCTION
+ *    Funkcja tworzy w arenie nowy napis z podanej iloci znakw napisu rdowego.
+ *
+ *  INPUTS
+ *    - arena -- wskanik na uchwyt areny;
+ *    - s -- wskanik na napis rdowy;
+ *    - len -- ilo znakw do przekopiowania.
+ *
+ *  RESULT
+ *    Wskanik na nowy napis lub NULL w przypadku bdu. Napisu nie naley zwalnia.
+ *
+ *****/
+
+STRPTR ArenaStrNewLen(APTR *arena, STRPTR s, LONG len)
+{
+	STRPTR result = NULL;
+
+	if(s != NULL && len >= 0)
+	{
+		if((result = ArenaAlloc(arena, len + 1)))
+		{
+			CopyMem(s, result, len);
+			result[len] = 0x00;
+		}
+	}
+
+	return result;
+}
+
+/****if* support.c/ArenaStrNew()
+ *
+ *  NAME
+ *    ArenaStrNew()
+ *
+ *  SYNOPSIS
+ *    STRPTR ArenaStrNew(APTR *arena, STRPTR s)
+ *
+ *  FUNCTION
+ *    Funkcja tworzy w arenie kopi napisu zakoczonego zerem.
+ *
+ *  INPUTS
+ *    - arena -- wskanik na uchwyt areny;
+ *    - s -- wskanik na napis rdowy.
+ *
+ *  RESULT
+ *    Wskanik na nowy napis lub NULL w przypadku bdu. Napisu nie naley zwalnia.
+ *
+ *****/
+
+STRPTR ArenaStrNew(APTR *arena, STRPTR s)
+{
+	if(s == NULL)
+		return NULL;
+
+	return ArenaStrNewLen(arena, s, StrLen(s));
+}
+
+/****if* support.c/ArenaFree()
+ *
+ *  NAME
+ *    ArenaFree()
+ *
+ *  SYNOPSIS
+ *    VOID ArenaFree(APTR arena)
+ *
+ *  FUNCTION
+ *    Funkcja zwalnia wszystkie bloki areny wraz ze wszystkim, co zostao z nich wydzielone.
+ *
+ *  INPUTS
+ *    arena -- uchwyt areny, moe by NULL.
+ *
+ *****/
+
+VOID ArenaFree(APTR arena)
+{
+	struct ArenaChunk *chunk = (struct ArenaChunk*)arena;
+
+	while(chunk)
+	{
+		struct ArenaChunk *next = chunk->ac_Next;
+
+		FreeVec(chunk);
+		chunk = next;
+	}
+}
+
+/****if* support.c/InternPoolNew()
+ *
+ *  NAME
+ *    InternPoolNew()
+ *
+ *  SYNOPSIS
+ *    struct InternPool *InternPoolNew(VOID)
+ *
+ *  FUNCTION
+ *    Funkcja tworzy pust pul napisw wspdzielonych (internowanych). Kady napis wystpuje
+ *    w puli raz, z licznikiem odwoa, wic rwne napisy pobrane z jednej puli maj rwne
+ *    wskaniki i mona je porwnywa bez StrEqu().
+ *
+ *  RESULT
+ *    Wskanik na pul lub NULL w przypadku braku pamici.
+ *
+ *  SEE ALSO
+ *    InternStrLen(), InternRelease(), InternPoolFree()
+ *
+ *****/
+
+struct InternPool *InternPoolNew(VOID)
+{
+	struct InternPool *pool;
+
+	if((pool = AllocVec(sizeof(struct InternPool), MEMF_ANY | MEMF_CLEAR)))
+		pool->ip_PruneAt = INTERN_CACHE_MAX;
+
+	return pool;
+}
+
+/****if* support.c/InternPrune()
+ *
+ *  NAME
+ *    InternPrune()
+ *
+ *  SYNOPSIS
+ *    static VOID InternPrune(struct InternPool *pool)
+ *
+ *  FUNCTION
+ *    Funkcja usuwa z puli wszystkie napisy, do ktrych nie ma ju odwoa. Napisy bez odwoa
+ *    zostaj w puli jako pami podrczna (ten sam opis zwykle wraca), dopki ilo napisw
+ *    nie osignie ip_PruneAt.
+ *
+ *    Nastpne przegldanie tablicy nastpi dopiero po dodaniu co najmniej INTERN_PRUNE_STEP
+ *    nowych napisw. Jeli wikszo napisw ma odwoania (np. opisy wszystkich kontaktw
+ *    listy), przegldanie caej tablicy nie odbywa si wic przy kadym nowym napisie, a jego
+ *    koszt rozkada si na INTERN_PRUNE_STEP wywoa InternStrLen().
+ *
+ *  INPUTS
+ *    pool -- wskanik na pul.
+ *
+ *****/
+
+static VOID InternPrune(struct InternPool *pool)
+{
+	ULONG i;
+
+	for(i = 0; i < INTERN_TABLE_SIZE; i++)
+	{
+		struct InternString **link = &pool->ip_Table[i];
+
+		while(*link)
+		{
+			struct InternString *is = *link;
+
+			if(is->is_Refs == 0)
+			{
+				*link = is->is_Next;
+				FreeVec(is);
+				pool->ip_Count--;
+			}
+			else
+				link = &is->is_Next;
+		}
+	}
+
+	pool->ip_PruneAt = pool->ip_Count + INTERN_PRUNE_STEP;
+
+	if(pool->ip_PruneAt < INTERN_CACHE_MAX)
+		pool->ip_PruneAt = INTERN_CACHE_MAX;
+}
+
+/* porwnuje len bajtw, opis z pakietu moe zawiera zera */
+static inline BOOL InternEqual(CONST_STRPTR a, CONST_STRPTR b, ULONG len)
+{
+	while(len--)
+	{
+		if(*a++ != *b++)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/****if* support.c/InternStrLen()
+ *
+ *  NAME
+ *    InternStrLen()
+ *
+ *  SYNOPSIS
+ *    STRPTR InternStrLen(struct InternPool *pool, STRPTR s, ULONG len)
+ *
+ *  FUNCTION
+ *    Funkcja zwraca napis z puli rwny len pierwszym znakom napisu s, zwikszajc jego
+ *    licznik odwoa. Jeli w puli nie ma takiego napisu, jest on do niej kopiowany.
+ *
+ *  INPUTS
+ *    - pool -- wskanik na pul;
+ *    - s -- wskanik na napis rdowy (nie musi by zakoczony zerem);
+ *    - len -- ilo znakw napisu.
+ *
+ *  RESULT
+ *    Wskanik na napis zakoczony zerem lub NULL w przypadku bdu. Napisu nie wolno
+ *    modyfikowa, naley go zwolni przez InternRelease().
+ *
+ *****/
+
+STRPTR InternStrLen(struct InternPool *pool, STRPTR s, ULONG len)
+{
+	struct InternString *is;
+	ULONG hash = 2166136261UL;
+	ULONG i;
+
+	if(pool == NULL || s == NULL)
+		return NULL;
+
+	/* FNV-1a */
+	for(i = 0; i < len; i++)
+		hash = (hash ^ (UBYTE)s[i]) * 16777619UL;
+
+	for(is = pool->ip_Table[hash % INTERN_TABLE_SIZE]; is; is = is->is_Next)
+	{
+		if(is->is_Hash == hash && is->is_Len == len && InternEqual((STRPTR)(is + 1), s, len))
+		{
+			is->is_Refs++;
+			return (STRPTR)(is + 1);
+		}
+	}
+
+	if(pool->ip_Count >= pool->ip_PruneAt)
+		InternPrune(pool);
+
+	if((is = AllocVec(sizeof(struct InternString) + len + 1, MEMF_ANY)))
+	{
+		STRPTR text = (STRPTR)(is + 1);
+
+		CopyMem(s, text, len);
+		text[len] = 0x00;
+
+		is->is_Refs = 1;
+		is->is_Hash = hash;
+		is->is_Len = len;
+		is->is_Orphan = FALSE;
+		is->is_Next = pool->ip_Table[hash % INTERN_TABLE_SIZE];
+		pool->ip_Table[hash % INTERN_TABLE_SIZE] = is;
+		pool->ip_Count++;
+
+		return text;
+	}
+
+	return NULL;
+}
+
+/****if* support.c/InternRetain()
+ *
+ *  NAME
+ *    InternRetain()
+ *
+ *  SYNOPSIS
+ *    STRPTR InternRetain(STRPTR s)
+ *
+ *  FUNCTION
+ *    Funkcja zwiksza licznik odwoa napisu zwrconego przez InternStrLen(), bez ponownego
+ *    wyszukiwania go w puli.
+ *
+ *  INPUTS
+ *    s -- napis z puli, moe by NULL.
+ *
+ *  RESULT
+ *    Napis s, ktry naley zwolni przez InternRelease().
+ *
+ *****/
+
+STRPTR InternRetain(STRPTR s)
+{
+	if(s != NULL)
+		((struct InternString*)s - 1)->is_Refs++;
+
+	return s;
+}
+
+/****if* support.c/InternRelease()
+ *
+ *  NAME
+ *    InternRelease()
+ *
+ *  SYNOPSIS
+ *    VOID InternRelease(STRPTR s)
+ *
+ *  FUNCTION
+ *    Funkcja zmniejsza licznik odwoa napisu zwrconego przez InternStrLen(). Napis zostaje
+ *    w puli do ponownego uycia, chyba e pula zostaa ju zwolniona - wtedy ostatnie
+ *    odwoanie zwalnia jego pami.
+ *
+ *  INPUTS
+ *    s -- napis z puli, moe by NULL.
+ *
+ *****/
+
+VOID InternRelease(STRPTR s)
+{
+	struct InternString *is;
+
+	if(s == NULL)
+		return;
+
+	is = (struct InternString*)s - 1;
+
+	if(is->is_Refs > 0)
+		is->is_Refs--;
+
+	if(is->is_Refs == 0 && is->is_Orphan)
+		FreeVec(is);
+}
+
+/****if* support.c/InternPoolFree()
+ *
+ *  NAME
+ *    InternPoolFree()
+ *
+ *  SYNOPSIS
+ *    VOID InternPoolFree(struct InternPool *pool)
+ *
+ *  FUNCTION
+ *    Funkcja zwalnia pul napisw. Napisy, do ktrych s jeszcze odwoania (np. w zdarzeniach
+ *    nie zwolnionych przed kocem sesji), zostan zwolnione przez ostatnie InternRelease().
+ *
+ *  INPUTS
+ *    pool -- wskanik na pul, moe by NULL.
+ *
+ *****/
+
+VOID InternPoolFree(struct InternPool *pool)
+{
+	ULONG i;
+
+	if(pool == NULL)
+		return;
+
+	for(i = 0; i < INTERN_TABLE_SIZE; i++)
+	{
+		struct InternString *is = pool->ip_Table[i];
+
+		while(is)
+		{
+			struct InternString *next = is->is_Next;
+
+			if(is->is_Refs == 0)
+				FreeVec(is);
+			else
+				is->is_Orphan = TRUE;
+
+			is = next;
+		}
+	}
+
+	FreeVec(pool);
+}
+
 /****if* support.c/Inflate()
  *
  *  NAME
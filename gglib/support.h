@@ -14,12 +14,52 @@
 
 #define _between(a,x,b) ((x)>=(a) && (x)<=(b))
 
+#define ARENA_CHUNK_SIZE   (1024)
+#define ARENA_ALIGN(x)     (((x) + 7) & ~7UL)
+
+struct ArenaChunk
+{
+	struct ArenaChunk *ac_Next;
+	ULONG ac_Size;
+	ULONG ac_Used;
+};
+
+#define INTERN_TABLE_SIZE  (256)
+#define INTERN_CACHE_MAX   (4096)
+#define INTERN_PRUNE_STEP  (INTERN_CACHE_MAX / 4)
+
+struct InternString
+{
+	struct InternString *is_Next;
+	ULONG is_Refs;
+	ULONG is_Hash;
+	ULONG is_Len;
+	BOOL is_Orphan;
+};
+
+struct InternPool
+{
+	ULONG ip_Count;
+	ULONG ip_PruneAt;
+	struct InternString *ip_Table[INTERN_TABLE_SIZE];
+};
+
 VOID *MemSet(VOID *ptr, LONG word, LONG size);
 STRPTR InetToStr(ULONG no);
 LONG SendAllSSL(SSL *ssl, BYTE *buf, LONG len);
 LONG RecvAllSSL(struct Library *SocketBase, SSL *ssl, BYTE *buf, LONG len);
 BOOL StrIEqu(STRPTR s, STRPTR d); /* case insensitive */
 STRPTR StrNewLen(STRPTR s, LONG len);
+BOOL ArenaReserve(APTR *arena, ULONG size);
+APTR ArenaAlloc(APTR *arena, ULONG size);
+STRPTR ArenaStrNewLen(APTR *arena, STRPTR s, LONG len);
+STRPTR ArenaStrNew(APTR *arena, STRPTR s);
+VOID ArenaFree(APTR arena);
+struct InternPool *InternPoolNew(VOID);
+VOID InternPoolFree(struct InternPool *pool);
+STRPTR InternStrLen(struct InternPool *pool, STRPTR s, ULONG len);
+STRPTR InternRetain(STRPTR s);
+VOID InternRelease(STRPTR s);
 UBYTE *Inflate(UBYTE *data, ULONG *len);
 UBYTE *Deflate(UBYTE *data, ULONG *len);
 UBYTE StrByteToByte(STRPTR str_byte);
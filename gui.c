@@ -175,6 +175,25 @@ Object *CreatePrefsPage(VOID)
 					MUIA_Group_Child, (ULONG)EmptyRectangle(100),
 				TAG_END),
 
+				MUIA_Group_Child, (ULONG)MUI_NewObjectM(MUIC_Group,
+				MUIA_Group_Horiz, TRUE,
+					MUIA_Group_Child, (ULONG)StringLabel(GetString(MSG_PREFS_GG_OTHER_PRESENCE_WINDOW), "\33l"),
+					MUIA_Group_Child, (ULONG)MUI_NewObjectM(MUIC_String,
+						MUIA_Unicode, TRUE,
+						MUIA_ObjectID, USD_PREFS_GG_OTHER_PRESENCE_WINDOW,
+						MUIA_UserData, USD_PREFS_GG_OTHER_PRESENCE_WINDOW,
+						MUIA_Frame, MUIV_Frame_String,
+						MUIA_Background, MUII_StringBack,
+						MUIA_CycleChain, TRUE,
+						MUIA_String_Accept, (ULONG)"0123456789",
+						MUIA_String_MaxLen, 6,
+						MUIA_String_Integer, GG_PRESENCE_WINDOW_DEFAULT,
+						MUIA_String_AdvanceOnCR, TRUE,
+						MUIA_ShortHelp, (ULONG)GetString(MSG_PREFS_GG_OTHER_PRESENCE_WINDOW_HELP),
+					TAG_END),
+					MUIA_Group_Child, (ULONG)EmptyRectangle(100),
+				TAG_END),
+
 			TAG_END),
 		TAG_END),
 		MUIA_Group_Child, (ULONG)EmptyRectangle(100),
@@ -34,6 +34,10 @@
 #define USD_PREFS_GG_PUBDIR_FAMILYNAME       0x9EDA100F
 #define USD_PREFS_GG_PUBDIR_FAMILYCITY       0x9EDA1010
 #define USD_PREFS_GG_PUBDIR_FETCH_BUTTON     0x9EDA1011
+#define USD_PREFS_GG_OTHER_PRESENCE_WINDOW   0x9EDA1012
+
+/* ms, list changes of one contact within this time are merged, 0 turns it off */
+#define GG_PRESENCE_WINDOW_DEFAULT           500
 
 /* multilogon info window */
 #define USD_MULTILOGON_WINDOW                MAKE_ID(0x0000)
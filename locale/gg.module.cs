@@ -121,3 +121,11 @@ MSG_PUBDIR_MENU_ENTRY_TITLE
 Open Public Direcotry...
 Otwórz katalog publiczny...
 ;
+MSG_PREFS_GG_OTHER_PRESENCE_WINDOW
+Merge Status Changes (ms):
+Łącz zmiany statusu (ms):
+;
+MSG_PREFS_GG_OTHER_PRESENCE_WINDOW_HELP
+Status changes of one contact made within this time\nare shown as one. 0 switches merging off.
+Zmiany statusu jednego kontaktu w tym czasie\nsą pokazywane jako jedna. 0 wyłącza łączenie.
+;
@@ -67,8 +67,10 @@
 #define MSG_MULTILOGON_WINDOW_LIST_LOGON_TIME 26
 #define MSG_MULTILOGON_WINDOW_LIST_MENU_DISCONNECT 27
 #define MSG_PUBDIR_MENU_ENTRY_TITLE 28
+#define MSG_PREFS_GG_OTHER_PRESENCE_WINDOW 29
+#define MSG_PREFS_GG_OTHER_PRESENCE_WINDOW_HELP 30
 
-#define CATCOMP_LASTID 28
+#define CATCOMP_LASTID 30
 
 #endif /* CATCOMP_NUMBERS */
 
@@ -107,6 +109,8 @@
 #define MSG_MULTILOGON_WINDOW_LIST_LOGON_TIME_STR "Logon Time:"
 #define MSG_MULTILOGON_WINDOW_LIST_MENU_DISCONNECT_STR "Disconnect"
 #define MSG_PUBDIR_MENU_ENTRY_TITLE_STR "Open Public Direcotry..."
+#define MSG_PREFS_GG_OTHER_PRESENCE_WINDOW_STR "Merge Status Changes (ms):"
+#define MSG_PREFS_GG_OTHER_PRESENCE_WINDOW_HELP_STR "Status changes of one contact made within this time\nare shown as one. 0 switches merging off."
 
 #endif /* CATCOMP_STRINGS */
 
@@ -153,6 +157,8 @@ static const struct CatCompArrayType CatCompArray[] =
     {MSG_MULTILOGON_WINDOW_LIST_LOGON_TIME,(STRPTR)MSG_MULTILOGON_WINDOW_LIST_LOGON_TIME_STR},
     {MSG_MULTILOGON_WINDOW_LIST_MENU_DISCONNECT,(STRPTR)MSG_MULTILOGON_WINDOW_LIST_MENU_DISCONNECT_STR},
     {MSG_PUBDIR_MENU_ENTRY_TITLE,(STRPTR)MSG_PUBDIR_MENU_ENTRY_TITLE_STR},
+    {MSG_PREFS_GG_OTHER_PRESENCE_WINDOW,(STRPTR)MSG_PREFS_GG_OTHER_PRESENCE_WINDOW_STR},
+    {MSG_PREFS_GG_OTHER_PRESENCE_WINDOW_HELP,(STRPTR)MSG_PREFS_GG_OTHER_PRESENCE_WINDOW_HELP_STR},
 };
 
 #endif /* CATCOMP_ARRAY */
@@ -223,6 +229,10 @@ static const char CatCompBlock[] =
     MSG_MULTILOGON_WINDOW_LIST_MENU_DISCONNECT_STR "\x00\x00"
     "\x00\x00\x00\x1C\x00\x1A"
     MSG_PUBDIR_MENU_ENTRY_TITLE_STR "\x00\x00"
+    "\x00\x00\x00\x1D\x00\x1C"
+    MSG_PREFS_GG_OTHER_PRESENCE_WINDOW_STR "\x00\x00"
+    "\x00\x00\x00\x1E\x00\x5E"
+    MSG_PREFS_GG_OTHER_PRESENCE_WINDOW_HELP_STR "\x00"
 };
 
 #endif /* CATCOMP_BLOCK */